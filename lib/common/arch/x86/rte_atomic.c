@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdint.h>
+
+#include <rte_atomic.h>
+#include <rte_spinlock.h>
+
+#include "rte_cpuflags.h"
+
+uint8_t rte_cmpxchg16b_supported; /* cache the flag to avoid the overhead
+				     of the rte_cpu_get_flag_enabled function */
+
+/* locks of the emulated 128-bit operations, chosen by address */
+#define ATOMIC128_EMUL_LOCKS 64
+
+static rte_spinlock_t atomic128_emul_lock[ATOMIC128_EMUL_LOCKS] = {
+	[0 ... ATOMIC128_EMUL_LOCKS - 1] = RTE_SPINLOCK_INITIALIZER
+};
+
+RTE_INIT(rte_cmpxchg16b_init)
+{
+	rte_cmpxchg16b_supported =
+		rte_cpu_get_flag_enabled(RTE_CPUFLAG_CMPXCHG16B);
+}
+
+int
+__rte_atomic128_cmp_exchange_emul(rte_int128_t *dst, rte_int128_t *exp,
+		const rte_int128_t *src)
+{
+	rte_spinlock_t *sl = &atomic128_emul_lock[((uintptr_t)dst >> 4) %
+			ATOMIC128_EMUL_LOCKS];
+	int res;
+
+	rte_spinlock_lock(sl);
+	res = dst->val[0] == exp->val[0] && dst->val[1] == exp->val[1];
+	if (res)
+		*dst = *src;
+	else
+		*exp = *dst;
+	rte_spinlock_unlock(sl);
+
+	return res;
+}
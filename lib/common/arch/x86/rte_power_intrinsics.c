@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdint.h>
+
+#include "rte_cpuflags.h"
+#include "rte_power_intrinsics.h"
+
+uint8_t rte_waitpkg_supported; /* cache the flag for the wait loops */
+
+RTE_INIT(rte_waitpkg_init)
+{
+	rte_waitpkg_supported = rte_cpu_get_flag_enabled(RTE_CPUFLAG_WAITPKG);
+}
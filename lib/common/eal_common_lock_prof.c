@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_cycles.h>
+#include <rte_spinlock.h>
+#include <rte_lock_prof.h>
+
+/* statistics registered by this process, which may be in shared memory */
+static struct rte_lock_prof *lock_prof_list[RTE_LOCK_PROF_MAX];
+static rte_spinlock_t lock_prof_list_lock = RTE_SPINLOCK_INITIALIZER;
+
+int
+rte_lock_prof_register(struct rte_lock_prof *prof, const char *name)
+{
+	int i, free_idx = -1;
+
+	if (prof == NULL || name == NULL) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	rte_spinlock_lock(&lock_prof_list_lock);
+
+	for (i = 0; i < RTE_LOCK_PROF_MAX; i++) {
+		if (lock_prof_list[i] == prof)
+			break;
+		if (lock_prof_list[i] == NULL && free_idx < 0)
+			free_idx = i;
+	}
+	if (i == RTE_LOCK_PROF_MAX) {
+		if (free_idx < 0) {
+			rte_spinlock_unlock(&lock_prof_list_lock);
+			rte_errno = ENOSPC;
+			return -1;
+		}
+		lock_prof_list[free_idx] = prof;
+	}
+	snprintf(prof->name, sizeof(prof->name), "%s", name);
+
+	rte_spinlock_unlock(&lock_prof_list_lock);
+
+	return 0;
+}
+
+int
+rte_lock_prof_unregister(struct rte_lock_prof *prof)
+{
+	int i;
+
+	rte_spinlock_lock(&lock_prof_list_lock);
+
+	for (i = 0; i < RTE_LOCK_PROF_MAX; i++) {
+		if (lock_prof_list[i] == prof) {
+			lock_prof_list[i] = NULL;
+			break;
+		}
+	}
+
+	rte_spinlock_unlock(&lock_prof_list_lock);
+
+	if (i == RTE_LOCK_PROF_MAX) {
+		rte_errno = ENOENT;
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+rte_lock_prof_reset(void)
+{
+	struct rte_lock_prof *prof;
+	int i;
+
+	rte_spinlock_lock(&lock_prof_list_lock);
+
+	for (i = 0; i < RTE_LOCK_PROF_MAX; i++) {
+		prof = lock_prof_list[i];
+		if (prof == NULL)
+			continue;
+		__atomic_store_n(&prof->acquired, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&prof->contended, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&prof->wait_cycles, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&prof->max_hold_cycles, 0, __ATOMIC_RELAXED);
+	}
+
+	rte_spinlock_unlock(&lock_prof_list_lock);
+}
+
+void
+rte_lock_prof_dump(FILE *f)
+{
+	struct rte_lock_prof *prof;
+	uint64_t acquired, contended, wait;
+	int i;
+
+#ifndef RTE_LOCK_PROFILE
+	fprintf(f, "Lock profiling disabled, build with RTE_LOCK_PROFILE\n");
+#endif
+	fprintf(f, "Lock statistics, TSC at %" PRIu64 " Hz:\n",
+			rte_get_tsc_hz());
+	fprintf(f, "  %-31s %14s %14s %16s %12s %14s\n", "name",
+			"acquired", "contended", "wait_cycles", "avg_wait",
+			"max_hold");
+
+	rte_spinlock_lock(&lock_prof_list_lock);
+
+	for (i = 0; i < RTE_LOCK_PROF_MAX; i++) {
+		prof = lock_prof_list[i];
+		if (prof == NULL)
+			continue;
+		acquired = __atomic_load_n(&prof->acquired, __ATOMIC_RELAXED);
+		contended = __atomic_load_n(&prof->contended,
+				__ATOMIC_RELAXED);
+		wait = __atomic_load_n(&prof->wait_cycles, __ATOMIC_RELAXED);
+		fprintf(f, "  %-31s %14" PRIu64 " %14" PRIu64 " %16" PRIu64
+				" %12" PRIu64 " %14" PRIu64 "\n",
+				prof->name, acquired, contended, wait,
+				contended != 0 ? wait / contended : 0,
+				prof->max_hold_cycles);
+	}
+
+	rte_spinlock_unlock(&lock_prof_list_lock);
+}
@@ -13,6 +13,7 @@
 #include <rte_eal.h>
 #include <rte_log.h>
 #include <rte_per_lcore.h>
+#include <rte_seqlock.h>
 
 #include "eal_private.h"
 
@@ -26,6 +27,12 @@ struct rte_logs rte_logs = {
 /* Stream to use for logging if rte_logs.file is NULL */
 static FILE *default_log_stream;
 
+/* serializes the changes of the log types, which are read without lock */
+static rte_seqlock_t log_lock = RTE_SEQLOCK_INITIALIZER;
+
+/* number of entries allocated in rte_logs.dynamic_types */
+static size_t dynamic_types_size;
+
 /**
  * This global structure stores some informations about the message
  * that is currently being processed by one lcore
@@ -67,26 +74,56 @@ rte_log_get_global_level(void)
 	return rte_logs.level;
 }
 
+/* level of a log type, -1 if the type is not registered */
+static inline int
+log_type_level(uint32_t type)
+{
+	const struct rte_log_dynamic_type *types;
+	uint32_t sn;
+	size_t len;
+	int level;
+
+	do {
+		sn = rte_seqlock_read_begin(&log_lock);
+		/*
+		 * The table is published before the length which it covers,
+		 * so the table read after the length is large enough for it.
+		 */
+		len = __atomic_load_n(&rte_logs.dynamic_types_len,
+				__ATOMIC_ACQUIRE);
+		types = __atomic_load_n(&rte_logs.dynamic_types,
+				__ATOMIC_ACQUIRE);
+		if (type < len)
+			level = types[type].loglevel;
+		else
+			level = -1;
+	} while (rte_seqlock_read_retry(&log_lock, sn));
+
+	return level;
+}
+
 int
 rte_log_get_level(uint32_t type)
 {
-	if (type >= rte_logs.dynamic_types_len)
-		return -1;
-
-	return rte_logs.dynamic_types[type].loglevel;
+	return log_type_level(type);
 }
 
 int
 rte_log_set_level(uint32_t type, uint32_t level)
 {
-	if (type >= rte_logs.dynamic_types_len)
-		return -1;
+	int ret = -1;
+
 	if (level > RTE_LOG_DEBUG)
 		return -1;
 
-	rte_logs.dynamic_types[type].loglevel = level;
+	rte_seqlock_write_lock(&log_lock);
+	if (type < rte_logs.dynamic_types_len) {
+		rte_logs.dynamic_types[type].loglevel = level;
+		ret = 0;
+	}
+	rte_seqlock_write_unlock(&log_lock);
 
-	return 0;
+	return ret;
 }
 
 /* set level */
@@ -102,6 +139,7 @@ rte_log_set_level_regexp(const char *pattern, uint32_t level)
 	if (regcomp(&r, pattern, 0) != 0)
 		return -1;
 
+	rte_seqlock_write_lock(&log_lock);
 	for (i = 0; i < rte_logs.dynamic_types_len; i++) {
 		if (rte_logs.dynamic_types[i].name == NULL)
 			continue;
@@ -109,6 +147,7 @@ rte_log_set_level_regexp(const char *pattern, uint32_t level)
 				NULL, 0) == 0)
 			rte_logs.dynamic_types[i].loglevel = level;
 	}
+	rte_seqlock_write_unlock(&log_lock);
 
 	regfree(&r);
 
@@ -164,25 +203,45 @@ int
 rte_log_register(const char *name)
 {
 	struct rte_log_dynamic_type *new_dynamic_types;
-	int id, ret;
-
-	id = rte_log_lookup(name);
-	if (id >= 0)
-		return id;
+	size_t new_size;
+	int ret;
 
-	new_dynamic_types = realloc(rte_logs.dynamic_types,
-		sizeof(struct rte_log_dynamic_type) *
-		(rte_logs.dynamic_types_len + 1));
-	if (new_dynamic_types == NULL)
-		return -ENOMEM;
-	rte_logs.dynamic_types = new_dynamic_types;
+	rte_seqlock_write_lock(&log_lock);
+
+	ret = rte_log_lookup(name);
+	if (ret >= 0)
+		goto out;
+
+	if (rte_logs.dynamic_types_len == dynamic_types_size) {
+		/* the initial table may have failed to be allocated */
+		new_size = RTE_MAX(dynamic_types_size * 2,
+				(size_t)RTE_LOGTYPE_FIRST_EXT_ID);
+		new_dynamic_types = calloc(new_size,
+			sizeof(struct rte_log_dynamic_type));
+		if (new_dynamic_types == NULL) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		if (rte_logs.dynamic_types_len != 0)
+			memcpy(new_dynamic_types, rte_logs.dynamic_types,
+				sizeof(struct rte_log_dynamic_type) *
+				rte_logs.dynamic_types_len);
+		/* not freed, as a reader may still read the previous table */
+		__atomic_store_n(&rte_logs.dynamic_types, new_dynamic_types,
+				__ATOMIC_RELEASE);
+		dynamic_types_size = new_size;
+	}
 
 	ret = __rte_log_register(name, rte_logs.dynamic_types_len);
 	if (ret < 0)
-		return ret;
+		goto out;
 
-	rte_logs.dynamic_types_len++;
+	/* after the table, so that readers never see it too short */
+	__atomic_store_n(&rte_logs.dynamic_types_len,
+			rte_logs.dynamic_types_len + 1, __ATOMIC_RELEASE);
 
+out:
+	rte_seqlock_write_unlock(&log_lock);
 	return ret;
 }
 
@@ -236,13 +295,15 @@ rte_log_init(void)
 		sizeof(struct rte_log_dynamic_type));
 	if (rte_logs.dynamic_types == NULL)
 		return;
+	dynamic_types_size = RTE_LOGTYPE_FIRST_EXT_ID;
 
 	/* register legacy log types */
 	for (i = 0; i < RTE_DIM(logtype_strings); i++)
 		__rte_log_register(logtype_strings[i].logtype,
 				logtype_strings[i].log_id);
 
-	rte_logs.dynamic_types_len = RTE_LOGTYPE_FIRST_EXT_ID;
+	__atomic_store_n(&rte_logs.dynamic_types_len,
+			RTE_LOGTYPE_FIRST_EXT_ID, __ATOMIC_RELEASE);
 }
 
 static const char *
@@ -271,6 +332,8 @@ rte_log_dump(FILE *f)
 	fprintf(f, "global log level is %s\n",
 		loglevel_to_string(rte_log_get_global_level()));
 
+	/* the names are not copied by the readers, exclude the writers */
+	rte_spinlock_lock(&log_lock.lock);
 	for (i = 0; i < rte_logs.dynamic_types_len; i++) {
 		if (rte_logs.dynamic_types[i].name == NULL)
 			continue;
@@ -278,6 +341,7 @@ rte_log_dump(FILE *f)
 			i, rte_logs.dynamic_types[i].name,
 			loglevel_to_string(rte_logs.dynamic_types[i].loglevel));
 	}
+	rte_spinlock_unlock(&log_lock.lock);
 }
 
 /*
@@ -287,7 +351,7 @@ rte_log_dump(FILE *f)
 int
 rte_vlog(uint32_t level, uint32_t logtype, const char *format, va_list ap)
 {
-	int ret;
+	int ret, type_level;
 	FILE *f = rte_logs.file;
 	if (f == NULL) {
 		f = default_log_stream;
@@ -305,9 +369,10 @@ rte_vlog(uint32_t level, uint32_t logtype, const char *format, va_list ap)
 
 	if (level > rte_logs.level)
 		return 0;
-	if (logtype >= rte_logs.dynamic_types_len)
+	type_level = log_type_level(logtype);
+	if (type_level < 0)
 		return -1;
-	if (level > rte_logs.dynamic_types[logtype].loglevel)
+	if (level > (uint32_t)type_level)
 		return 0;
 
 	/* save loglevel and logtype in a global per-lcore variable */
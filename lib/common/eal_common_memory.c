@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 #include <unistd.h>
 #include <inttypes.h>
@@ -15,9 +16,11 @@
 #include <rte_eal.h>
 #include <rte_eal_memconfig.h>
 #include <rte_log.h>
+#include <rte_atomic.h>
 
 #include "eal_private.h"
 #include "eal_internal_cfg.h"
+#include "eal_memalloc.h"
 
 /*
  * Return a pointer to a read-only table of struct rte_physmem_desc
@@ -80,6 +83,185 @@ rte_dump_physmem_layout(FILE *f)
 	}
 }
 
+/* map the memsegs added or released at runtime by the primary process */
+int
+rte_eal_memseg_sync(void)
+{
+	if (rte_eal_process_type() != RTE_PROC_SECONDARY)
+		return 0;
+
+	return eal_memalloc_sync();
+}
+
+/* true if the memseg contains the virtual address */
+static inline int
+mem_in_seg(const struct rte_memseg *ms, uintptr_t va)
+{
+	uintptr_t start = (uintptr_t)ms->addr;
+
+	return va >= start && va - start < ms->len;
+}
+
+/* slow path of the lookup: scan all the memsegs */
+static const struct rte_memseg *
+mem_virt2memseg_scan(const struct rte_mem_config *mcfg, uintptr_t va)
+{
+	unsigned int i;
+
+	for (i = 0; i < RTE_MAX_MEMSEG; i++) {
+		if (mcfg->memseg[i].len == 0)
+			break;
+		if (mem_in_seg(&mcfg->memseg[i], va))
+			return &mcfg->memseg[i];
+	}
+	return NULL;
+}
+
+/* get the lookup entry of a 2M area, allocating its level 2 table */
+static uint16_t *
+mem_lookup_entry(struct rte_mem_lookup *lk, uintptr_t va, int alloc)
+{
+	uintptr_t l1 = va >> RTE_MEM_LOOKUP_L1_SHIFT;
+	uintptr_t l2 = (va >> RTE_MEM_LOOKUP_SHIFT) &
+		(RTE_MEM_LOOKUP_L2_SIZE - 1);
+
+	if (l1 >= RTE_MEM_LOOKUP_L1_SIZE)
+		return NULL;
+
+	if (lk->l1[l1] == 0) {
+		if (!alloc)
+			return NULL;
+		if (lk->nb_l2 == RTE_MEM_LOOKUP_NB_L2) {
+			lk->overflow = 1;
+			return NULL;
+		}
+		/* the table is visible once it is cleared */
+		memset(lk->l2[lk->nb_l2], 0, sizeof(lk->l2[0]));
+		rte_smp_wmb();
+		lk->l1[l1] = ++lk->nb_l2;
+	}
+
+	return &lk->l2[lk->l1[l1] - 1][l2];
+}
+
+/* get the granules of the lookup table covered by a memseg */
+static void
+mem_lookup_range(const struct rte_memseg *ms, uintptr_t *start,
+	uintptr_t *end)
+{
+	const uintptr_t granule = (uintptr_t)1 << RTE_MEM_LOOKUP_SHIFT;
+
+	*start = RTE_ALIGN_FLOOR((uintptr_t)ms->addr, granule);
+	*end = RTE_ALIGN_CEIL((uintptr_t)ms->addr + ms->len, granule);
+}
+
+void
+eal_mem_lookup_add(unsigned int idx)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	struct rte_mem_lookup *lk = &mcfg->mem_lookup;
+	const uintptr_t granule = (uintptr_t)1 << RTE_MEM_LOOKUP_SHIFT;
+	uintptr_t va, end;
+	uint16_t *e;
+
+	mem_lookup_range(&mcfg->memseg[idx], &va, &end);
+	for (; va < end; va += granule) {
+		e = mem_lookup_entry(lk, va, 1);
+		if (e == NULL)
+			continue;
+		if (*e == 0)
+			*e = idx + 1;
+		else if (*e != idx + 1)
+			*e = RTE_MEM_LOOKUP_MULTI;
+	}
+	rte_smp_wmb();
+}
+
+void
+eal_mem_lookup_del(unsigned int idx)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	struct rte_mem_lookup *lk = &mcfg->mem_lookup;
+	const uintptr_t granule = (uintptr_t)1 << RTE_MEM_LOOKUP_SHIFT;
+	uintptr_t va, end, ms_start, ms_end;
+	unsigned int i, n;
+	uint16_t *e, val;
+
+	mem_lookup_range(&mcfg->memseg[idx], &va, &end);
+	for (; va < end; va += granule) {
+		e = mem_lookup_entry(lk, va, 0);
+		if (e == NULL)
+			continue;
+		if (*e == idx + 1) {
+			*e = 0;
+			continue;
+		}
+		if (*e != RTE_MEM_LOOKUP_MULTI)
+			continue;
+
+		/* find the other memsegs sharing the area */
+		val = 0;
+		for (i = 0, n = 0; i < RTE_MAX_MEMSEG &&
+				mcfg->memseg[i].len != 0; i++) {
+			if (i == idx)
+				continue;
+			mem_lookup_range(&mcfg->memseg[i], &ms_start, &ms_end);
+			if (va < ms_start || va >= ms_end)
+				continue;
+			val = i + 1;
+			n++;
+		}
+		*e = n > 1 ? RTE_MEM_LOOKUP_MULTI : val;
+	}
+	rte_smp_wmb();
+}
+
+/* find the memseg of a virtual address, without lock */
+const struct rte_memseg *
+rte_mem_virt2memseg(const void *virt)
+{
+	const struct rte_mem_config *mcfg =
+		rte_eal_get_configuration()->mem_config;
+	const struct rte_mem_lookup *lk = &mcfg->mem_lookup;
+	uintptr_t va = (uintptr_t)virt;
+	const struct rte_memseg *ms;
+	uintptr_t l1 = va >> RTE_MEM_LOOKUP_L1_SHIFT;
+	uint16_t l2, e;
+
+	if (l1 >= RTE_MEM_LOOKUP_L1_SIZE)
+		return mem_virt2memseg_scan(mcfg, va);
+
+	l2 = lk->l1[l1];
+	if (l2 == 0)
+		return lk->overflow ? mem_virt2memseg_scan(mcfg, va) : NULL;
+
+	e = lk->l2[l2 - 1][(va >> RTE_MEM_LOOKUP_SHIFT) &
+		(RTE_MEM_LOOKUP_L2_SIZE - 1)];
+	if (e == 0)
+		return NULL;
+	if (e == RTE_MEM_LOOKUP_MULTI)
+		return mem_virt2memseg_scan(mcfg, va);
+
+	/* the memseg may change at runtime, check it still matches */
+	ms = &mcfg->memseg[e - 1];
+	return mem_in_seg(ms, va) ? ms : NULL;
+}
+
+/* get the IOVA of a virtual address from its memseg */
+rte_iova_t
+rte_mem_virt2iova(const void *virt)
+{
+	const struct rte_memseg *ms = rte_mem_virt2memseg(virt);
+
+	if (ms == NULL || ms->iova == RTE_BAD_IOVA)
+		return RTE_BAD_IOVA;
+
+	if (rte_eal_iova_mode() == RTE_IOVA_VA)
+		return (uintptr_t)virt;
+
+	return ms->iova + RTE_PTR_DIFF(virt, ms->addr);
+}
+
 /* return the number of memory channels */
 unsigned rte_memory_get_nchannel(void)
 {
@@ -123,12 +305,33 @@ rte_eal_memory_init(void)
 {
 	RTE_LOG(DEBUG, EAL, "Setting up physically contiguous memory...\n");
 
+	/* the memsegs added at runtime are mapped while attaching */
+	if (rte_eal_process_type() != RTE_PROC_PRIMARY &&
+			eal_memalloc_init() < 0)
+		return -1;
+
 	const int retval = rte_eal_process_type() == RTE_PROC_PRIMARY ?
 			rte_eal_hugepage_init() :
 			rte_eal_hugepage_attach();
 	if (retval < 0)
 		return -1;
 
+	/* reserve the area of the memsegs added at runtime */
+	if (rte_eal_process_type() == RTE_PROC_PRIMARY &&
+			eal_memalloc_init() < 0)
+		return -1;
+
+	/* index the memsegs by virtual address */
+	if (rte_eal_process_type() == RTE_PROC_PRIMARY) {
+		const struct rte_mem_config *mcfg =
+			rte_eal_get_configuration()->mem_config;
+		unsigned int i;
+
+		for (i = 0; i < RTE_MAX_MEMSEG && mcfg->memseg[i].len != 0;
+				i++)
+			eal_mem_lookup_add(i);
+	}
+
 	if (internal_config.no_shconf == 0 && rte_eal_memdevice_init() < 0)
 		return -1;
 
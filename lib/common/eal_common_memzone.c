@@ -20,11 +20,18 @@
 #include <rte_errno.h>
 #include <rte_string_fns.h>
 #include <rte_common.h>
+#include <rte_lcore.h>
+#include <rte_rcu_qsbr.h>
 
 #include "malloc_heap.h"
 #include "malloc_elem.h"
 #include "eal_private.h"
 
+#define MCFG_QSBR_MZ_NAME "EAL_MCFG_QSBR"
+
+/* readers of the memzones and tailqs not taking the locks */
+static struct rte_rcu_qsbr *mcfg_qsbr;
+
 static inline const struct rte_memzone *
 memzone_lookup_thread_unsafe(const char *name)
 {
@@ -41,7 +48,11 @@ memzone_lookup_thread_unsafe(const char *name)
 	 */
 	for (i = 0; i < RTE_MAX_MEMZONE; i++) {
 		mz = &mcfg->memzone[i];
-		if (mz->addr != NULL && !strncmp(name, mz->name, RTE_MEMZONE_NAMESIZE))
+		if (mz->addr == NULL)
+			continue;
+		/* read the name of a published memzone */
+		rte_smp_rmb();
+		if (!strncmp(name, mz->name, RTE_MEMZONE_NAMESIZE))
 			return &mcfg->memzone[i];
 	}
 
@@ -57,8 +68,10 @@ get_next_free_memzone(void)
 	/* get pointer to global configuration */
 	mcfg = rte_eal_get_configuration()->mem_config;
 
+	/* a freed memzone keeps its name until no lookup can read it */
 	for (i = 0; i < RTE_MAX_MEMZONE; i++) {
-		if (mcfg->memzone[i].addr == NULL)
+		if (mcfg->memzone[i].addr == NULL &&
+				mcfg->memzone[i].name[0] == '\0')
 			return &mcfg->memzone[i];
 	}
 
@@ -103,7 +116,7 @@ memzone_reserve_aligned_thread_unsafe(const char *name, size_t len,
 	struct rte_memzone *mz;
 	struct rte_mem_config *mcfg;
 	size_t requested_len;
-	int socket, i;
+	int socket, preferred_socket, i;
 
 	/* get pointer to global configuration */
 	mcfg = rte_eal_get_configuration()->mem_config;
@@ -166,6 +179,8 @@ memzone_reserve_aligned_thread_unsafe(const char *name, size_t len,
 		return NULL;
 	}
 
+	/* without hugepages, the socket is only a preference */
+	preferred_socket = socket_id;
 	if (!rte_eal_has_hugepages())
 		socket_id = SOCKET_ID_ANY;
 
@@ -181,10 +196,12 @@ memzone_reserve_aligned_thread_unsafe(const char *name, size_t len,
 		}
 	}
 
-	if (socket_id == SOCKET_ID_ANY)
-		socket = malloc_get_numa_socket();
-	else
+	if (socket_id != SOCKET_ID_ANY)
 		socket = socket_id;
+	else if (preferred_socket != SOCKET_ID_ANY)
+		socket = preferred_socket;
+	else
+		socket = malloc_get_numa_socket();
 
 	/* allocate memory on heap */
 	void *mz_addr = malloc_heap_alloc(&mcfg->malloc_heaps[socket], NULL,
@@ -224,13 +241,15 @@ memzone_reserve_aligned_thread_unsafe(const char *name, size_t len,
 	mcfg->memzone_cnt++;
 	snprintf(mz->name, sizeof(mz->name), "%s", name);
 	mz->iova = rte_malloc_virt2iova(mz_addr);
-	mz->addr = mz_addr;
 	mz->len = (requested_len == 0 ?
 			(elem->size - MALLOC_ELEM_OVERHEAD) : requested_len);
 	mz->hugepage_sz = elem->ms->hugepage_sz;
 	mz->socket_id = elem->ms->socket_id;
 	mz->flags = 0;
 	mz->memseg_id = elem->ms - rte_eal_get_configuration()->mem_config->memseg;
+	/* publish the memzone to the lock-free lookups once filled */
+	rte_smp_wmb();
+	mz->addr = mz_addr;
 
 	return mz;
 }
@@ -246,12 +265,12 @@ rte_memzone_reserve_thread_safe(const char *name, size_t len,
 	/* get pointer to global configuration */
 	mcfg = rte_eal_get_configuration()->mem_config;
 
-	rte_rwlock_write_lock(&mcfg->mlock);
+	rte_mcfg_write_lock(mcfg);
 
 	mz = memzone_reserve_aligned_thread_unsafe(
 		name, len, socket_id, flags, align, bound);
 
-	rte_rwlock_write_unlock(&mcfg->mlock);
+	rte_mcfg_write_unlock(mcfg);
 
 	return mz;
 }
@@ -306,7 +325,7 @@ rte_memzone_free(const struct rte_memzone *mz)
 
 	mcfg = rte_eal_get_configuration()->mem_config;
 
-	rte_rwlock_write_lock(&mcfg->mlock);
+	rte_mcfg_write_lock(mcfg);
 
 	idx = ((uintptr_t)mz - (uintptr_t)mcfg->memzone);
 	idx = idx / sizeof(struct rte_memzone);
@@ -318,11 +337,21 @@ rte_memzone_free(const struct rte_memzone *mz)
 		rte_panic("%s(): memzone address not NULL but memzone_cnt is 0!\n",
 				__func__);
 	} else {
-		memset(&mcfg->memzone[idx], 0, sizeof(mcfg->memzone[idx]));
-		mcfg->memzone_cnt--;
+		/* hide it from the lookups, its name keeps the entry used */
+		mcfg->memzone[idx].addr = NULL;
 	}
 
-	rte_rwlock_write_unlock(&mcfg->mlock);
+	rte_mcfg_write_unlock(mcfg);
+
+	if (addr == NULL)
+		return ret;
+
+	rte_mcfg_qsbr_synchronize();
+
+	rte_mcfg_write_lock(mcfg);
+	memset(&mcfg->memzone[idx], 0, sizeof(mcfg->memzone[idx]));
+	mcfg->memzone_cnt--;
+	rte_mcfg_write_unlock(mcfg);
 
 	rte_free(addr);
 
@@ -340,11 +369,19 @@ rte_memzone_lookup(const char *name)
 
 	mcfg = rte_eal_get_configuration()->mem_config;
 
-	rte_rwlock_read_lock(&mcfg->mlock);
+	/* the memzone may be in a memseg added by the primary process */
+	if (rte_eal_memseg_sync() < 0)
+		return NULL;
+
+	if (rte_mcfg_qsbr_is_online())
+		return memzone_lookup_thread_unsafe(name);
+
+	/* the lookup only reads the memzones, elide the lock */
+	rte_mcfg_read_lock_tm(mcfg);
 
 	memzone = memzone_lookup_thread_unsafe(name);
 
-	rte_rwlock_read_unlock(&mcfg->mlock);
+	rte_mcfg_read_unlock_tm(mcfg);
 
 	return memzone;
 }
@@ -359,7 +396,7 @@ rte_memzone_dump(FILE *f)
 	/* get pointer to global configuration */
 	mcfg = rte_eal_get_configuration()->mem_config;
 
-	rte_rwlock_read_lock(&mcfg->mlock);
+	rte_mcfg_read_lock(mcfg);
 	/* dump all zones */
 	for (i=0; i<RTE_MAX_MEMZONE; i++) {
 		if (mcfg->memzone[i].addr == NULL)
@@ -373,7 +410,121 @@ rte_memzone_dump(FILE *f)
 		       mcfg->memzone[i].socket_id,
 		       mcfg->memzone[i].flags);
 	}
-	rte_rwlock_read_unlock(&mcfg->mlock);
+	rte_mcfg_read_unlock(mcfg);
+}
+
+/*
+ * Set up the QSBR variable of the lookups, in a memzone shared with the
+ * secondary processes.
+ */
+static int
+mcfg_qsbr_init(void)
+{
+	const struct rte_memzone *mz;
+	size_t sz = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+
+	if (rte_eal_process_type() == RTE_PROC_SECONDARY) {
+		mz = rte_memzone_lookup(MCFG_QSBR_MZ_NAME);
+		if (mz == NULL) {
+			RTE_LOG(ERR, EAL, "%s(): Cannot find QSBR variable\n",
+				__func__);
+			return -1;
+		}
+		mcfg_qsbr = mz->addr;
+		return 0;
+	}
+
+	mz = rte_memzone_reserve_aligned(MCFG_QSBR_MZ_NAME, sz,
+			SOCKET_ID_ANY, 0, RTE_CACHE_LINE_SIZE);
+	if (mz == NULL) {
+		RTE_LOG(ERR, EAL, "%s(): Cannot reserve QSBR variable\n",
+			__func__);
+		return -1;
+	}
+	rte_rcu_qsbr_init(mz->addr, RTE_MAX_LCORE);
+	mcfg_qsbr = mz->addr;
+
+	return 0;
+}
+
+struct rte_rcu_qsbr *
+rte_mcfg_qsbr_get(void)
+{
+	return mcfg_qsbr;
+}
+
+int
+rte_mcfg_qsbr_is_online(void)
+{
+	struct rte_rcu_qsbr *v = mcfg_qsbr;
+
+	return v != NULL && rte_rcu_qsbr_thread_is_online(v, rte_lcore_id());
+}
+
+void
+rte_mcfg_qsbr_synchronize(void)
+{
+	struct rte_rcu_qsbr *v = mcfg_qsbr;
+	unsigned int lcore_id = rte_lcore_id();
+	int online;
+
+	if (v == NULL)
+		return;
+
+	/*
+	 * An online caller goes offline meanwhile, so that two writers don't
+	 * wait for each other.
+	 */
+	online = rte_rcu_qsbr_thread_is_online(v, lcore_id);
+	if (online)
+		rte_rcu_qsbr_thread_offline(v, lcore_id);
+	rte_rcu_qsbr_synchronize(v, RTE_QSBR_THRID_INVALID);
+	if (online)
+		rte_rcu_qsbr_thread_online(v, lcore_id);
+}
+
+static void
+mcfg_tm_dump_one(FILE *f, const char *name, const struct rte_tm_adapt *a)
+{
+	fprintf(f, "  %s: aborts=%" PRIu64 ", fallbacks=%" PRIu64
+			", disables=%" PRIu64 ", skip=%d\n", name,
+			__atomic_load_n(&a->aborts, __ATOMIC_RELAXED),
+			__atomic_load_n(&a->fallbacks, __ATOMIC_RELAXED),
+			__atomic_load_n(&a->disables, __ATOMIC_RELAXED),
+			(int)__atomic_load_n(&a->skip, __ATOMIC_RELAXED));
+}
+
+void
+rte_mcfg_tm_dump(FILE *f)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+
+	fprintf(f, "Lock elision %s:\n",
+			rte_tm_supported() ? "supported" : "not supported");
+	mcfg_tm_dump_one(f, "mlock", &mcfg->mlock_tm);
+	mcfg_tm_dump_one(f, "qlock", &mcfg->qlock_tm);
+	mcfg_tm_dump_one(f, "mplock", &mcfg->mplock_tm);
+}
+
+/*
+ * Name the contention statistics of the memory configuration and heap
+ * locks, with RTE_LOCK_PROFILE.
+ */
+static void
+mcfg_lock_prof_register(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_LOCK_PROFILE
+	unsigned int i;
+
+	rte_lock_prof_register(&mcfg->mlock_prof, "mlock");
+	rte_lock_prof_register(&mcfg->qlock_prof, "qlock");
+	rte_lock_prof_register(&mcfg->mplock_prof, "mplock");
+	for (i = 0; i < RTE_MAX_HEAPS; i++)
+		if (mcfg->malloc_heaps[i].name[0] != '\0')
+			malloc_heap_lock_prof_register(&mcfg->malloc_heaps[i]);
+#else
+	RTE_SET_USED(mcfg);
+#endif
 }
 
 /*
@@ -389,8 +540,10 @@ rte_eal_memzone_init(void)
 	mcfg = rte_eal_get_configuration()->mem_config;
 
 	/* secondary processes don't need to initialise anything */
-	if (rte_eal_process_type() == RTE_PROC_SECONDARY)
-		return 0;
+	if (rte_eal_process_type() == RTE_PROC_SECONDARY) {
+		mcfg_lock_prof_register(mcfg);
+		return mcfg_qsbr_init();
+	}
 
 	memseg = rte_eal_get_physmem_layout();
 	if (memseg == NULL) {
@@ -398,15 +551,20 @@ rte_eal_memzone_init(void)
 		return -1;
 	}
 
-	rte_rwlock_write_lock(&mcfg->mlock);
+	rte_mcfg_write_lock(mcfg);
 
 	/* delete all zones */
 	mcfg->memzone_cnt = 0;
 	memset(mcfg->memzone, 0, sizeof(mcfg->memzone));
 
-	rte_rwlock_write_unlock(&mcfg->mlock);
+	rte_mcfg_write_unlock(mcfg);
+
+	if (rte_eal_malloc_heap_init() < 0)
+		return -1;
+
+	mcfg_lock_prof_register(mcfg);
 
-	return rte_eal_malloc_heap_init();
+	return mcfg_qsbr_init();
 }
 
 /* Walk all reserved memory zones */
@@ -418,10 +576,10 @@ void rte_memzone_walk(void (*func)(const struct rte_memzone *, void *),
 
 	mcfg = rte_eal_get_configuration()->mem_config;
 
-	rte_rwlock_read_lock(&mcfg->mlock);
+	rte_mcfg_read_lock(mcfg);
 	for (i=0; i<RTE_MAX_MEMZONE; i++) {
 		if (mcfg->memzone[i].addr != NULL)
 			(*func)(&mcfg->memzone[i], arg);
 	}
-	rte_rwlock_read_unlock(&mcfg->mlock);
+	rte_mcfg_read_unlock(mcfg);
 }
@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_memory.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_parallel.h>
+
+/*
+ * Chunks left to an lcore, [next, end[, packed in a 64-bit word so that
+ * the lcore and the thieves update them with a single compare and swap.
+ */
+#define RANGE(next, end) (((uint64_t)(end) << 32) | (uint32_t)(next))
+#define RANGE_NEXT(r) ((uint32_t)(r))
+#define RANGE_END(r) ((uint32_t)((r) >> 32))
+
+struct parallel_range {
+	uint64_t chunks;
+} __rte_cache_aligned;
+
+struct parallel_job {
+	uint64_t begin;
+	uint64_t end;
+	uint64_t grain;
+	rte_parallel_for_fn_t fn;
+	void *arg;
+	unsigned int nb_workers;
+	struct parallel_range range[RTE_MAX_LCORE];
+};
+
+struct parallel_worker {
+	struct parallel_job *job;
+	unsigned int idx;
+};
+
+/* take the first chunk left to an lcore, by itself */
+static int
+range_pop(struct parallel_range *r, uint32_t *chunk)
+{
+	uint64_t old = __atomic_load_n(&r->chunks, __ATOMIC_RELAXED);
+
+	do {
+		if (RANGE_NEXT(old) >= RANGE_END(old))
+			return 0;
+	} while (!__atomic_compare_exchange_n(&r->chunks, &old, old + 1, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	*chunk = RANGE_NEXT(old);
+	return 1;
+}
+
+/* take the second half of the chunks left to another lcore */
+static int
+range_steal(struct parallel_range *victim, uint32_t *next, uint32_t *end)
+{
+	uint64_t old = __atomic_load_n(&victim->chunks, __ATOMIC_RELAXED);
+	uint32_t n, e, mid;
+
+	do {
+		n = RANGE_NEXT(old);
+		e = RANGE_END(old);
+		if (n >= e)
+			return 0;
+		mid = n + (e - n) / 2;
+	} while (!__atomic_compare_exchange_n(&victim->chunks, &old,
+			RANGE(n, mid), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	*next = mid;
+	*end = e;
+	return 1;
+}
+
+static void
+parallel_run_chunk(const struct parallel_job *job, uint32_t chunk)
+{
+	uint64_t begin = job->begin + (uint64_t)chunk * job->grain;
+	uint64_t end = job->end - begin > job->grain ?
+		begin + job->grain : job->end;
+
+	job->fn(begin, end, job->arg);
+}
+
+/* run the chunks of an lcore, then the ones it steals from the others */
+static int
+parallel_worker(void *arg)
+{
+	struct parallel_worker *w = arg;
+	struct parallel_job *job = w->job;
+	struct parallel_range *own = &job->range[w->idx];
+	uint32_t chunk, next = 0, end = 0;
+	unsigned int i;
+
+	while (1) {
+		while (range_pop(own, &chunk))
+			parallel_run_chunk(job, chunk);
+
+		for (i = 1; i < job->nb_workers; i++) {
+			if (range_steal(&job->range[(w->idx + i) %
+					job->nb_workers], &next, &end))
+				break;
+		}
+		/* nothing left, the chunks being run will be waited for */
+		if (i == job->nb_workers)
+			return 0;
+
+		/* publish the stolen chunks, which can be stolen again */
+		__atomic_store_n(&own->chunks, RANGE(next, end),
+				__ATOMIC_RELAXED);
+	}
+}
+
+int
+rte_parallel_for(uint64_t begin, uint64_t end, uint64_t grain,
+		rte_parallel_for_fn_t fn, void *arg)
+{
+	struct parallel_worker workers[RTE_MAX_LCORE];
+	unsigned int lcores[RTE_MAX_LCORE];
+	struct parallel_job job;
+	uint64_t nb_chunks;
+	unsigned int lcore_id, nb_workers, i;
+
+	if (fn == NULL || grain == 0 || end < begin)
+		return -EINVAL;
+	if (begin == end)
+		return 0;
+
+	nb_chunks = (end - begin - 1) / grain + 1;
+	if (nb_chunks > UINT32_MAX)
+		return -E2BIG;
+
+	/* only the master lcore can launch work on the others */
+	nb_workers = 0;
+	lcores[nb_workers++] = rte_lcore_id();
+	if (rte_lcore_id() == rte_get_master_lcore()) {
+		RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+			if (nb_workers == nb_chunks)
+				break;
+			if (rte_eal_get_lcore_state(lcore_id) != WAIT)
+				continue;
+			lcores[nb_workers++] = lcore_id;
+		}
+	}
+
+	job.begin = begin;
+	job.end = end;
+	job.grain = grain;
+	job.fn = fn;
+	job.arg = arg;
+	job.nb_workers = nb_workers;
+	for (i = 0; i < nb_workers; i++) {
+		job.range[i].chunks = RANGE(nb_chunks * i / nb_workers,
+				nb_chunks * (i + 1) / nb_workers);
+		workers[i].job = &job;
+		workers[i].idx = i;
+	}
+
+	for (i = 1; i < nb_workers; i++) {
+		/* the chunks of an lcore which became busy get stolen */
+		if (rte_eal_remote_launch(parallel_worker, &workers[i],
+				lcores[i]) < 0)
+			lcores[i] = LCORE_ID_ANY;
+	}
+	parallel_worker(&workers[0]);
+
+	for (i = 1; i < nb_workers; i++) {
+		if (lcores[i] != LCORE_ID_ANY)
+			rte_eal_wait_lcore(lcores[i]);
+	}
+
+	return 0;
+}
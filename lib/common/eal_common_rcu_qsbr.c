@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_rcu_qsbr.h>
+
+/* number of 64-bit words of the bitmap of the registered threads */
+#define QSBR_BMAP_ELEMS(max_threads) (RTE_ALIGN_CEIL(max_threads, 64) / 64)
+
+size_t
+rte_rcu_qsbr_get_memsize(uint32_t max_threads)
+{
+	if (max_threads == 0) {
+		rte_errno = EINVAL;
+		return 0;
+	}
+
+	return sizeof(struct rte_rcu_qsbr) +
+		sizeof(struct rte_rcu_qsbr_cnt) * max_threads +
+		RTE_ALIGN_CEIL(QSBR_BMAP_ELEMS(max_threads) * sizeof(uint64_t),
+				RTE_CACHE_LINE_SIZE);
+}
+
+int
+rte_rcu_qsbr_init(struct rte_rcu_qsbr *v, uint32_t max_threads)
+{
+	if (v == NULL || max_threads == 0) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	memset(v, 0, rte_rcu_qsbr_get_memsize(max_threads));
+	v->max_threads = max_threads;
+	v->num_elems = QSBR_BMAP_ELEMS(max_threads);
+	v->token = RTE_QSBR_CNT_INIT;
+
+	return 0;
+}
+
+int
+rte_rcu_qsbr_thread_register(struct rte_rcu_qsbr *v, unsigned int thread_id)
+{
+	uint64_t *reg_thread_id;
+	uint64_t bit, old;
+
+	if (v == NULL || thread_id >= v->max_threads) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	reg_thread_id = __RTE_QSBR_THRID_BMAP(v);
+	bit = 1ULL << (thread_id % 64);
+	old = __atomic_fetch_or(&reg_thread_id[thread_id / 64], bit,
+			__ATOMIC_RELEASE);
+	if (!(old & bit))
+		__atomic_fetch_add(&v->num_threads, 1, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+int
+rte_rcu_qsbr_thread_unregister(struct rte_rcu_qsbr *v, unsigned int thread_id)
+{
+	uint64_t *reg_thread_id;
+	uint64_t bit, old;
+
+	if (v == NULL || thread_id >= v->max_threads) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	reg_thread_id = __RTE_QSBR_THRID_BMAP(v);
+	bit = 1ULL << (thread_id % 64);
+	old = __atomic_fetch_and(&reg_thread_id[thread_id / 64], ~bit,
+			__ATOMIC_RELEASE);
+	if (old & bit)
+		__atomic_fetch_sub(&v->num_threads, 1, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+void
+rte_rcu_qsbr_synchronize(struct rte_rcu_qsbr *v, unsigned int thread_id)
+{
+	uint64_t t;
+
+	if (thread_id != RTE_QSBR_THRID_INVALID)
+		rte_rcu_qsbr_quiescent(v, thread_id);
+
+	t = rte_rcu_qsbr_start(v);
+	rte_rcu_qsbr_check(v, t, true);
+}
+
+void
+rte_rcu_qsbr_dump(FILE *f, struct rte_rcu_qsbr *v)
+{
+	uint64_t *reg_thread_id = __RTE_QSBR_THRID_BMAP(v);
+	uint64_t bmap;
+	unsigned int i, j;
+
+	fprintf(f, "QSBR variable @%p\n", v);
+	fprintf(f, "  max_threads=%u\n", v->max_threads);
+	fprintf(f, "  num_threads=%u\n", v->num_threads);
+	fprintf(f, "  token=%" PRIu64 "\n", v->token);
+	fprintf(f, "  quiescent states:\n");
+	for (i = 0; i < v->num_elems; i++) {
+		bmap = reg_thread_id[i];
+		while (bmap != 0) {
+			j = __builtin_ctzll(bmap);
+			fprintf(f, "    thread %u: %" PRIu64 "\n", i * 64 + j,
+				v->qsbr_cnt[i * 64 + j].cnt);
+			bmap &= ~(1ULL << j);
+		}
+	}
+}
@@ -83,6 +83,29 @@ eal_get_hugefile_path(char *buffer, size_t buflen, const char *hugedir, int f_id
 	return buffer;
 }
 
+/** String format for hugepage memfd names in in-memory mode. */
+#define HUGEFILE_MEMFD_FMT "%smap_%d"
+static inline const char *
+eal_get_hugefile_memfd_name(char *buffer, size_t buflen, int f_id)
+{
+	snprintf(buffer, buflen, HUGEFILE_MEMFD_FMT,
+			internal_config.hugefile_prefix, f_id);
+	buffer[buflen - 1] = '\0';
+	return buffer;
+}
+
+/** Name of the abstract unix socket sharing the memfds in in-memory mode. */
+#define MEMFD_SOCKET_FMT "%s_memfd_%u"
+static inline const char *
+eal_memfd_socket_name(void)
+{
+	static char buffer[PATH_MAX]; /* static so auto-zeroed */
+
+	snprintf(buffer, sizeof(buffer) - 1, MEMFD_SOCKET_FMT,
+		 internal_config.hugefile_prefix, (unsigned int)getuid());
+	return buffer;
+}
+
 /** define the default filename prefix for the %s values above */
 #define HUGEFILE_PREFIX_DEFAULT "rte"
 
@@ -23,6 +23,8 @@ struct hugepage_file {
 	int socket_id;      /**< NUMA socket ID */
 	int file_id;        /**< the '%d' in HUGEFILE_FMT */
 	int memseg_id;      /**< the memory segment to which page belongs */
+	int fd;             /**< memfd backing the page in in-memory mode */
+	uint64_t file_offset; /**< offset of the page in its backing file */
 	char filepath[MAX_HUGEPAGE_PATH]; /**< path to backing file on filesystem */
 };
 
@@ -32,4 +34,19 @@ struct hugepage_file {
  */
 int eal_hugepage_info_init(void);
 
+/**
+ * Create an anonymous hugetlb file of len bytes backed by pages of
+ * hugepage_sz, for the in-memory mode. Return its fd, or -1 on error.
+ */
+int eal_hugepage_memfd_create(const char *name, uint64_t hugepage_sz,
+		size_t len);
+
+/**
+ * Get the memfd of the memory segment idx added at runtime from the memfd
+ * server of the primary process, in in-memory mode. The request fails if
+ * the generation of the segment is not gen anymore. Return the fd, or -1
+ * on error.
+ */
+int eal_memfd_request_seg(unsigned int idx, uint32_t gen);
+
 #endif /* EAL_HUGEPAGES_H */
@@ -35,6 +35,18 @@ struct internal_config {
 	volatile unsigned force_nrank;    /**< force number of ranks */
 	volatile unsigned no_hugetlbfs;   /**< true to disable hugetlbfs */
 	unsigned hugepage_unlink;         /**< true to unlink backing files */
+	/** true to back hugepages with memfd, only set internally as no
+	 *  command line option selects it */
+	volatile unsigned in_memory;
+	/** true to grow heaps at runtime, only set internally */
+	volatile unsigned memory_hotplug;
+	/** true to back all the hugepages of a size with a single file, only
+	 *  set internally */
+	volatile unsigned single_file_segments;
+	/** true to map memsegs of a secondary process on first access, i.e.
+	 *  system calls fail with EFAULT on memsegs not accessed yet; only set
+	 *  internally */
+	volatile unsigned lazy_attach;
 	volatile unsigned vmware_tsc_map; /**< true to use VMware TSC mapping
 										* instead of native TSC */
 	volatile enum rte_proc_type_t process_type; /**< multi-process proc type */
@@ -49,6 +61,7 @@ struct internal_config {
 			/**< user defined mbuf pool ops name */
 	unsigned num_hugepage_sizes;      /**< how many sizes on this system */
 	struct hugepage_info hugepage_info[MAX_HUGEPAGE_SIZES];
+	enum rte_iova_mode iova_mode;     /**< Set IOVA mode on this system */
 };
 extern struct internal_config internal_config; /**< Global EAL configuration. */
 
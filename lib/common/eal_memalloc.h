@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef EAL_MEMALLOC_H
+#define EAL_MEMALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <rte_memory.h>
+
+/**
+ * Reserve the virtual area of the memory segments added at runtime. The
+ * primary process reserves RTE_MAX_HOTPLUG_MEM_MB if memory hotplug is
+ * enabled, and secondary processes reserve the same area, so that the
+ * segments are mapped at the same address in all the processes.
+ *
+ * This function is private to the EAL.
+ *
+ * @return
+ *   0 on success, -1 if the area cannot be reserved.
+ */
+int eal_memalloc_init(void);
+
+/**
+ * Allocate a new memory segment of len bytes of hugepages of size page_sz
+ * on socket_id, after init. The segment is backed by a single file, or a
+ * single memfd in in-memory mode, and takes the first free entry of the
+ * memseg table. It is mapped in the reserved virtual area, after the
+ * segments added before.
+ *
+ * This function is private to the EAL, and only called from the primary
+ * process.
+ *
+ * @return
+ *   The new memseg, or NULL on error.
+ */
+struct rte_memseg *
+eal_memalloc_alloc_seg(size_t len, uint64_t page_sz, int socket_id);
+
+/**
+ * Release a memory segment added by eal_memalloc_alloc_seg(). To keep the
+ * memseg table without holes, only the last segment of the table can be
+ * released.
+ *
+ * This function is private to the EAL, and only called from the primary
+ * process.
+ *
+ * @return
+ *   0 on success, -EINVAL if the segment was not added at runtime, -EBUSY
+ *   if it is not the last one.
+ */
+int eal_memalloc_free_seg(struct rte_memseg *ms);
+
+/**
+ * Return the last memory segment of the table if it was added at runtime,
+ * else NULL.
+ *
+ * This function is private to the EAL.
+ */
+struct rte_memseg *eal_memalloc_last_seg(void);
+
+/**
+ * Return true if the memory segment was added at runtime.
+ *
+ * This function is private to the EAL.
+ */
+int eal_memalloc_is_hotplug(const struct rte_memseg *ms);
+
+/**
+ * Return a duplicate of the memfd of the memory segment idx added at
+ * runtime in in-memory mode, if the generation of the segment is gen. The
+ * caller closes it.
+ *
+ * This function is private to the EAL, and only called from the primary
+ * process.
+ *
+ * @return
+ *   The fd, or -1 if the segment was released or replaced.
+ */
+int eal_memalloc_seg_fd(unsigned int idx, uint32_t gen);
+
+/**
+ * Map the segments added by the primary process since the last call, and
+ * unmap the released ones.
+ *
+ * This function is private to the EAL, and only called from secondary
+ * processes.
+ *
+ * @return
+ *   0 on success, -1 if a segment cannot be mapped.
+ */
+int eal_memalloc_sync(void);
+
+#endif /* EAL_MEMALLOC_H */
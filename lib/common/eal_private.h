@@ -56,6 +56,30 @@ int rte_eal_cpu_init(void);
  */
 int rte_eal_memory_init(void);
 
+/**
+ * Add a memseg to the virtual address lookup table of the memory config,
+ * after the memseg is filled.
+ *
+ * This function is private to EAL, and only called from the primary
+ * process.
+ *
+ * @param idx
+ *   The index of the memseg in the memseg table.
+ */
+void eal_mem_lookup_add(unsigned int idx);
+
+/**
+ * Remove a memseg from the virtual address lookup table of the memory
+ * config, before the memseg is cleared.
+ *
+ * This function is private to EAL, and only called from the primary
+ * process.
+ *
+ * @param idx
+ *   The index of the memseg in the memseg table.
+ */
+void eal_mem_lookup_del(unsigned int idx);
+
 /**
  * Configure timers
  *
@@ -159,4 +183,13 @@ int rte_eal_hugepage_init(void);
  */
 int rte_eal_hugepage_attach(void);
 
+/**
+ * Stop serving the hugepage memfds to secondary processes, in in-memory
+ * mode, and close the server socket. Nothing is done if the server does
+ * not run.
+ *
+ * This function is private to the EAL.
+ */
+void rte_eal_memfd_server_stop(void);
+
 #endif /* _EAL_PRIVATE_H_ */
@@ -46,6 +46,7 @@
 
 #include <stdint.h>
 #include <rte_common.h>
+#include <rte_branch_prediction.h>
 #include <rte_atomic.h>
 
 /*------------------------- 64 bit atomic operations -------------------------*/
@@ -196,4 +197,52 @@ static inline void rte_atomic64_clear(rte_atomic64_t *v)
 }
 #endif
 
+/*------------------------ 128 bit atomic operations -------------------------*/
+
+extern uint8_t rte_cmpxchg16b_supported; /* cache the CPU flag */
+
+/**
+ * Emulation of rte_atomic128_cmp_exchange() for the CPUs not having the
+ * cmpxchg16b instruction.
+ * @internal
+ */
+int __rte_atomic128_cmp_exchange_emul(rte_int128_t *dst, rte_int128_t *exp,
+		const rte_int128_t *src);
+
+static inline int
+rte_atomic128_cmp_exchange(rte_int128_t *dst, rte_int128_t *exp,
+		const rte_int128_t *src, unsigned int weak, int success,
+		int failure)
+{
+	uint8_t res;
+
+	/* a locked cmpxchg16b is a full barrier, for any memory order */
+	RTE_SET_USED(weak);
+	RTE_SET_USED(success);
+	RTE_SET_USED(failure);
+
+#ifndef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+	/* not known to be available at build time, check the CPU */
+	if (unlikely(!rte_cmpxchg16b_supported))
+		return __rte_atomic128_cmp_exchange_emul(dst, exp, src);
+#endif
+
+	asm volatile(
+			MPLOCKED
+			"cmpxchg16b %[dst];"
+			"sete %[res]"
+			: [dst] "=m" (dst->val[0]),  /* output */
+			  "=a" (exp->val[0]),
+			  "=d" (exp->val[1]),
+			  [res] "=r" (res)
+			: "b" (src->val[0]),         /* input */
+			  "c" (src->val[1]),
+			  "a" (exp->val[0]),
+			  "d" (exp->val[1]),
+			  "m" (dst->val[0])
+			: "memory");
+
+	return res;
+}
+
 #endif /* _RTE_ATOMIC_X86_64_H_ */
@@ -9,7 +9,10 @@
 extern "C" {
 #endif
 
+#define RTE_WAIT_UNTIL_EQUAL_ARCH_DEFINED
+
 #include "generic/rte_pause.h"
+#include "rte_power_intrinsics.h"
 
 #include <emmintrin.h>
 static inline void rte_pause(void)
@@ -17,6 +20,54 @@ static inline void rte_pause(void)
 	_mm_pause();
 }
 
+/*
+ * Number of pauses before sleeping on the address: most waits are shorter
+ * than the time to enter and leave the sleep state.
+ */
+#define RTE_WAIT_UNTIL_EQUAL_SPINS 32
+
+/*
+ * Spin a while, then sleep until the value is written to if the CPU
+ * supports WAITPKG. The monitor is armed before the value is read again,
+ * so that a store done meanwhile is not missed. The sleep is bounded by
+ * the operating system, and may end on an unrelated store to the line.
+ */
+#define __RTE_WAIT_UNTIL_EQUAL(addr, expected, memorder) do { \
+	unsigned int __spins = 0; \
+	while (__atomic_load_n(addr, memorder) != (expected)) { \
+		if (__spins < RTE_WAIT_UNTIL_EQUAL_SPINS || \
+				!rte_waitpkg_supported) { \
+			__spins++; \
+			_mm_pause(); \
+			continue; \
+		} \
+		__rte_umonitor(addr); \
+		if (__atomic_load_n(addr, __ATOMIC_RELAXED) != (expected)) \
+			__rte_umwait(RTE_POWER_STATE_C01, UINT64_MAX); \
+	} \
+} while (0)
+
+static __rte_always_inline void
+rte_wait_until_equal_16(volatile uint16_t *addr, uint16_t expected,
+		int memorder)
+{
+	__RTE_WAIT_UNTIL_EQUAL(addr, expected, memorder);
+}
+
+static __rte_always_inline void
+rte_wait_until_equal_32(volatile uint32_t *addr, uint32_t expected,
+		int memorder)
+{
+	__RTE_WAIT_UNTIL_EQUAL(addr, expected, memorder);
+}
+
+static __rte_always_inline void
+rte_wait_until_equal_64(volatile uint64_t *addr, uint64_t expected,
+		int memorder)
+{
+	__RTE_WAIT_UNTIL_EQUAL(addr, expected, memorder);
+}
+
 #ifdef __cplusplus
 }
 #endif
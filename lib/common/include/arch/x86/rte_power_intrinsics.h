@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_POWER_INTRINSIC_X86_H_
+#define _RTE_POWER_INTRINSIC_X86_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+
+#include "generic/rte_power_intrinsics.h"
+#include "rte_common.h"
+
+/** Light sleep state, slower to wake up from but saving more power. */
+#define RTE_POWER_STATE_C02 0
+/** Lighter sleep state, faster to wake up from. */
+#define RTE_POWER_STATE_C01 1
+
+extern uint8_t rte_waitpkg_supported; /* cached WAITPKG flag */
+
+/*
+ * The WAITPKG instructions are emitted as bytes, as older assemblers do
+ * not know them.
+ */
+
+/* arm the monitoring of the cache line of addr */
+static __rte_always_inline void
+__rte_umonitor(const volatile void *addr)
+{
+	/* umonitor %rdi */
+	asm volatile(".byte 0xf3, 0x0f, 0xae, 0xf7;"
+			:
+			: "D"(addr)
+			: "memory");
+}
+
+/* sleep until the monitored line is written, or the TSC reaches tsc */
+static __rte_always_inline void
+__rte_umwait(uint32_t state, uint64_t tsc)
+{
+	/* umwait %edi */
+	asm volatile(".byte 0xf2, 0x0f, 0xae, 0xf7;"
+			:
+			: "D"(state), "a"((uint32_t)tsc),
+			  "d"((uint32_t)(tsc >> 32))
+			: "cc", "memory");
+}
+
+/* sleep until the TSC reaches tsc */
+static __rte_always_inline void
+__rte_tpause(uint32_t state, uint64_t tsc)
+{
+	/* tpause %edi */
+	asm volatile(".byte 0x66, 0x0f, 0xae, 0xf7;"
+			:
+			: "D"(state), "a"((uint32_t)tsc),
+			  "d"((uint32_t)(tsc >> 32))
+			: "cc", "memory");
+}
+
+static inline int
+rte_power_monitor(const volatile void *p, uint64_t expected_value,
+		uint64_t value_mask, uint64_t tsc_timestamp, uint8_t data_sz)
+{
+	uint64_t cur_value;
+
+	if (!rte_waitpkg_supported)
+		return -ENOTSUP;
+
+	__rte_umonitor(p);
+
+	/* read after arming, so that a store done meanwhile wakes us up */
+	switch (data_sz) {
+	case sizeof(uint8_t):
+		cur_value = *(const volatile uint8_t *)p;
+		break;
+	case sizeof(uint16_t):
+		cur_value = *(const volatile uint16_t *)p;
+		break;
+	case sizeof(uint32_t):
+		cur_value = *(const volatile uint32_t *)p;
+		break;
+	case sizeof(uint64_t):
+		cur_value = *(const volatile uint64_t *)p;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if ((cur_value & value_mask) == expected_value)
+		__rte_umwait(RTE_POWER_STATE_C02, tsc_timestamp);
+
+	return 0;
+}
+
+static inline int
+rte_power_pause(uint64_t tsc_timestamp)
+{
+	if (!rte_waitpkg_supported)
+		return -ENOTSUP;
+
+	__rte_tpause(RTE_POWER_STATE_C02, tsc_timestamp);
+
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_POWER_INTRINSIC_X86_H_ */
@@ -20,26 +20,6 @@ extern "C" {
 #define RTE_XABORT_LOCK_BUSY (0xff)
 
 #ifndef RTE_FORCE_INTRINSICS
-static inline void
-rte_spinlock_lock(rte_spinlock_t *sl)
-{
-	int lock_val = 1;
-	asm volatile (
-			"1:\n"
-			"xchg %[locked], %[lv]\n"
-			"test %[lv], %[lv]\n"
-			"jz 3f\n"
-			"2:\n"
-			"pause\n"
-			"cmpl $0, %[locked]\n"
-			"jnz 2b\n"
-			"jmp 1b\n"
-			"3:\n"
-			: [locked] "=m" (sl->locked), [lv] "=q" (lock_val)
-			: "[lv]" (lock_val)
-			: "memory");
-}
-
 static inline void
 rte_spinlock_unlock (rte_spinlock_t *sl)
 {
@@ -64,6 +44,14 @@ rte_spinlock_trylock (rte_spinlock_t *sl)
 
 	return lockval == 0;
 }
+
+static inline void
+rte_spinlock_lock(rte_spinlock_t *sl)
+{
+	while (unlikely(!rte_spinlock_trylock(sl)))
+		rte_wait_until_equal_32((volatile uint32_t *)&sl->locked, 0,
+				__ATOMIC_RELAXED);
+}
 #endif
 
 extern uint8_t rte_rtm_supported;
@@ -93,8 +81,8 @@ rte_try_tm(volatile int *lock)
 			else
 				return 1;
 		}
-		while (*lock)
-			rte_pause();
+		rte_wait_until_equal_32((volatile uint32_t *)lock, 0,
+				__ATOMIC_RELAXED);
 
 		if ((status & RTE_XABORT_EXPLICIT) &&
 			(RTE_XABORT_CODE(status) == RTE_XABORT_LOCK_BUSY))
@@ -106,6 +94,61 @@ rte_try_tm(volatile int *lock)
 	return 0;
 }
 
+static inline int
+rte_try_tm_adapt(volatile int *lock, struct rte_tm_adapt *adapt)
+{
+	unsigned int status;
+	int retries;
+
+	if (!rte_rtm_supported)
+		return 0;
+
+	if (__atomic_load_n(&adapt->skip, __ATOMIC_RELAXED) > 0) {
+		__atomic_fetch_sub(&adapt->skip, 1, __ATOMIC_RELAXED);
+		goto fallback;
+	}
+
+	/*
+	 * The state is neither read nor written in the transaction, so that
+	 * the counter updates of other lcores do not abort it: the streak is
+	 * reset by rte_tm_adapt_commit() once the transaction is over.
+	 */
+	retries = RTE_RTM_MAX_RETRIES;
+
+	while (likely(retries--)) {
+		status = rte_xbegin();
+
+		if (likely(RTE_XBEGIN_STARTED == status)) {
+			if (unlikely(*lock))
+				rte_xabort(RTE_XABORT_LOCK_BUSY);
+			return 1;
+		}
+		__atomic_fetch_add(&adapt->aborts, 1, __ATOMIC_RELAXED);
+		rte_wait_until_equal_32((volatile uint32_t *)lock, 0,
+				__ATOMIC_RELAXED);
+
+		if ((status & RTE_XABORT_EXPLICIT) &&
+			(RTE_XABORT_CODE(status) == RTE_XABORT_LOCK_BUSY))
+			continue;
+
+		if ((status & RTE_XABORT_RETRY) == 0) /* do not retry */
+			break;
+	}
+
+	/* elision keeps failing on this lock, stop trying for a while */
+	if (__atomic_add_fetch(&adapt->fail_streak, 1, __ATOMIC_RELAXED) >=
+			RTE_TM_ADAPT_FAIL_STREAK) {
+		__atomic_store_n(&adapt->fail_streak, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&adapt->skip, RTE_TM_ADAPT_SKIP,
+				__ATOMIC_RELAXED);
+		__atomic_fetch_add(&adapt->disables, 1, __ATOMIC_RELAXED);
+	}
+
+fallback:
+	__atomic_fetch_add(&adapt->fallbacks, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
 static inline void
 rte_spinlock_lock_tm(rte_spinlock_t *sl)
 {
@@ -922,4 +922,49 @@ static inline void rte_atomic64_clear(rte_atomic64_t *v)
 }
 #endif
 
+/*------------------------ 128 bit atomic operations -------------------------*/
+
+/**
+ * 128-bit integer structure, aligned on 16 bytes as required by the 128-bit
+ * atomic operations.
+ */
+RTE_STD_C11
+typedef struct {
+	RTE_STD_C11
+	union {
+		uint64_t val[2];
+		__extension__ __int128 int128;
+	};
+} __rte_aligned(16) rte_int128_t;
+
+/**
+ * An atomic compare and exchange function on 128-bit values.
+ *
+ * If *dst == *exp, *src is written to *dst, else *dst is copied to *exp.
+ * The operation is lock-free if the CPU supports it, else it is emulated
+ * with a lock, and is then only atomic with regard to the other
+ * rte_atomic128_cmp_exchange() calls of the same process.
+ *
+ * @param dst
+ *   The destination into which the value will be written.
+ * @param exp
+ *   Pointer to the expected value. If the operation fails, it is
+ *   overwritten with the current value of the destination.
+ * @param src
+ *   Pointer to the new value.
+ * @param weak
+ *   If true, the operation may fail spuriously.
+ * @param success
+ *   Memory ordering if the exchange is done, one of __ATOMIC_*.
+ * @param failure
+ *   Memory ordering if the exchange is not done, one of __ATOMIC_*, not
+ *   stronger than success.
+ * @return
+ *   Non-zero on success; 0 on failure.
+ */
+static inline int
+rte_atomic128_cmp_exchange(rte_int128_t *dst, rte_int128_t *exp,
+		const rte_int128_t *src, unsigned int weak, int success,
+		int failure);
+
 #endif /* _RTE_ATOMIC_H_ */
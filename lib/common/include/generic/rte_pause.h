@@ -12,6 +12,10 @@
  *
  */
 
+#include <stdint.h>
+
+#include <rte_common.h>
+
 /**
  * Pause CPU execution for a short while
  *
@@ -20,4 +24,79 @@
  */
 static inline void rte_pause(void);
 
+/**
+ * Wait until a 16-bit value in memory is equal to an expected value.
+ *
+ * This replaces a loop polling the value with rte_pause(), and lets the
+ * architecture wait in a more efficient way when it can, e.g. sleeping
+ * until the value is written to.
+ *
+ * @param addr
+ *   A pointer to the memory location.
+ * @param expected
+ *   The value to wait for.
+ * @param memorder
+ *   The memory order of the load of the value: __ATOMIC_ACQUIRE or
+ *   __ATOMIC_RELAXED.
+ */
+static __rte_always_inline void
+rte_wait_until_equal_16(volatile uint16_t *addr, uint16_t expected,
+		int memorder);
+
+/**
+ * Wait until a 32-bit value in memory is equal to an expected value.
+ *
+ * @param addr
+ *   A pointer to the memory location.
+ * @param expected
+ *   The value to wait for.
+ * @param memorder
+ *   The memory order of the load of the value: __ATOMIC_ACQUIRE or
+ *   __ATOMIC_RELAXED.
+ */
+static __rte_always_inline void
+rte_wait_until_equal_32(volatile uint32_t *addr, uint32_t expected,
+		int memorder);
+
+/**
+ * Wait until a 64-bit value in memory is equal to an expected value.
+ *
+ * @param addr
+ *   A pointer to the memory location.
+ * @param expected
+ *   The value to wait for.
+ * @param memorder
+ *   The memory order of the load of the value: __ATOMIC_ACQUIRE or
+ *   __ATOMIC_RELAXED.
+ */
+static __rte_always_inline void
+rte_wait_until_equal_64(volatile uint64_t *addr, uint64_t expected,
+		int memorder);
+
+#ifndef RTE_WAIT_UNTIL_EQUAL_ARCH_DEFINED
+static __rte_always_inline void
+rte_wait_until_equal_16(volatile uint16_t *addr, uint16_t expected,
+		int memorder)
+{
+	while (__atomic_load_n(addr, memorder) != expected)
+		rte_pause();
+}
+
+static __rte_always_inline void
+rte_wait_until_equal_32(volatile uint32_t *addr, uint32_t expected,
+		int memorder)
+{
+	while (__atomic_load_n(addr, memorder) != expected)
+		rte_pause();
+}
+
+static __rte_always_inline void
+rte_wait_until_equal_64(volatile uint64_t *addr, uint64_t expected,
+		int memorder)
+{
+	while (__atomic_load_n(addr, memorder) != expected)
+		rte_pause();
+}
+#endif
+
 #endif /* _RTE_PAUSE_H_ */
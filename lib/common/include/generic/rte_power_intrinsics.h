@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_POWER_INTRINSIC_H_
+#define _RTE_POWER_INTRINSIC_H_
+
+#include <stdint.h>
+
+/**
+ * @file
+ * Power management intrinsics.
+ *
+ * These functions put the core in a light power saving state while it
+ * waits for a store to an address or for a point in time, instead of
+ * spinning on the load. The core wakes up much faster from these states
+ * than from the idle states of the kernel. They are not supported by every
+ * CPU, in which case the caller must fall back to a polling loop.
+ */
+
+/**
+ * Monitor an address and sleep until it is written to, or until the TSC
+ * reaches a deadline.
+ *
+ * The value at the address is read once the monitoring started: if it no
+ * longer matches the expected value, the function returns at once, so that
+ * a store happening just before the call is not missed. The core may also
+ * wake up early, on an interrupt for instance: the caller must read the
+ * value again after the call.
+ *
+ * @param p
+ *   The address to monitor, read with a size of data_sz bytes.
+ * @param expected_value
+ *   The value of the masked data at the address to sleep on.
+ * @param value_mask
+ *   The mask applied to the data read before comparing it.
+ * @param tsc_timestamp
+ *   The TSC value at which to wake up at the latest. The operating system
+ *   may bound the duration of the sleep.
+ * @param data_sz
+ *   The size of the data at the address: 1, 2, 4 or 8.
+ * @return
+ *   0 on success, -EINVAL on invalid parameters, -ENOTSUP if the CPU does
+ *   not support monitoring an address.
+ */
+static inline int
+rte_power_monitor(const volatile void *p, uint64_t expected_value,
+		uint64_t value_mask, uint64_t tsc_timestamp, uint8_t data_sz);
+
+/**
+ * Sleep until the TSC reaches a deadline.
+ *
+ * @param tsc_timestamp
+ *   The TSC value at which to wake up. The operating system may bound the
+ *   duration of the sleep.
+ * @return
+ *   0 on success, -ENOTSUP if the CPU does not support timed pauses.
+ */
+static inline int
+rte_power_pause(uint64_t tsc_timestamp);
+
+#endif /* _RTE_POWER_INTRINSIC_H_ */
@@ -51,4 +51,22 @@ static inline void rte_prefetch2(const volatile void *p);
  */
 static inline void rte_prefetch_non_temporal(const volatile void *p);
 
+/**
+ * Prefetch a cache line into all cache levels, with the intention to write
+ * to it.
+ *
+ * The cache line is fetched in exclusive state, saving the request for
+ * ownership of the first write when the CPU supports it (prefetchw on x86),
+ * otherwise it is a plain rte_prefetch0().
+ *
+ * @param p
+ *   Address to prefetch
+ */
+static inline void
+rte_prefetch0_write(const void *p)
+{
+	/* 1 for a write, 3 for all the cache levels */
+	__builtin_prefetch(p, 1, 3);
+}
+
 #endif /* _RTE_PREFETCH_H_ */
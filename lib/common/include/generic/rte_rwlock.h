@@ -22,6 +22,7 @@ extern "C" {
 #endif
 
 #include <rte_common.h>
+#include <rte_branch_prediction.h>
 #include <rte_atomic.h>
 #include <rte_pause.h>
 
@@ -75,6 +76,30 @@ rte_rwlock_read_lock(rte_rwlock_t *rwl)
 	}
 }
 
+/**
+ * Try to take a read lock.
+ *
+ * @param rwl
+ *   A pointer to a rwlock structure.
+ * @return
+ *   0 if the lock is taken, -EBUSY if a writer holds it.
+ */
+static inline int
+rte_rwlock_read_trylock(rte_rwlock_t *rwl)
+{
+	int32_t x;
+
+	do {
+		x = rwl->cnt;
+		/* write lock is held */
+		if (x < 0)
+			return -EBUSY;
+	} while (rte_atomic32_cmpset((volatile uint32_t *)&rwl->cnt,
+				     (uint32_t)x, (uint32_t)(x + 1)) == 0);
+
+	return 0;
+}
+
 /**
  * Release a read lock.
  *
@@ -111,6 +136,25 @@ rte_rwlock_write_lock(rte_rwlock_t *rwl)
 	}
 }
 
+/**
+ * Try to take a write lock.
+ *
+ * @param rwl
+ *   A pointer to a rwlock structure.
+ * @return
+ *   0 if the lock is taken, -EBUSY if a reader or writer holds it.
+ */
+static inline int
+rte_rwlock_write_trylock(rte_rwlock_t *rwl)
+{
+	if (rwl->cnt != 0 ||
+			rte_atomic32_cmpset((volatile uint32_t *)&rwl->cnt,
+					    0, (uint32_t)-1) == 0)
+		return -EBUSY;
+
+	return 0;
+}
+
 /**
  * Release a write lock.
  *
@@ -173,6 +217,183 @@ rte_rwlock_write_lock_tm(rte_rwlock_t *rwl);
 static inline void
 rte_rwlock_write_unlock_tm(rte_rwlock_t *rwl);
 
+/**
+ * The rte_rwlock_wp_t type, a writer-preferring read-write lock.
+ *
+ * A writer waiting for the lock sets the RTE_RWLOCK_WP_WAIT bit, which
+ * keeps new readers out until it got the lock, so that a steady stream of
+ * readers cannot starve it. As a consequence, a reader must not take the
+ * read lock again while holding it, as it would wait for a writer waiting
+ * for the first read lock; rte_rwlock_t allows it.
+ *
+ * cnt holds the number of readers times RTE_RWLOCK_WP_READ, and the
+ * RTE_RWLOCK_WP_WAIT and RTE_RWLOCK_WP_WRITE bits.
+ */
+typedef struct {
+	volatile int32_t cnt; /**< readers, writer waiting and writer bits */
+} rte_rwlock_wp_t;
+
+#define RTE_RWLOCK_WP_WAIT  0x1 /**< a writer is waiting */
+#define RTE_RWLOCK_WP_WRITE 0x2 /**< a writer holds the lock */
+#define RTE_RWLOCK_WP_MASK  (RTE_RWLOCK_WP_WAIT | RTE_RWLOCK_WP_WRITE)
+#define RTE_RWLOCK_WP_READ  0x4 /**< increment for each reader */
+
+/**
+ * A static writer-preferring rwlock initializer.
+ */
+#define RTE_RWLOCK_WP_INITIALIZER { 0 }
+
+/**
+ * Initialize the writer-preferring rwlock to an unlocked state.
+ *
+ * @param rwl
+ *   A pointer to the rwlock structure.
+ */
+static inline void
+rte_rwlock_wp_init(rte_rwlock_wp_t *rwl)
+{
+	rwl->cnt = 0;
+}
+
+/**
+ * Take a read lock of a writer-preferring rwlock. Loop until the lock is
+ * held, no writer holding nor waiting for it.
+ *
+ * @param rwl
+ *   A pointer to a rwlock structure.
+ */
+static inline void
+rte_rwlock_wp_read_lock(rte_rwlock_wp_t *rwl)
+{
+	int32_t x;
+
+	while (1) {
+		/* wait while a writer holds or waits for the lock */
+		while (__atomic_load_n(&rwl->cnt, __ATOMIC_RELAXED) &
+				RTE_RWLOCK_WP_MASK)
+			rte_pause();
+
+		x = __atomic_add_fetch(&rwl->cnt, RTE_RWLOCK_WP_READ,
+				__ATOMIC_ACQUIRE);
+		if (likely(!(x & RTE_RWLOCK_WP_MASK)))
+			return;
+
+		/* a writer came meanwhile, let it go first */
+		__atomic_fetch_sub(&rwl->cnt, RTE_RWLOCK_WP_READ,
+				__ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * Try to take a read lock of a writer-preferring rwlock.
+ *
+ * @param rwl
+ *   A pointer to a rwlock structure.
+ * @return
+ *   0 if the lock is taken, -EBUSY if a writer holds or waits for it.
+ */
+static inline int
+rte_rwlock_wp_read_trylock(rte_rwlock_wp_t *rwl)
+{
+	int32_t x;
+
+	x = __atomic_load_n(&rwl->cnt, __ATOMIC_RELAXED);
+	if (x & RTE_RWLOCK_WP_MASK)
+		return -EBUSY;
+
+	x = __atomic_add_fetch(&rwl->cnt, RTE_RWLOCK_WP_READ,
+			__ATOMIC_ACQUIRE);
+	if (unlikely(x & RTE_RWLOCK_WP_MASK)) {
+		__atomic_fetch_sub(&rwl->cnt, RTE_RWLOCK_WP_READ,
+				__ATOMIC_RELAXED);
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+/**
+ * Release a read lock of a writer-preferring rwlock.
+ *
+ * @param rwl
+ *   A pointer to the rwlock structure.
+ */
+static inline void
+rte_rwlock_wp_read_unlock(rte_rwlock_wp_t *rwl)
+{
+	__atomic_fetch_sub(&rwl->cnt, RTE_RWLOCK_WP_READ, __ATOMIC_RELEASE);
+}
+
+/**
+ * Take a write lock of a writer-preferring rwlock. Loop until the lock is
+ * held, keeping new readers out meanwhile.
+ *
+ * @param rwl
+ *   A pointer to a rwlock structure.
+ */
+static inline void
+rte_rwlock_wp_write_lock(rte_rwlock_wp_t *rwl)
+{
+	int32_t x;
+
+	while (1) {
+		x = __atomic_load_n(&rwl->cnt, __ATOMIC_RELAXED);
+
+		/* no reader nor writer, take the lock and clear the wait bit */
+		if (likely(x < RTE_RWLOCK_WP_WRITE)) {
+			if (__atomic_compare_exchange_n(&rwl->cnt, &x,
+					RTE_RWLOCK_WP_WRITE, 1,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				return;
+		}
+
+		/* keep new readers out */
+		if (!(x & RTE_RWLOCK_WP_WAIT))
+			__atomic_fetch_or(&rwl->cnt, RTE_RWLOCK_WP_WAIT,
+					__ATOMIC_RELAXED);
+
+		/* wait for the readers and the writer to leave */
+		while (__atomic_load_n(&rwl->cnt, __ATOMIC_RELAXED) >
+				RTE_RWLOCK_WP_WAIT)
+			rte_pause();
+	}
+}
+
+/**
+ * Try to take a write lock of a writer-preferring rwlock.
+ *
+ * @param rwl
+ *   A pointer to a rwlock structure.
+ * @return
+ *   0 if the lock is taken, -EBUSY if a reader or writer holds it.
+ */
+static inline int
+rte_rwlock_wp_write_trylock(rte_rwlock_wp_t *rwl)
+{
+	int32_t x;
+
+	x = __atomic_load_n(&rwl->cnt, __ATOMIC_RELAXED);
+	if (x >= RTE_RWLOCK_WP_WRITE ||
+			!__atomic_compare_exchange_n(&rwl->cnt, &x,
+				RTE_RWLOCK_WP_WRITE, 0, __ATOMIC_ACQUIRE,
+				__ATOMIC_RELAXED))
+		return -EBUSY;
+
+	return 0;
+}
+
+/**
+ * Release a write lock of a writer-preferring rwlock.
+ *
+ * @param rwl
+ *   A pointer to a rwlock structure.
+ */
+static inline void
+rte_rwlock_wp_write_unlock(rte_rwlock_wp_t *rwl)
+{
+	__atomic_fetch_sub(&rwl->cnt, RTE_RWLOCK_WP_WRITE, __ATOMIC_RELEASE);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -62,8 +62,8 @@ static inline void
 rte_spinlock_lock(rte_spinlock_t *sl)
 {
 	while (__sync_lock_test_and_set(&sl->locked, 1))
-		while(sl->locked)
-			rte_pause();
+		rte_wait_until_equal_32((volatile uint32_t *)&sl->locked, 0,
+				__ATOMIC_RELAXED);
 }
 #endif
 
@@ -124,6 +124,58 @@ static inline int rte_spinlock_is_locked (rte_spinlock_t *sl)
  */
 static inline int rte_tm_supported(void);
 
+/**
+ * Adaptive elision state of a lock, with its abort counters. A lock whose
+ * elided critical sections keep aborting, because they conflict with
+ * writers or exceed the transaction capacity, is taken without elision
+ * for a while, instead of paying for the aborts on every acquisition.
+ */
+struct rte_tm_adapt {
+	int32_t skip;         /**< acquisitions left without elision */
+	uint32_t fail_streak; /**< elision failures in a row */
+	uint64_t aborts;      /**< aborted transactions */
+	uint64_t fallbacks;   /**< acquisitions which took the lock */
+	uint64_t disables;    /**< times elision was disabled after failures */
+};
+
+/** Elision failures in a row disabling the elision of a lock. */
+#define RTE_TM_ADAPT_FAIL_STREAK 4
+/** Acquisitions of the lock without elision once disabled. */
+#define RTE_TM_ADAPT_SKIP 256
+
+/**
+ * Try to start a hardware memory transaction eliding a lock, unless the
+ * elision of the lock was disabled after repeated failures.
+ *
+ * @param lock
+ *   A pointer to the lock word, 0 when the lock is free.
+ * @param adapt
+ *   A pointer to the adaptive elision state of the lock.
+ * @return
+ *   1 if the transaction started, the lock must then be released with
+ *   the _tm unlock function of its type; 0 if the caller must take the
+ *   lock.
+ */
+static inline int
+rte_try_tm_adapt(volatile int *lock, struct rte_tm_adapt *adapt);
+
+/**
+ * Record that a critical section entered with rte_try_tm_adapt() was
+ * elided, ending the streak of elision failures of its lock. It must be
+ * called after the transaction committed, i.e. after the _tm unlock
+ * function, so that the transaction never writes the adaptive state which
+ * the other lcores update.
+ *
+ * @param adapt
+ *   A pointer to the adaptive elision state of the lock.
+ */
+static inline void
+rte_tm_adapt_commit(struct rte_tm_adapt *adapt)
+{
+	if (__atomic_load_n(&adapt->fail_streak, __ATOMIC_RELAXED) != 0)
+		__atomic_store_n(&adapt->fail_streak, 0, __ATOMIC_RELAXED);
+}
+
 /**
  * Try to execute critical section in a hardware memory transaction,
  * if it fails or not available take the spinlock.
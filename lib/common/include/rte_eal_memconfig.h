@@ -5,18 +5,94 @@
 #ifndef _RTE_EAL_MEMCONFIG_H_
 #define _RTE_EAL_MEMCONFIG_H_
 
+#include <stdio.h>
+
 #include <rte_config.h>
 #include <rte_tailq.h>
 #include <rte_memory.h>
 #include <rte_memzone.h>
 #include <rte_malloc_heap.h>
 #include <rte_rwlock.h>
+#include <rte_ticketlock.h>
 #include <rte_pause.h>
+#include <rte_lock_prof.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Maximum length of the backing file path of a memseg added at runtime. */
+#define RTE_MEMSEG_FILE_LEN 128
+
+/**
+ * Backing file of a memseg added at runtime, for secondary processes.
+ */
+struct rte_memseg_file {
+	uint32_t gen;                    /**< memseg_gen when it was added. */
+	char path[RTE_MEMSEG_FILE_LEN];  /**< Path to open, empty if none. */
+} __attribute__((__packed__));
+
+/** Granularity of the memseg lookup table, 2M. */
+#define RTE_MEM_LOOKUP_SHIFT 21
+/** VA space covered by one level 2 table of the memseg lookup, 1G. */
+#define RTE_MEM_LOOKUP_L1_SHIFT 30
+/** VA space covered by the memseg lookup, other addresses are scanned. */
+#define RTE_MEM_LOOKUP_VA_BITS 47
+#define RTE_MEM_LOOKUP_L1_SIZE \
+	(1UL << (RTE_MEM_LOOKUP_VA_BITS - RTE_MEM_LOOKUP_L1_SHIFT))
+#define RTE_MEM_LOOKUP_L2_SIZE \
+	(1UL << (RTE_MEM_LOOKUP_L1_SHIFT - RTE_MEM_LOOKUP_SHIFT))
+/** Number of level 2 tables, i.e. 1G areas of VA space with memsegs. */
+#define RTE_MEM_LOOKUP_NB_L2 256
+/** Lookup entry of a 2M area shared by several memsegs. */
+#define RTE_MEM_LOOKUP_MULTI UINT16_MAX
+
+/**
+ * Two-level table giving the memseg of any virtual address in O(1). Each
+ * entry holds the index + 1 of the memseg covering a 2M area, 0 if none,
+ * or RTE_MEM_LOOKUP_MULTI when the area is shared by several memsegs, in
+ * which case the memsegs are scanned. It is read without lock, and only
+ * updated from the primary process when a memseg is added or removed.
+ */
+struct rte_mem_lookup {
+	/** Index + 1 of the level 2 table of each 1G area, 0 if none. */
+	uint16_t l1[RTE_MEM_LOOKUP_L1_SIZE];
+	/** Memseg index + 1 of each 2M area. */
+	uint16_t l2[RTE_MEM_LOOKUP_NB_L2][RTE_MEM_LOOKUP_L2_SIZE];
+	uint16_t nb_l2;     /**< Number of level 2 tables in use. */
+	uint8_t overflow;   /**< Set if level 2 tables ran out. */
+};
+
+/**
+ * Lock of the memzones and heap table, chosen at build time: a rwlock by
+ * default, a recursive ticket lock with RTE_MCFG_MEM_LOCK_TICKET, or a
+ * writer-preferring rwlock with RTE_MCFG_MEM_LOCK_WP. The ticket lock does
+ * not let readers share it, but serves the lcores in order, so that a
+ * stream of lookups cannot starve a reservation. It is recursive, as a
+ * rte_memzone_walk() callback may look up memzones. The writer-preferring
+ * rwlock keeps readers sharing it without starving the reservations, but
+ * its read lock must not be nested, so a rte_memzone_walk() callback must
+ * then not look up memzones. Neither is elided by the _tm functions.
+ */
+#if defined(RTE_MCFG_MEM_LOCK_TICKET)
+typedef rte_ticketlock_recursive_t rte_mcfg_lock_t;
+#elif defined(RTE_MCFG_MEM_LOCK_WP)
+typedef rte_rwlock_wp_t rte_mcfg_lock_t;
+#else
+typedef rte_rwlock_t rte_mcfg_lock_t;
+#endif
+
+/**
+ * Lock of the tailqs and of the mempools: a rwlock, writer-preferring with
+ * RTE_MCFG_MEM_LOCK_WP, in which case their read locks must not be nested
+ * either, nor elided.
+ */
+#ifdef RTE_MCFG_MEM_LOCK_WP
+typedef rte_rwlock_wp_t rte_mcfg_rwlock_t;
+#else
+typedef rte_rwlock_t rte_mcfg_rwlock_t;
+#endif
+
 /**
  * the structure for the memory configuration for the RTE.
  * Used by the rte_config structure. It is separated out, as for multi-process
@@ -33,12 +109,15 @@ struct rte_mem_config {
 	 * current lock nest order
 	 *  - qlock->mlock (ring/hash/lpm)
 	 *  - mplock->qlock->mlock (mempool)
+	 *  - mlock->heap lock->memseg_lock (malloc)
 	 * Notice:
 	 *  *ALWAYS* obtain qlock first if having to obtain both qlock and mlock
 	 */
-	rte_rwlock_t mlock;   /**< only used by memzone LIB for thread-safe. */
-	rte_rwlock_t qlock;   /**< used for tailq operation for thread safe. */
-	rte_rwlock_t mplock;  /**< only used by mempool LIB for thread-safe. */
+	rte_mcfg_lock_t mlock; /**< only used by memzone LIB for thread-safe. */
+	rte_mcfg_rwlock_t qlock;  /**< used for tailq operation for thread safe. */
+	rte_mcfg_rwlock_t mplock; /**< only used by mempool LIB for thread-safe. */
+	rte_rwlock_t memseg_lock; /**< protects memsegs changed at runtime. */
+	volatile uint32_t memseg_gen; /**< incremented on each memseg change. */
 
 	uint32_t memzone_cnt; /**< Number of allocated memzones */
 
@@ -46,15 +125,46 @@ struct rte_mem_config {
 	struct rte_memseg memseg[RTE_MAX_MEMSEG];    /**< Physmem descriptors. */
 	struct rte_memzone memzone[RTE_MAX_MEMZONE]; /**< Memzone descriptors. */
 
+	/** Backing file of the memsegs added at runtime, empty for others. */
+	struct rte_memseg_file memseg_file[RTE_MAX_MEMSEG];
+
+	/**
+	 * Virtual area of the memsegs added at runtime, reserved at the same
+	 * address in all the processes. Empty without memory hotplug.
+	 */
+	uint64_t hotplug_va_addr;
+	uint64_t hotplug_va_len;
+
+	/** Virtual address to memseg, aligned for its entries to be. */
+	struct rte_mem_lookup mem_lookup __rte_cache_aligned;
+
 	struct rte_tailq_head tailq_head[RTE_MAX_TAILQ]; /**< Tailqs for objects */
 
-	/* Heaps of Malloc per socket */
-	struct malloc_heap malloc_heaps[RTE_MAX_NUMA_NODES];
+	/**
+	 * Heaps of Malloc, one per socket, then the external heaps created
+	 * at runtime.
+	 */
+	struct malloc_heap malloc_heaps[RTE_MAX_HEAPS];
+
+	/** Memory areas added to the external heaps, protected by mlock. */
+	struct rte_memseg ext_memseg[RTE_MAX_MEMSEG];
 
 	/* address of mem_config in primary process. used to map shared config into
 	 * exact same address the primary process maps it.
 	 */
 	uint64_t mem_cfg_addr;
+
+	/** Adaptive elision state of the read locks of mlock, qlock, mplock. */
+	struct rte_tm_adapt mlock_tm __rte_cache_aligned;
+	struct rte_tm_adapt qlock_tm __rte_cache_aligned;
+	struct rte_tm_adapt mplock_tm __rte_cache_aligned;
+
+#ifdef RTE_LOCK_PROFILE
+	/** Contention statistics of mlock, qlock and mplock. */
+	struct rte_lock_prof mlock_prof __rte_cache_aligned;
+	struct rte_lock_prof qlock_prof __rte_cache_aligned;
+	struct rte_lock_prof mplock_prof __rte_cache_aligned;
+#endif
 } __attribute__((__packed__));
 
 
@@ -62,10 +172,362 @@ inline static void
 rte_eal_mcfg_wait_complete(struct rte_mem_config* mcfg)
 {
 	/* wait until shared mem_config finish initialising */
-	while(mcfg->magic != RTE_MAGIC)
-		rte_pause();
+	rte_wait_until_equal_32(&mcfg->magic, RTE_MAGIC, __ATOMIC_RELAXED);
+}
+
+#ifdef RTE_MCFG_MEM_LOCK_TICKET
+/* the hold time is measured from the outermost acquisition */
+static inline void
+__rte_mcfg_ticket_lock(struct rte_mem_config *mcfg)
+{
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mlock_prof,
+			rte_ticketlock_recursive_trylock(&mcfg->mlock),
+			rte_ticketlock_recursive_lock(&mcfg->mlock));
+	if (mcfg->mlock.count == 1)
+		RTE_LOCK_PROF_HOLD_BEGIN(&mcfg->mlock_prof);
+}
+
+static inline void
+__rte_mcfg_ticket_unlock(struct rte_mem_config *mcfg)
+{
+	if (mcfg->mlock.count == 1)
+		RTE_LOCK_PROF_HOLD_END(&mcfg->mlock_prof);
+	rte_ticketlock_recursive_unlock(&mcfg->mlock);
+}
+#endif
+
+/**
+ * Take mlock to read the memzones or heap table.
+ */
+static inline void
+rte_mcfg_read_lock(struct rte_mem_config *mcfg)
+{
+#if defined(RTE_MCFG_MEM_LOCK_TICKET)
+	__rte_mcfg_ticket_lock(mcfg);
+#elif defined(RTE_MCFG_MEM_LOCK_WP)
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mlock_prof,
+			rte_rwlock_wp_read_trylock(&mcfg->mlock) == 0,
+			rte_rwlock_wp_read_lock(&mcfg->mlock));
+#else
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mlock_prof,
+			rte_rwlock_read_trylock(&mcfg->mlock) == 0,
+			rte_rwlock_read_lock(&mcfg->mlock));
+#endif
+}
+
+/**
+ * Release mlock taken with rte_mcfg_read_lock().
+ */
+static inline void
+rte_mcfg_read_unlock(struct rte_mem_config *mcfg)
+{
+#if defined(RTE_MCFG_MEM_LOCK_TICKET)
+	__rte_mcfg_ticket_unlock(mcfg);
+#elif defined(RTE_MCFG_MEM_LOCK_WP)
+	rte_rwlock_wp_read_unlock(&mcfg->mlock);
+#else
+	rte_rwlock_read_unlock(&mcfg->mlock);
+#endif
+}
+
+/**
+ * Elide mlock in a hardware memory transaction to read the memzones or
+ * heap table, or take it for reading if the elision fails. The critical
+ * section must not write to shared memory nor do system calls, which
+ * would abort the transaction.
+ */
+static inline void
+rte_mcfg_read_lock_tm(struct rte_mem_config *mcfg)
+{
+#if !defined(RTE_MCFG_MEM_LOCK_TICKET) && !defined(RTE_MCFG_MEM_LOCK_WP)
+	if (likely(rte_try_tm_adapt(&mcfg->mlock.cnt, &mcfg->mlock_tm)))
+		return;
+#endif
+	rte_mcfg_read_lock(mcfg);
+}
+
+/**
+ * Release mlock taken with rte_mcfg_read_lock_tm().
+ */
+static inline void
+rte_mcfg_read_unlock_tm(struct rte_mem_config *mcfg)
+{
+#if defined(RTE_MCFG_MEM_LOCK_TICKET) || defined(RTE_MCFG_MEM_LOCK_WP)
+	rte_mcfg_read_unlock(mcfg);
+#else
+	/* a reader which took the lock holds it until the unlock */
+	int elided = mcfg->mlock.cnt == 0;
+
+	rte_rwlock_read_unlock_tm(&mcfg->mlock);
+	if (elided)
+		rte_tm_adapt_commit(&mcfg->mlock_tm);
+#endif
+}
+
+/**
+ * Take mlock to change the memzones or heap table.
+ */
+static inline void
+rte_mcfg_write_lock(struct rte_mem_config *mcfg)
+{
+#if defined(RTE_MCFG_MEM_LOCK_TICKET)
+	__rte_mcfg_ticket_lock(mcfg);
+#elif defined(RTE_MCFG_MEM_LOCK_WP)
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mlock_prof,
+			rte_rwlock_wp_write_trylock(&mcfg->mlock) == 0,
+			rte_rwlock_wp_write_lock(&mcfg->mlock));
+	RTE_LOCK_PROF_HOLD_BEGIN(&mcfg->mlock_prof);
+#else
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mlock_prof,
+			rte_rwlock_write_trylock(&mcfg->mlock) == 0,
+			rte_rwlock_write_lock(&mcfg->mlock));
+	RTE_LOCK_PROF_HOLD_BEGIN(&mcfg->mlock_prof);
+#endif
+}
+
+/**
+ * Release mlock taken with rte_mcfg_write_lock().
+ */
+static inline void
+rte_mcfg_write_unlock(struct rte_mem_config *mcfg)
+{
+#if defined(RTE_MCFG_MEM_LOCK_TICKET)
+	__rte_mcfg_ticket_unlock(mcfg);
+#elif defined(RTE_MCFG_MEM_LOCK_WP)
+	RTE_LOCK_PROF_HOLD_END(&mcfg->mlock_prof);
+	rte_rwlock_wp_write_unlock(&mcfg->mlock);
+#else
+	RTE_LOCK_PROF_HOLD_END(&mcfg->mlock_prof);
+	rte_rwlock_write_unlock(&mcfg->mlock);
+#endif
+}
+
+/**
+ * Take qlock to read the tailqs.
+ */
+static inline void
+rte_mcfg_tailq_read_lock(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->qlock_prof,
+			rte_rwlock_wp_read_trylock(&mcfg->qlock) == 0,
+			rte_rwlock_wp_read_lock(&mcfg->qlock));
+#else
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->qlock_prof,
+			rte_rwlock_read_trylock(&mcfg->qlock) == 0,
+			rte_rwlock_read_lock(&mcfg->qlock));
+#endif
 }
 
+/**
+ * Release qlock taken with rte_mcfg_tailq_read_lock().
+ */
+static inline void
+rte_mcfg_tailq_read_unlock(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	rte_rwlock_wp_read_unlock(&mcfg->qlock);
+#else
+	rte_rwlock_read_unlock(&mcfg->qlock);
+#endif
+}
+
+/**
+ * Elide qlock to read the tailqs, or take it for reading if the elision
+ * fails, like rte_mcfg_read_lock_tm().
+ */
+static inline void
+rte_mcfg_tailq_read_lock_tm(struct rte_mem_config *mcfg)
+{
+#ifndef RTE_MCFG_MEM_LOCK_WP
+	if (likely(rte_try_tm_adapt(&mcfg->qlock.cnt, &mcfg->qlock_tm)))
+		return;
+#endif
+	rte_mcfg_tailq_read_lock(mcfg);
+}
+
+/**
+ * Release qlock taken with rte_mcfg_tailq_read_lock_tm().
+ */
+static inline void
+rte_mcfg_tailq_read_unlock_tm(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	rte_mcfg_tailq_read_unlock(mcfg);
+#else
+	/* a reader which took the lock holds it until the unlock */
+	int elided = mcfg->qlock.cnt == 0;
+
+	rte_rwlock_read_unlock_tm(&mcfg->qlock);
+	if (elided)
+		rte_tm_adapt_commit(&mcfg->qlock_tm);
+#endif
+}
+
+/**
+ * Take qlock to change the tailqs.
+ */
+static inline void
+rte_mcfg_tailq_write_lock(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->qlock_prof,
+			rte_rwlock_wp_write_trylock(&mcfg->qlock) == 0,
+			rte_rwlock_wp_write_lock(&mcfg->qlock));
+#else
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->qlock_prof,
+			rte_rwlock_write_trylock(&mcfg->qlock) == 0,
+			rte_rwlock_write_lock(&mcfg->qlock));
+#endif
+	RTE_LOCK_PROF_HOLD_BEGIN(&mcfg->qlock_prof);
+}
+
+/**
+ * Release qlock taken with rte_mcfg_tailq_write_lock().
+ */
+static inline void
+rte_mcfg_tailq_write_unlock(struct rte_mem_config *mcfg)
+{
+	RTE_LOCK_PROF_HOLD_END(&mcfg->qlock_prof);
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	rte_rwlock_wp_write_unlock(&mcfg->qlock);
+#else
+	rte_rwlock_write_unlock(&mcfg->qlock);
+#endif
+}
+
+/**
+ * Take mplock to read the mempools.
+ */
+static inline void
+rte_mcfg_mempool_read_lock(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mplock_prof,
+			rte_rwlock_wp_read_trylock(&mcfg->mplock) == 0,
+			rte_rwlock_wp_read_lock(&mcfg->mplock));
+#else
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mplock_prof,
+			rte_rwlock_read_trylock(&mcfg->mplock) == 0,
+			rte_rwlock_read_lock(&mcfg->mplock));
+#endif
+}
+
+/**
+ * Release mplock taken with rte_mcfg_mempool_read_lock().
+ */
+static inline void
+rte_mcfg_mempool_read_unlock(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	rte_rwlock_wp_read_unlock(&mcfg->mplock);
+#else
+	rte_rwlock_read_unlock(&mcfg->mplock);
+#endif
+}
+
+/**
+ * Elide mplock to read the mempools, or take it for reading if the
+ * elision fails, like rte_mcfg_read_lock_tm().
+ */
+static inline void
+rte_mcfg_mempool_read_lock_tm(struct rte_mem_config *mcfg)
+{
+#ifndef RTE_MCFG_MEM_LOCK_WP
+	if (likely(rte_try_tm_adapt(&mcfg->mplock.cnt, &mcfg->mplock_tm)))
+		return;
+#endif
+	rte_mcfg_mempool_read_lock(mcfg);
+}
+
+/**
+ * Release mplock taken with rte_mcfg_mempool_read_lock_tm().
+ */
+static inline void
+rte_mcfg_mempool_read_unlock_tm(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	rte_mcfg_mempool_read_unlock(mcfg);
+#else
+	/* a reader which took the lock holds it until the unlock */
+	int elided = mcfg->mplock.cnt == 0;
+
+	rte_rwlock_read_unlock_tm(&mcfg->mplock);
+	if (elided)
+		rte_tm_adapt_commit(&mcfg->mplock_tm);
+#endif
+}
+
+/**
+ * Take mplock to change the mempools.
+ */
+static inline void
+rte_mcfg_mempool_write_lock(struct rte_mem_config *mcfg)
+{
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mplock_prof,
+			rte_rwlock_wp_write_trylock(&mcfg->mplock) == 0,
+			rte_rwlock_wp_write_lock(&mcfg->mplock));
+#else
+	RTE_LOCK_PROF_ACQUIRE(&mcfg->mplock_prof,
+			rte_rwlock_write_trylock(&mcfg->mplock) == 0,
+			rte_rwlock_write_lock(&mcfg->mplock));
+#endif
+	RTE_LOCK_PROF_HOLD_BEGIN(&mcfg->mplock_prof);
+}
+
+/**
+ * Release mplock taken with rte_mcfg_mempool_write_lock().
+ */
+static inline void
+rte_mcfg_mempool_write_unlock(struct rte_mem_config *mcfg)
+{
+	RTE_LOCK_PROF_HOLD_END(&mcfg->mplock_prof);
+#ifdef RTE_MCFG_MEM_LOCK_WP
+	rte_rwlock_wp_write_unlock(&mcfg->mplock);
+#else
+	rte_rwlock_write_unlock(&mcfg->mplock);
+#endif
+}
+
+/**
+ * Get the QSBR variable of the lookups of memzones and tailq entries, such
+ * as rte_memzone_lookup() and rte_ring_lookup().
+ *
+ * An lcore registered on it with its lcore id, and online, looks them up
+ * without taking mlock nor qlock. It must then report quiescent states
+ * with rte_rcu_qsbr_quiescent() out of its lookups, else memzones, rings
+ * and mempools cannot be freed anymore. Other threads take the locks.
+ *
+ * @return
+ *   The QSBR variable, NULL before the memzones are initialized.
+ */
+struct rte_rcu_qsbr *rte_mcfg_qsbr_get(void);
+
+/**
+ * Test if the calling thread looks up memzones and tailq entries without
+ * lock, i.e. is online on the QSBR variable of the lookups.
+ *
+ * @return
+ *   1 if the lookups are lock-free, 0 if they must take the locks.
+ */
+int rte_mcfg_qsbr_is_online(void);
+
+/**
+ * Wait until no lock-free lookup can reference the memzones or tailq
+ * entries removed before the call. It must not be called with mlock or
+ * qlock held, as an online lcore may be waiting for them.
+ */
+void rte_mcfg_qsbr_synchronize(void);
+
+/**
+ * Dump the abort counters of the lock elision of mlock, qlock and mplock.
+ *
+ * @param f
+ *   A pointer to a file for output
+ */
+void rte_mcfg_tm_dump(FILE *f);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_LCORE_BARRIER_H_
+#define _RTE_LCORE_BARRIER_H_
+
+/**
+ * @file
+ * RTE Lcore Barrier
+ *
+ * A barrier synchronizing the phases of a job run by a fixed number of
+ * lcores: each lcore waits in rte_lcore_barrier_wait() until all of them
+ * reached it, and the barrier can be used again right away for the next
+ * phase.
+ *
+ * The barrier is sense-reversing: the last lcore to arrive flips a global
+ * sense, which the others wait for. The sense each lcore expects is kept
+ * in its own cache line, indexed by lcore id, so the barrier can only be
+ * used by EAL threads.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_memory.h>
+#include <rte_lcore.h>
+#include <rte_pause.h>
+#include <rte_branch_prediction.h>
+#include <rte_debug.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Sense expected by an lcore at its next wait. */
+struct rte_lcore_barrier_sense {
+	uint32_t sense;
+} __rte_cache_aligned;
+
+/**
+ * The rte_lcore_barrier_t type.
+ */
+typedef struct {
+	/** lcores still to arrive in the current phase */
+	uint32_t count __rte_cache_aligned;
+	uint32_t nb_lcores;   /**< lcores synchronized by the barrier */
+	/** flipped by the last lcore to arrive, waited for by the others */
+	uint32_t sense __rte_cache_aligned;
+	struct rte_lcore_barrier_sense local[RTE_MAX_LCORE];
+} rte_lcore_barrier_t;
+
+/**
+ * Initialize a barrier, with no lcore waiting on it.
+ *
+ * @param b
+ *   A pointer to the barrier.
+ * @param nb_lcores
+ *   The number of lcores to wait for in each phase.
+ * @return
+ *   0 on success, -EINVAL if nb_lcores is 0 or above RTE_MAX_LCORE.
+ */
+static inline int
+rte_lcore_barrier_init(rte_lcore_barrier_t *b, unsigned int nb_lcores)
+{
+	unsigned int i;
+
+	if (nb_lcores == 0 || nb_lcores > RTE_MAX_LCORE)
+		return -EINVAL;
+
+	b->count = nb_lcores;
+	b->nb_lcores = nb_lcores;
+	b->sense = 0;
+	for (i = 0; i < RTE_MAX_LCORE; i++)
+		b->local[i].sense = 0;
+
+	return 0;
+}
+
+/**
+ * Wait until all the lcores of the barrier reached it. The memory
+ * operations of every lcore before the barrier are visible to all of them
+ * after it. It must be called from an EAL thread.
+ *
+ * @param b
+ *   A pointer to the barrier.
+ * @return
+ *   1 for the last lcore to arrive, which may do the serial work between
+ *   two phases, 0 for the others.
+ */
+static inline int
+rte_lcore_barrier_wait(rte_lcore_barrier_t *b)
+{
+	struct rte_lcore_barrier_sense *local;
+	uint32_t sense;
+
+	RTE_ASSERT(rte_lcore_id() < RTE_MAX_LCORE);
+	local = &b->local[rte_lcore_id()];
+	sense = !local->sense;
+
+	local->sense = sense;
+
+	if (__atomic_sub_fetch(&b->count, 1, __ATOMIC_ACQ_REL) == 0) {
+		/* reset the count before releasing the others */
+		__atomic_store_n(&b->count, b->nb_lcores, __ATOMIC_RELAXED);
+		__atomic_store_n(&b->sense, sense, __ATOMIC_RELEASE);
+		return 1;
+	}
+
+	rte_wait_until_equal_32(&b->sense, sense, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_LCORE_BARRIER_H_ */
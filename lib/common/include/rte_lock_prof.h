@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_LOCK_PROF_H_
+#define _RTE_LOCK_PROF_H_
+
+/**
+ * @file
+ * RTE Lock Profiling
+ *
+ * Contention statistics of locks, collected when built with
+ * RTE_LOCK_PROFILE: number of acquisitions, number of acquisitions which
+ * had to wait, TSC cycles spent waiting, and longest exclusive hold. The
+ * memzone, tailq and mempool locks of the memory configuration and the
+ * heap locks are profiled, and registered by the EAL under their name.
+ * Other locks can be profiled by wrapping their lock and unlock calls
+ * with the macros below and registering their statistics.
+ *
+ * Without RTE_LOCK_PROFILE, the macros only take and release the lock,
+ * and the statistics are not part of the profiled structures.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_memory.h>
+#include <rte_cycles.h>
+#include <rte_branch_prediction.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum length of a profiled lock name, including the '\0'. */
+#define RTE_LOCK_PROF_NAMESIZE 32
+
+/** Maximum number of registered locks per process. */
+#define RTE_LOCK_PROF_MAX 128
+
+/**
+ * Contention statistics of a lock. They may be located in shared memory
+ * next to the lock, and be updated by several processes.
+ */
+struct rte_lock_prof {
+	char name[RTE_LOCK_PROF_NAMESIZE]; /**< name given at registration */
+	uint64_t acquired;        /**< number of acquisitions */
+	uint64_t contended;       /**< acquisitions which had to wait */
+	uint64_t wait_cycles;     /**< TSC cycles spent waiting for the lock */
+	uint64_t max_hold_cycles; /**< longest exclusive hold, in TSC cycles */
+	uint64_t hold_start;      /**< TSC at the last exclusive acquisition */
+} __rte_cache_aligned;
+
+/**
+ * Register the statistics of a lock under a name, to be shown by
+ * rte_lock_prof_dump(). The statistics are not reset, so that a process
+ * can register statistics shared with another one. Registering them again
+ * only renames them.
+ *
+ * @param prof
+ *   The statistics of the lock.
+ * @param name
+ *   The name of the lock, truncated to RTE_LOCK_PROF_NAMESIZE - 1 chars.
+ * @return
+ *   0 on success, -1 with rte_errno set to EINVAL on invalid parameters,
+ *   or to ENOSPC if RTE_LOCK_PROF_MAX locks are registered.
+ */
+int rte_lock_prof_register(struct rte_lock_prof *prof, const char *name);
+
+/**
+ * Unregister the statistics of a lock, before freeing them.
+ *
+ * @param prof
+ *   The statistics of the lock.
+ * @return
+ *   0 on success, -1 with rte_errno set to ENOENT if not registered.
+ */
+int rte_lock_prof_unregister(struct rte_lock_prof *prof);
+
+/**
+ * Reset the statistics of all the registered locks.
+ */
+void rte_lock_prof_reset(void);
+
+/**
+ * Dump the statistics of all the registered locks.
+ *
+ * @param f
+ *   A pointer to a file for output
+ */
+void rte_lock_prof_dump(FILE *f);
+
+#ifdef RTE_LOCK_PROFILE
+
+/* count an acquisition, which waited for wait cycles if contended */
+static inline void
+__rte_lock_prof_acquired(struct rte_lock_prof *prof, int contended,
+		uint64_t wait)
+{
+	__atomic_fetch_add(&prof->acquired, 1, __ATOMIC_RELAXED);
+	if (contended) {
+		__atomic_fetch_add(&prof->contended, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&prof->wait_cycles, wait, __ATOMIC_RELAXED);
+	}
+}
+
+/* record the hold time of the exclusive owner, which is releasing */
+static inline void
+__rte_lock_prof_release(struct rte_lock_prof *prof)
+{
+	uint64_t hold = rte_rdtsc() - prof->hold_start;
+
+	if (hold > prof->max_hold_cycles)
+		prof->max_hold_cycles = hold;
+}
+
+/**
+ * Take a lock, counting the acquisition and the time spent waiting.
+ *
+ * @param prof
+ *   A pointer to the statistics of the lock.
+ * @param trylock
+ *   An expression trying to take the lock, true on success.
+ * @param lock
+ *   An expression taking the lock.
+ */
+#define RTE_LOCK_PROF_ACQUIRE(prof, trylock, lock) do { \
+	if (likely(trylock)) { \
+		__rte_lock_prof_acquired(prof, 0, 0); \
+	} else { \
+		uint64_t __start = rte_rdtsc(); \
+		lock; \
+		__rte_lock_prof_acquired(prof, 1, rte_rdtsc() - __start); \
+	} \
+} while (0)
+
+/**
+ * Start measuring the hold time, once the lock is held exclusively.
+ *
+ * @param prof
+ *   A pointer to the statistics of the lock.
+ */
+#define RTE_LOCK_PROF_HOLD_BEGIN(prof) do { \
+	(prof)->hold_start = rte_rdtsc(); \
+} while (0)
+
+/**
+ * Record the hold time, before releasing a lock held exclusively.
+ *
+ * @param prof
+ *   A pointer to the statistics of the lock.
+ */
+#define RTE_LOCK_PROF_HOLD_END(prof) __rte_lock_prof_release(prof)
+
+#else /* RTE_LOCK_PROFILE */
+
+#define RTE_LOCK_PROF_ACQUIRE(prof, trylock, lock) do { lock; } while (0)
+#define RTE_LOCK_PROF_HOLD_BEGIN(prof) do { } while (0)
+#define RTE_LOCK_PROF_HOLD_END(prof) do { } while (0)
+
+#endif /* RTE_LOCK_PROFILE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_LOCK_PROF_H_ */
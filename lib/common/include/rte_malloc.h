@@ -9,6 +9,11 @@
  * @file
  * RTE Malloc. This library provides methods for dynamically allocating memory
  * from hugepages.
+ *
+ * Objects of up to 1KB requested with an alignment of at most 16 bytes are
+ * allocated from slabs of objects of the same size class, without a
+ * header of their own. They are 16-byte aligned only, and the minimum
+ * alignment given below only applies to larger objects.
  */
 
 #include <stdio.h>
@@ -29,6 +34,23 @@ struct rte_malloc_socket_stats {
 	unsigned free_count;       /**< Number of free elements on heap */
 	unsigned alloc_count;      /**< Number of allocated elements on heap */
 	size_t heap_allocsz_bytes; /**< Total allocated bytes on heap */
+	/** Free bytes currently given back to the system by
+	 *  rte_malloc_heap_trim() */
+	size_t heap_trimmed_bytes;
+	/** Number of ranges given back to the system since the heap creation */
+	unsigned trimmed_count;
+};
+
+/**
+ *  Statistics of the free elements of a heap in a size class, obtained from
+ *  rte_malloc_get_socket_free_stats function.
+ */
+struct rte_malloc_free_class_stats {
+	size_t min_size;           /**< Sizes of the class are above this */
+	size_t max_size;           /**< Sizes of the class are up to this */
+	size_t free_bytes;         /**< Total free bytes in the class */
+	size_t greatest_free_size; /**< Size in bytes of largest free block */
+	unsigned free_count;       /**< Number of free elements in the class */
 };
 
 /**
@@ -147,7 +169,9 @@ rte_realloc(void *ptr, size_t size, unsigned align);
  *   cacheline size, i.e. 64-bytes)
  * @param socket
  *   NUMA socket to allocate memory on. If SOCKET_ID_ANY is used, this function
- *   will behave the same as rte_malloc().
+ *   will behave the same as rte_malloc(). The identifier of an external
+ *   heap, as returned by rte_malloc_heap_get_socket(), can also be used, in
+ *   which case the memory is only allocated from that heap.
  * @return
  *   - NULL on error. Not enough memory, or invalid arguments (size is 0,
  *     align is not a power of two).
@@ -250,6 +274,9 @@ rte_malloc_validate(const void *ptr, size_t *size);
 /**
  * Get heap statistics for the specified heap.
  *
+ * The statistics are maintained as the heap changes, and read without
+ * locking it, so that this can be called often on a busy heap.
+ *
  * @param socket
  *   An unsigned integer specifying the socket to get heap statistics for
  * @param socket_stats
@@ -262,6 +289,28 @@ int
 rte_malloc_get_socket_stats(int socket,
 		struct rte_malloc_socket_stats *socket_stats);
 
+/**
+ * Get the distribution of the free memory of a heap by size class, to
+ * measure its fragmentation.
+ *
+ * As for rte_malloc_get_socket_stats(), the statistics are read without
+ * locking the heap.
+ *
+ * @param socket
+ *   The socket of the heap, or the identifier of an external heap
+ * @param stats
+ *   An array filled with the statistics of each size class, smallest
+ *   sizes first
+ * @param n
+ *   The size of the array
+ * @return
+ *   The number of size classes of the heap, which may be greater than n,
+ *   or -1 on error
+ */
+int
+rte_malloc_get_socket_free_stats(int socket,
+		struct rte_malloc_free_class_stats *stats, unsigned int n);
+
 /**
  * Dump statistics.
  *
@@ -277,6 +326,121 @@ rte_malloc_get_socket_stats(int socket,
 void
 rte_malloc_dump_stats(FILE *f, const char *type);
 
+/**
+ * Create an external heap.
+ *
+ * An external heap holds memory areas mapped by the application, added
+ * with rte_malloc_heap_memory_add(), instead of hugepages reserved by the
+ * EAL. It is never used for allocations on SOCKET_ID_ANY. Memory is
+ * allocated from it by passing its identifier, returned by
+ * rte_malloc_heap_get_socket(), as the socket of rte_malloc_socket() and
+ * the like, and freed with rte_free().
+ *
+ * @param heap_name
+ *   Name of the heap, shorter than RTE_HEAP_NAME_MAX_LEN.
+ * @return
+ *   0 on success, -1 on error with rte_errno set:
+ *   - EINVAL: invalid name
+ *   - ENAMETOOLONG: name too long
+ *   - EEXIST: a heap with this name already exists
+ *   - ENOSPC: RTE_MAX_HEAPS heaps already exist
+ */
+int
+rte_malloc_heap_create(const char *heap_name);
+
+/**
+ * Add an area of memory to an external heap.
+ *
+ * The area must stay mapped as long as the heap is used. As the heap is
+ * shared by all processes, it must be mapped at the same address in
+ * secondary processes allocating from the heap. The memory has no IO
+ * address: rte_malloc_virt2iova() returns RTE_BAD_IOVA for it.
+ *
+ * @param heap_name
+ *   Name of the external heap.
+ * @param va_addr
+ *   Start of the area, aligned on page_sz.
+ * @param len
+ *   Length of the area, multiple of page_sz.
+ * @param page_sz
+ *   Size of the pages backing the area, a power of two. It is matched
+ *   against the page size flags of rte_memzone_reserve().
+ * @return
+ *   0 on success, -1 on error with rte_errno set:
+ *   - EINVAL: invalid parameters
+ *   - ENOENT: no heap with this name
+ *   - EPERM: the heap is not an external heap
+ *   - EEXIST: the area overlaps memory of an external heap
+ *   - ENOSPC: too many areas were added to external heaps
+ */
+int
+rte_malloc_heap_memory_add(const char *heap_name, void *va_addr, size_t len,
+		size_t page_sz);
+
+/**
+ * Get the socket identifier of a heap, to be passed to rte_malloc_socket()
+ * and the like. The socket heaps are named "socket_<id>".
+ *
+ * @param heap_name
+ *   Name of the heap.
+ * @return
+ *   The socket identifier of the heap, or -1 on error with rte_errno set:
+ *   - EINVAL: invalid name
+ *   - ENOENT: no heap with this name
+ */
+int
+rte_malloc_heap_get_socket(const char *heap_name);
+
+/**
+ * Give the free memory of a heap back to the system.
+ *
+ * The whole pages of the free elements of the heap are released, by
+ * punching holes in their backing hugepage files, or by dropping them for
+ * anonymous memory. The pages are faulted in again when the memory is
+ * allocated, and read as zeros. The free elements already trimmed are
+ * skipped. The heap is not locked while the pages are released: the free
+ * elements being trimmed are set aside meanwhile, so that they are not
+ * allocated.
+ *
+ * As the pages faulted in again may be different physical pages, memory
+ * with physical IO addresses is not trimmed, and trimming must not be used
+ * if the memory is mapped for DMA by pinning its pages. The hugepages
+ * released may also be taken by other processes, in which case touching
+ * the memory again raises SIGBUS. External heaps are not trimmed.
+ *
+ * @param socket
+ *   The socket of the heap to trim, or SOCKET_ID_ANY for all the heaps.
+ * @param trimmed
+ *   If not NULL, set to the number of bytes released by this call.
+ * @return
+ *   0 on success, -1 on error with rte_errno set to EINVAL if the socket
+ *   is invalid.
+ */
+int
+rte_malloc_heap_trim(int socket, size_t *trimmed);
+
+/**
+ * Start a thread trimming all the heaps periodically, as done by
+ * rte_malloc_heap_trim().
+ *
+ * @param period_ms
+ *   Time between two runs, in milliseconds, not 0.
+ * @return
+ *   0 on success, -1 on error with rte_errno set:
+ *   - EINVAL: period_ms is 0
+ *   - EALREADY: the thread is already running
+ *   - other values: the thread cannot be created
+ */
+int
+rte_malloc_heap_trim_start(unsigned int period_ms);
+
+/**
+ * Stop the thread started by rte_malloc_heap_trim_start(), and wait for
+ * its end.
+ */
+void
+rte_malloc_heap_trim_stop(void);
+
 /**
  * Set the maximum amount of allocated memory for this type.
  *
@@ -293,6 +457,19 @@ rte_malloc_dump_stats(FILE *f, const char *type);
 int
 rte_malloc_set_limit(const char *type, size_t max);
 
+/**
+ * Return the IO address of a virtual address obtained through
+ * rte_malloc
+ *
+ * @param addr
+ *   Address obtained from a previous rte_malloc call
+ * @return
+ *   RTE_BAD_IOVA on error
+ *   otherwise return an address suitable for IO
+ */
+rte_iova_t
+rte_malloc_virt2iova(const void *addr);
+
 __rte_deprecated
 static inline phys_addr_t
 rte_malloc_virt2phy(const void *addr)
@@ -8,19 +8,169 @@
 #include <stddef.h>
 #include <sys/queue.h>
 #include <rte_spinlock.h>
+#include <rte_ticketlock.h>
+#include <rte_mcslock.h>
+#include <rte_lock_prof.h>
+#include <rte_per_lcore.h>
 #include <rte_memory.h>
 
 /* Number of free lists per heap, grouped by size. */
 #define RTE_HEAP_NUM_FREELISTS  13
+/* Maximum length of a heap name, including the terminating '\0'. */
+#define RTE_HEAP_NAME_MAX_LEN 32
+/* Number of size classes of small objects, from 16 bytes to 1KB. */
+#define RTE_HEAP_NUM_SLAB_CLASSES 7
+
+/*
+ * Lock of the heaps, chosen at build time: a spinlock by default, a ticket
+ * lock with RTE_MALLOC_HEAP_LOCK_TICKET, or an MCS lock with
+ * RTE_MALLOC_HEAP_LOCK_MCS. The fair locks avoid starving an lcore when
+ * many of them allocate from the same heap. The MCS queue nodes are per
+ * thread, so the MCS lock cannot be used by secondary processes, and heap
+ * locks must not be nested.
+ */
+#if defined(RTE_MALLOC_HEAP_LOCK_MCS)
+typedef rte_mcslock_t *__rte_heap_raw_lock_t;
+
+RTE_DECLARE_PER_LCORE(rte_mcslock_t, _heap_lock_node);
+
+static inline void
+__rte_heap_raw_lock_init(__rte_heap_raw_lock_t *lock)
+{
+	*lock = NULL;
+}
+
+static inline void
+__rte_heap_raw_lock(__rte_heap_raw_lock_t *lock)
+{
+	rte_mcslock_lock(lock, &RTE_PER_LCORE(_heap_lock_node));
+}
+
+static inline int
+__rte_heap_raw_trylock(__rte_heap_raw_lock_t *lock)
+{
+	return rte_mcslock_trylock(lock, &RTE_PER_LCORE(_heap_lock_node));
+}
+
+static inline void
+__rte_heap_raw_unlock(__rte_heap_raw_lock_t *lock)
+{
+	rte_mcslock_unlock(lock, &RTE_PER_LCORE(_heap_lock_node));
+}
+#elif defined(RTE_MALLOC_HEAP_LOCK_TICKET)
+typedef rte_ticketlock_t __rte_heap_raw_lock_t;
+
+static inline void
+__rte_heap_raw_lock_init(__rte_heap_raw_lock_t *lock)
+{
+	rte_ticketlock_init(lock);
+}
+
+static inline void
+__rte_heap_raw_lock(__rte_heap_raw_lock_t *lock)
+{
+	rte_ticketlock_lock(lock);
+}
+
+static inline int
+__rte_heap_raw_trylock(__rte_heap_raw_lock_t *lock)
+{
+	return rte_ticketlock_trylock(lock);
+}
+
+static inline void
+__rte_heap_raw_unlock(__rte_heap_raw_lock_t *lock)
+{
+	rte_ticketlock_unlock(lock);
+}
+#else
+typedef rte_spinlock_t __rte_heap_raw_lock_t;
+
+static inline void
+__rte_heap_raw_lock_init(__rte_heap_raw_lock_t *lock)
+{
+	rte_spinlock_init(lock);
+}
+
+static inline void
+__rte_heap_raw_lock(__rte_heap_raw_lock_t *lock)
+{
+	rte_spinlock_lock(lock);
+}
+
+static inline int
+__rte_heap_raw_trylock(__rte_heap_raw_lock_t *lock)
+{
+	return rte_spinlock_trylock(lock);
+}
+
+static inline void
+__rte_heap_raw_unlock(__rte_heap_raw_lock_t *lock)
+{
+	rte_spinlock_unlock(lock);
+}
+#endif
+
+/*
+ * Lock of a heap, along with its contention statistics with
+ * RTE_LOCK_PROFILE.
+ */
+typedef struct {
+	__rte_heap_raw_lock_t raw;
+#ifdef RTE_LOCK_PROFILE
+	struct rte_lock_prof prof;
+#endif
+} rte_heap_lock_t;
+
+static inline void
+rte_heap_lock_init(rte_heap_lock_t *lock)
+{
+	__rte_heap_raw_lock_init(&lock->raw);
+}
+
+static inline void
+rte_heap_lock(rte_heap_lock_t *lock)
+{
+	RTE_LOCK_PROF_ACQUIRE(&lock->prof, __rte_heap_raw_trylock(&lock->raw),
+			__rte_heap_raw_lock(&lock->raw));
+	RTE_LOCK_PROF_HOLD_BEGIN(&lock->prof);
+}
+
+static inline void
+rte_heap_unlock(rte_heap_lock_t *lock)
+{
+	RTE_LOCK_PROF_HOLD_END(&lock->prof);
+	__rte_heap_raw_unlock(&lock->raw);
+}
+
+/**
+ * Statistics of the free elements of a free list
+ */
+struct malloc_heap_free_stats {
+	size_t size;         /* bytes in the free elements */
+	size_t max;          /* size of the greatest free element */
+	unsigned count;      /* number of free elements */
+	unsigned max_count;  /* number of free elements of size max */
+};
 
 /**
  * Structure to hold malloc heap
  */
 struct malloc_heap {
-	rte_spinlock_t lock;
+	rte_heap_lock_t lock;
 	LIST_HEAD(, malloc_elem) free_head[RTE_HEAP_NUM_FREELISTS];
 	unsigned alloc_count;
 	size_t total_size;
+	/* updated with the lock held along the free lists, read without it */
+	size_t free_size;
+	unsigned free_count;
+	struct malloc_heap_free_stats free_stats[RTE_HEAP_NUM_FREELISTS];
+	size_t trimmed_size;    /* bytes of free elems given back to the system */
+	unsigned trimmed_count; /* ranges given back to the system */
+	char name[RTE_HEAP_NAME_MAX_LEN]; /* empty for unused external heaps */
+	rte_heap_lock_t slab_lock;
+	/* slabs of small objects having free objects, per size class */
+	LIST_HEAD(, malloc_slab) slabs[RTE_HEAP_NUM_SLAB_CLASSES];
 } __rte_cache_aligned;
 
 #endif /* _RTE_MALLOC_HEAP_H_ */
@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_MALLOC_PROF_H_
+#define _RTE_MALLOC_PROF_H_
+
+/**
+ * @file
+ * RTE Malloc Profiler.
+ *
+ * The profiler samples the memory allocated with rte_malloc() and the
+ * objects taken from mempools: each time the bytes allocated by an lcore
+ * cross a multiple of the sampling period, the allocation is recorded
+ * along with the call stack leading to it. The sample stays in the table
+ * until the memory is freed, so that the table holds the live allocations.
+ * A sample accounts for the sampling period times the number of
+ * multiples crossed, which makes the sum of the samples of a call stack an
+ * estimation of the memory it allocated.
+ *
+ * When the profiler is stopped, allocating and freeing only costs a
+ * test of a global variable.
+ *
+ * The call stacks are only available if RTE_BACKTRACE is enabled. Samples
+ * are local to the process: memory allocated by another process is not
+ * accounted for.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <rte_branch_prediction.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum depth of the call stack of a sample. */
+#define RTE_MALLOC_PROF_MAX_DEPTH 32
+
+/** Number of samples which can be held at the same time. */
+#define RTE_MALLOC_PROF_MAX_SAMPLES 8192
+
+/**
+ * Sampling period in bytes, 0 when the profiler is stopped.
+ * @internal
+ */
+extern volatile uint64_t rte_malloc_prof_period;
+
+/**
+ * Account for an allocation, and sample it when a period is crossed.
+ * @internal
+ */
+void __rte_malloc_prof_alloc(const void *addr, size_t size);
+
+/**
+ * Remove the sample of an allocation, if any.
+ * @internal
+ */
+void __rte_malloc_prof_free(const void *addr);
+
+/**
+ * Start sampling the allocations.
+ *
+ * If the profiler is already running, only the sampling period is
+ * changed.
+ *
+ * @param period
+ *   Average number of bytes allocated between two samples, not 0.
+ * @return
+ *   0 on success, -EINVAL if period is 0, -ENOTSUP if the call stacks
+ *   cannot be recorded, -ENOMEM if the sample table cannot be allocated.
+ */
+int rte_malloc_prof_start(uint64_t period);
+
+/**
+ * Stop sampling the allocations, and drop the samples.
+ */
+void rte_malloc_prof_stop(void);
+
+/**
+ * Dump the call stacks of the live samples, one per line, in the folded
+ * format used by flame graph tools: the names of the functions from the
+ * outermost one, separated by semicolons, then the estimated number of
+ * bytes allocated by the stack. Identical stacks are not merged.
+ *
+ * @param f
+ *   A pointer to a file for output
+ * @return
+ *   The number of samples dumped.
+ */
+unsigned int rte_malloc_prof_dump(FILE *f);
+
+/**
+ * Record an allocation in the profiler.
+ *
+ * This is called by rte_malloc() and mempool gets, and does nothing when
+ * the profiler is stopped.
+ *
+ * @param addr
+ *   The allocated memory, NULL if the allocation failed.
+ * @param size
+ *   The size of the allocation.
+ */
+static inline void
+rte_malloc_prof_alloc(const void *addr, size_t size)
+{
+	if (likely(rte_malloc_prof_period == 0) || addr == NULL)
+		return;
+	__rte_malloc_prof_alloc(addr, size);
+}
+
+/**
+ * Record a release of memory in the profiler.
+ *
+ * This is called by rte_free() and mempool puts, and does nothing when
+ * the profiler is stopped.
+ *
+ * @param addr
+ *   The memory being freed.
+ */
+static inline void
+rte_malloc_prof_free(const void *addr)
+{
+	if (likely(rte_malloc_prof_period == 0) || addr == NULL)
+		return;
+	__rte_malloc_prof_free(addr);
+}
+
+/**
+ * Record the allocation of several objects of the same size in the
+ * profiler, as done by mempool gets.
+ *
+ * @param obj_table
+ *   The allocated objects.
+ * @param n
+ *   The number of objects.
+ * @param size
+ *   The size of each object.
+ */
+static inline void
+rte_malloc_prof_alloc_bulk(void * const *obj_table, unsigned int n,
+		size_t size)
+{
+	unsigned int i;
+
+	if (likely(rte_malloc_prof_period == 0))
+		return;
+	for (i = 0; i < n; i++)
+		__rte_malloc_prof_alloc(obj_table[i], size);
+}
+
+/**
+ * Record the release of several objects in the profiler, as done by
+ * mempool puts.
+ *
+ * @param obj_table
+ *   The objects being freed.
+ * @param n
+ *   The number of objects.
+ */
+static inline void
+rte_malloc_prof_free_bulk(void * const *obj_table, unsigned int n)
+{
+	unsigned int i;
+
+	if (likely(rte_malloc_prof_period == 0))
+		return;
+	for (i = 0; i < n; i++)
+		__rte_malloc_prof_free(obj_table[i]);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_MALLOC_PROF_H_ */
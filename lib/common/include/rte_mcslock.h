@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_MCSLOCK_H_
+#define _RTE_MCSLOCK_H_
+
+/**
+ * @file
+ *
+ * RTE MCS locks
+ *
+ * This file defines an API for MCS locks, named after their inventors
+ * Mellor-Crummey and Scott. The waiters form a queue, granted the lock in
+ * order. Each waiter provides its own queue node and spins on it, so that
+ * a release only touches the cache line of the next waiter, instead of
+ * the cache lines of all of them.
+ *
+ * The lock is a pointer to the last node of the queue, NULL when the lock
+ * is free. A node must stay valid and unchanged from the lock to the
+ * unlock, and be accessible to the other waiters: a node on the stack or
+ * in thread local storage cannot be used for a lock shared with other
+ * processes.
+ */
+
+#include <rte_common.h>
+#include <rte_branch_prediction.h>
+#include <rte_pause.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The rte_mcslock_t type, used both for the lock and the queue nodes.
+ */
+typedef struct rte_mcslock {
+	struct rte_mcslock *next; /**< next waiter in the queue */
+	int locked; /**< 1 while the waiter must wait, 0 when granted */
+} rte_mcslock_t;
+
+/**
+ * Take the MCS lock.
+ *
+ * @param msl
+ *   A pointer to the lock, i.e. to the pointer to the last queue node.
+ * @param me
+ *   A pointer to the queue node of the caller.
+ */
+static inline void
+rte_mcslock_lock(rte_mcslock_t **msl, rte_mcslock_t *me)
+{
+	rte_mcslock_t *prev;
+
+	__atomic_store_n(&me->locked, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&me->next, NULL, __ATOMIC_RELAXED);
+
+	/* queue up, the previous node is the one to wait for */
+	prev = __atomic_exchange_n(msl, me, __ATOMIC_ACQ_REL);
+	if (likely(prev == NULL))
+		return;
+
+	__atomic_store_n(&prev->next, me, __ATOMIC_RELEASE);
+
+	/* the previous owner clears our flag when releasing the lock */
+	rte_wait_until_equal_32((volatile uint32_t *)&me->locked, 0,
+			__ATOMIC_ACQUIRE);
+}
+
+/**
+ * Release the MCS lock.
+ *
+ * @param msl
+ *   A pointer to the lock.
+ * @param me
+ *   A pointer to the queue node given to rte_mcslock_lock().
+ */
+static inline void
+rte_mcslock_unlock(rte_mcslock_t **msl, rte_mcslock_t *me)
+{
+	rte_mcslock_t *expected;
+
+	if (likely(__atomic_load_n(&me->next, __ATOMIC_RELAXED) == NULL)) {
+		/* no known waiter, try to leave the queue empty */
+		expected = me;
+		if (likely(__atomic_compare_exchange_n(msl, &expected, NULL,
+				0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)))
+			return;
+
+		/* a waiter is queuing up, wait until it is linked */
+		while (__atomic_load_n(&me->next, __ATOMIC_ACQUIRE) == NULL)
+			rte_pause();
+	}
+
+	__atomic_store_n(&me->next->locked, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Try to take the MCS lock.
+ *
+ * @param msl
+ *   A pointer to the lock.
+ * @param me
+ *   A pointer to the queue node of the caller.
+ * @return
+ *   1 if the lock is successfully taken; 0 otherwise.
+ */
+static inline int
+rte_mcslock_trylock(rte_mcslock_t **msl, rte_mcslock_t *me)
+{
+	rte_mcslock_t *expected = NULL;
+
+	__atomic_store_n(&me->next, NULL, __ATOMIC_RELAXED);
+
+	return __atomic_compare_exchange_n(msl, &expected, me, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+/**
+ * Test if the MCS lock is taken.
+ *
+ * @param msl
+ *   A pointer to the lock.
+ * @return
+ *   1 if the lock is currently taken; 0 otherwise.
+ */
+static inline int
+rte_mcslock_is_locked(rte_mcslock_t **msl)
+{
+	return __atomic_load_n(msl, __ATOMIC_RELAXED) != NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_MCSLOCK_H_ */
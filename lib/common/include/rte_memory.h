@@ -66,12 +66,25 @@ enum rte_page_sizes {
 
 typedef uint64_t phys_addr_t; /**< Physical address. */
 #define RTE_BAD_PHYS_ADDR ((phys_addr_t)-1)
+/**
+ * IO virtual address type.
+ * When the physical addressing mode (IOVA as PA) is in use,
+ * the translation from an IO virtual address (IOVA) to a physical address
+ * is a direct mapping, i.e. the same value.
+ * Otherwise, in virtual mode (IOVA as VA), an IOMMU may do the translation.
+ */
+typedef uint64_t rte_iova_t;
+#define RTE_BAD_IOVA ((rte_iova_t)-1)
 
 /**
  * Physical memory segment descriptor.
  */
 struct rte_memseg {
-	phys_addr_t phys_addr;  /**< deprecated - Start physical address. */
+	RTE_STD_C11
+	union {
+		phys_addr_t phys_addr;  /**< deprecated - Start physical address. */
+		rte_iova_t iova;        /**< Start IO address. */
+	};
 	RTE_STD_C11
 	union {
 		void *addr;         /**< Start virtual address. */
@@ -106,6 +119,35 @@ int rte_mem_lock_page(const void *virt);
  */
 phys_addr_t rte_mem_virt2phy(const void *virt);
 
+/**
+ * Get the memory segment containing a virtual address.
+ *
+ * The memseg is found in O(1) from a lookup table of the shared memory
+ * configuration, without taking any lock. It can be called from any
+ * thread of the primary or a secondary process.
+ *
+ * @param virt
+ *   The virtual address.
+ * @return
+ *   The memseg containing the address, or NULL if the address is not in
+ *   DPDK memory.
+ */
+const struct rte_memseg *rte_mem_virt2memseg(const void *virt);
+
+/**
+ * Get the IO address of a virtual address of DPDK memory.
+ *
+ * Contrary to rte_mem_virt2phy(), the /proc/self/pagemap file is never
+ * read: the IOVA is computed from the memseg found by
+ * rte_mem_virt2memseg(), so that it can be used in a fast path.
+ *
+ * @param virt
+ *   The virtual address.
+ * @return
+ *   The IO address, or RTE_BAD_IOVA if the address is not in DPDK memory.
+ */
+rte_iova_t rte_mem_virt2iova(const void *virt);
+
 
 /**
  * Get the layout of the available physical memory.
@@ -124,6 +166,26 @@ phys_addr_t rte_mem_virt2phy(const void *virt);
  */
 const struct rte_memseg *rte_eal_get_physmem_layout(void);
 
+/**
+ * Synchronize the memory segments of a secondary process with the primary.
+ *
+ * With the mem-hotplug option, the primary process adds memory segments
+ * to the malloc heaps when they run dry, and releases them when they are
+ * free again. A secondary process maps the new segments, at the same
+ * addresses, and unmaps the released ones when calling this function.
+ * It is called by the secondary process before allocating from a heap or
+ * looking up a memzone; it must be called before accessing other objects
+ * which may have been allocated by the primary process after the last
+ * synchronization.
+ *
+ * It does nothing in the primary process.
+ *
+ * @return
+ *   0 on success, -1 if a segment cannot be mapped at the address of the
+ *   primary process.
+ */
+int rte_eal_memseg_sync(void);
+
 /**
  * Dump the physical memory layout to a file.
  *
@@ -49,7 +49,11 @@ struct rte_memzone {
 #define RTE_MEMZONE_NAMESIZE 32       /**< Maximum length of memory zone name.*/
 	char name[RTE_MEMZONE_NAMESIZE];  /**< Name of the memory zone. */
 
-	phys_addr_t phys_addr;        /**< deprecated - Start physical address. */
+	RTE_STD_C11
+	union {
+		phys_addr_t phys_addr;        /**< deprecated - Start physical address. */
+		rte_iova_t iova;              /**< Start IO address. */
+	};
 	RTE_STD_C11
 	union {
 		void *addr;                   /**< Start virtual address. */
@@ -258,6 +262,10 @@ void rte_memzone_dump(FILE *f);
 /**
  * Walk list of all memzones
  *
+ * The memzone lock is held while calling func, which must not reserve
+ * nor free memzones. It may look up memzones, unless the lock is the
+ * writer-preferring one of RTE_MCFG_MEM_LOCK_WP.
+ *
  * @param func
  *   Iterator function
  * @param arg
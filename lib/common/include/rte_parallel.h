@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_PARALLEL_H_
+#define _RTE_PARALLEL_H_
+
+/**
+ * @file
+ * RTE Parallel For
+ *
+ * Run a loop over a range of indexes on the idle slave lcores along with
+ * the calling master lcore, and wait for its completion.
+ *
+ * The range is split in chunks of a given grain, and the chunks are first
+ * shared evenly between the lcores. An lcore which ran its own chunks
+ * steals half of the chunks left to another one, so that an lcore which
+ * is slowed down, e.g. by interrupts or by chunks costlier than others,
+ * does not delay the completion of the whole loop.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Function running the loop over a chunk of the range.
+ *
+ * @param begin
+ *   The first index of the chunk.
+ * @param end
+ *   The index following the last one of the chunk.
+ * @param arg
+ *   The argument given to rte_parallel_for().
+ */
+typedef void (*rte_parallel_for_fn_t)(uint64_t begin, uint64_t end,
+		void *arg);
+
+/**
+ * Run a loop over the range [begin, end[ on the slave lcores waiting for
+ * work and on the calling lcore, and return once the whole range is done.
+ *
+ * Only the master lcore can launch work on the slave lcores: when called
+ * from another thread, or when no slave lcore waits for work, the loop
+ * runs on the calling thread only. The chunks run in any order and on any
+ * of the lcores.
+ *
+ * @param begin
+ *   The first index of the range.
+ * @param end
+ *   The index following the last one of the range.
+ * @param grain
+ *   The number of indexes of a chunk, the last one may be smaller. A chunk
+ *   should last long enough to be worth the cost of its dispatch.
+ * @param fn
+ *   The function to run on each chunk.
+ * @param arg
+ *   The argument given to fn.
+ * @return
+ *   0 on success, -EINVAL on invalid parameters, -E2BIG if the range has
+ *   more than UINT32_MAX chunks.
+ */
+int rte_parallel_for(uint64_t begin, uint64_t end, uint64_t grain,
+		rte_parallel_for_fn_t fn, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_PARALLEL_H_ */
@@ -0,0 +1,283 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_RCU_QSBR_H_
+#define _RTE_RCU_QSBR_H_
+
+/**
+ * @file
+ * RTE Quiescent State Based Reclamation (QSBR).
+ *
+ * QSBR lets readers access shared data without lock nor atomic operation.
+ * Each reader thread periodically reports a quiescent state, i.e. a point
+ * where it holds no reference to the shared data, typically once per
+ * iteration of its main loop. A writer removing an element from the data
+ * then waits until all the readers went through a quiescent state before
+ * freeing it, as none of them can still reference it.
+ *
+ * A reader thread registers on a QSBR variable with an id below the
+ * maximum number of threads of the variable, usually its lcore id, then
+ * goes online. A thread which is offline is not waited for, and must not
+ * access the shared data. A thread going to block for a while should go
+ * offline to not delay the writers.
+ *
+ * The QSBR variable can be located in shared memory, to be used by several
+ * processes.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_memory.h>
+#include <rte_atomic.h>
+#include <rte_pause.h>
+#include <rte_branch_prediction.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Thread id given to rte_rcu_qsbr_synchronize() by unregistered threads. */
+#define RTE_QSBR_THRID_INVALID 0xffffffff
+
+/** Counter of an offline thread. */
+#define RTE_QSBR_CNT_THR_OFFLINE 0
+/** Initial value of the token. */
+#define RTE_QSBR_CNT_INIT 1
+
+/**
+ * Quiescent state counter of a thread, the value of the token when the
+ * thread reported its last quiescent state.
+ * @internal
+ */
+struct rte_rcu_qsbr_cnt {
+	uint64_t cnt;
+} __rte_cache_aligned;
+
+/**
+ * QSBR variable, followed by the counters of the threads, then by the
+ * bitmap of the registered threads.
+ */
+struct rte_rcu_qsbr {
+	uint64_t token __rte_cache_aligned; /**< last grace period started */
+	uint32_t num_elems;   /**< number of 64-bit words of the bitmap */
+	uint32_t num_threads; /**< number of registered threads */
+	uint32_t max_threads; /**< maximum number of threads */
+
+	struct rte_rcu_qsbr_cnt qsbr_cnt[0] __rte_cache_aligned;
+} __rte_cache_aligned;
+
+/* bitmap of the registered threads, after the counters */
+#define __RTE_QSBR_THRID_BMAP(v) \
+	((uint64_t *)&(v)->qsbr_cnt[(v)->max_threads])
+
+/**
+ * Return the size of the memory to allocate for a QSBR variable.
+ *
+ * @param max_threads
+ *   Maximum number of threads reporting quiescent states on the variable.
+ * @return
+ *   The size in bytes, or 0 if max_threads is 0, with rte_errno set to
+ *   EINVAL.
+ */
+size_t rte_rcu_qsbr_get_memsize(uint32_t max_threads);
+
+/**
+ * Initialize a QSBR variable, allocated with the size returned by
+ * rte_rcu_qsbr_get_memsize() and aligned on a cache line.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param max_threads
+ *   Maximum number of threads reporting quiescent states on the variable.
+ * @return
+ *   0 on success, -1 with rte_errno set to EINVAL on invalid parameters.
+ */
+int rte_rcu_qsbr_init(struct rte_rcu_qsbr *v, uint32_t max_threads);
+
+/**
+ * Register a reader thread on a QSBR variable. The thread is offline until
+ * it calls rte_rcu_qsbr_thread_online().
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param thread_id
+ *   The id of the thread, below the maximum number of threads.
+ * @return
+ *   0 on success, -1 with rte_errno set to EINVAL on invalid parameters.
+ */
+int rte_rcu_qsbr_thread_register(struct rte_rcu_qsbr *v,
+		unsigned int thread_id);
+
+/**
+ * Unregister an offline reader thread from a QSBR variable.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param thread_id
+ *   The id of the thread.
+ * @return
+ *   0 on success, -1 with rte_errno set to EINVAL on invalid parameters.
+ */
+int rte_rcu_qsbr_thread_unregister(struct rte_rcu_qsbr *v,
+		unsigned int thread_id);
+
+/**
+ * Mark a registered reader thread online: it can access the shared data
+ * from now on, and will be waited for by the writers.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param thread_id
+ *   The id of the thread.
+ */
+static inline void
+rte_rcu_qsbr_thread_online(struct rte_rcu_qsbr *v, unsigned int thread_id)
+{
+	uint64_t t = __atomic_load_n(&v->token, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&v->qsbr_cnt[thread_id].cnt, t, __ATOMIC_RELAXED);
+
+	/* be seen online before reading the shared data */
+	rte_smp_mb();
+}
+
+/**
+ * Mark a reader thread offline: it must not access the shared data until
+ * it goes online again.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param thread_id
+ *   The id of the thread.
+ */
+static inline void
+rte_rcu_qsbr_thread_offline(struct rte_rcu_qsbr *v, unsigned int thread_id)
+{
+	__atomic_store_n(&v->qsbr_cnt[thread_id].cnt,
+			RTE_QSBR_CNT_THR_OFFLINE, __ATOMIC_RELEASE);
+}
+
+/**
+ * Test if a thread is online on a QSBR variable.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param thread_id
+ *   The id of the thread, which may be out of range.
+ * @return
+ *   1 if the thread is online, 0 otherwise.
+ */
+static inline int
+rte_rcu_qsbr_thread_is_online(struct rte_rcu_qsbr *v, unsigned int thread_id)
+{
+	return thread_id < v->max_threads &&
+		__atomic_load_n(&v->qsbr_cnt[thread_id].cnt,
+				__ATOMIC_RELAXED) != RTE_QSBR_CNT_THR_OFFLINE;
+}
+
+/**
+ * Report a quiescent state: the thread holds no reference to the shared
+ * data anymore.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param thread_id
+ *   The id of the online thread.
+ */
+static inline void
+rte_rcu_qsbr_quiescent(struct rte_rcu_qsbr *v, unsigned int thread_id)
+{
+	uint64_t t = __atomic_load_n(&v->token, __ATOMIC_ACQUIRE);
+
+	/* the previous reads of the shared data are done */
+	if (t != v->qsbr_cnt[thread_id].cnt)
+		__atomic_store_n(&v->qsbr_cnt[thread_id].cnt, t,
+				__ATOMIC_RELEASE);
+}
+
+/**
+ * Start a grace period, after removing elements from the shared data.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @return
+ *   The token of the grace period, to give to rte_rcu_qsbr_check().
+ */
+static inline uint64_t
+rte_rcu_qsbr_start(struct rte_rcu_qsbr *v)
+{
+	/* the removals are visible before the readers see the new token */
+	return __atomic_add_fetch(&v->token, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Check if a grace period is over, i.e. all the online threads reported a
+ * quiescent state since it was started.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param t
+ *   The token returned by rte_rcu_qsbr_start().
+ * @param wait
+ *   If true, wait until the grace period is over.
+ * @return
+ *   1 if the grace period is over, 0 otherwise.
+ */
+static inline int
+rte_rcu_qsbr_check(struct rte_rcu_qsbr *v, uint64_t t, bool wait)
+{
+	uint64_t *reg_thread_id = __RTE_QSBR_THRID_BMAP(v);
+	uint64_t bmap, c;
+	unsigned int i, j;
+
+	for (i = 0; i < v->num_elems; i++) {
+		bmap = __atomic_load_n(&reg_thread_id[i], __ATOMIC_ACQUIRE);
+		while (bmap != 0) {
+			j = __builtin_ctzll(bmap);
+			c = __atomic_load_n(&v->qsbr_cnt[i * 64 + j].cnt,
+					__ATOMIC_ACQUIRE);
+			if (c != RTE_QSBR_CNT_THR_OFFLINE && c < t) {
+				if (!wait)
+					return 0;
+				rte_pause();
+				continue;
+			}
+			bmap &= ~(1ULL << j);
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Wait until all the online threads, except the caller, reported a
+ * quiescent state. The elements removed from the shared data before the
+ * call can be freed after it.
+ *
+ * @param v
+ *   The QSBR variable.
+ * @param thread_id
+ *   The id of the caller if it is an online reader, which reports a
+ *   quiescent state, else RTE_QSBR_THRID_INVALID.
+ */
+void rte_rcu_qsbr_synchronize(struct rte_rcu_qsbr *v, unsigned int thread_id);
+
+/**
+ * Dump the state of a QSBR variable.
+ *
+ * @param f
+ *   A pointer to a file for output
+ * @param v
+ *   The QSBR variable.
+ */
+void rte_rcu_qsbr_dump(FILE *f, struct rte_rcu_qsbr *v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_RCU_QSBR_H_ */
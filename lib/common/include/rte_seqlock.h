@@ -0,0 +1,229 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_SEQLOCK_H_
+#define _RTE_SEQLOCK_H_
+
+/**
+ * @file
+ * RTE Sequence Locks
+ *
+ * A sequence lock protects data read often and rarely written, without
+ * any store from the readers: reading does not make the cache line of the
+ * lock bounce between the lcores. A writer increments a sequence number
+ * before and after changing the data, so that a reader which sees an odd
+ * number, or a number changed while it read the data, retries:
+ *
+ * @code
+ *	do {
+ *		sn = rte_seqlock_read_begin(&lock);
+ *		copy = data;
+ *	} while (rte_seqlock_read_retry(&lock, sn));
+ * @endcode
+ *
+ * The reader may see inconsistent data before retrying: it must only copy
+ * the data, and not follow pointers which the writer may free.
+ *
+ * rte_seqcount_t is the sequence number alone, for writers already
+ * serialized by other means. rte_seqlock_t adds a spinlock serializing the
+ * writers.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_branch_prediction.h>
+#include <rte_spinlock.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The rte_seqcount_t type, odd while a write is in progress.
+ */
+typedef struct {
+	uint32_t sn; /**< sequence number */
+} rte_seqcount_t;
+
+/**
+ * A static seqcount initializer.
+ */
+#define RTE_SEQCOUNT_INITIALIZER { 0 }
+
+/**
+ * Initialize the sequence counter.
+ *
+ * @param seqcount
+ *   A pointer to the sequence counter.
+ */
+static inline void
+rte_seqcount_init(rte_seqcount_t *seqcount)
+{
+	seqcount->sn = 0;
+}
+
+/**
+ * Begin a read of the protected data.
+ *
+ * @param seqcount
+ *   A pointer to the sequence counter.
+ * @return
+ *   The sequence number to give to rte_seqcount_read_retry().
+ */
+static inline uint32_t
+rte_seqcount_read_begin(const rte_seqcount_t *seqcount)
+{
+	/* the data is read after the sequence number */
+	return __atomic_load_n(&seqcount->sn, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * End a read of the protected data, and tell whether it must be retried
+ * because a write was in progress or happened meanwhile.
+ *
+ * @param seqcount
+ *   A pointer to the sequence counter.
+ * @param begin_sn
+ *   The sequence number returned by rte_seqcount_read_begin().
+ * @return
+ *   true if the data read may be inconsistent and must be read again.
+ */
+static inline bool
+rte_seqcount_read_retry(const rte_seqcount_t *seqcount, uint32_t begin_sn)
+{
+	uint32_t end_sn;
+
+	if (unlikely(begin_sn & 1))
+		return true;
+
+	/* the data is read before the sequence number again */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	end_sn = __atomic_load_n(&seqcount->sn, __ATOMIC_RELAXED);
+
+	return begin_sn != end_sn;
+}
+
+/**
+ * Begin a write of the protected data. The writers must be serialized.
+ *
+ * @param seqcount
+ *   A pointer to the sequence counter.
+ */
+static inline void
+rte_seqcount_write_begin(rte_seqcount_t *seqcount)
+{
+	uint32_t sn = seqcount->sn + 1;
+
+	__atomic_store_n(&seqcount->sn, sn, __ATOMIC_RELAXED);
+
+	/* the sequence number is odd before the data is written */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * End a write of the protected data.
+ *
+ * @param seqcount
+ *   A pointer to the sequence counter.
+ */
+static inline void
+rte_seqcount_write_end(rte_seqcount_t *seqcount)
+{
+	uint32_t sn = seqcount->sn + 1;
+
+	/* the data is written before the sequence number is even again */
+	__atomic_store_n(&seqcount->sn, sn, __ATOMIC_RELEASE);
+}
+
+/**
+ * The rte_seqlock_t type.
+ */
+typedef struct {
+	rte_seqcount_t count; /**< sequence number of the data */
+	rte_spinlock_t lock;  /**< serializes the writers */
+} rte_seqlock_t;
+
+/**
+ * A static seqlock initializer.
+ */
+#define RTE_SEQLOCK_INITIALIZER \
+	{ RTE_SEQCOUNT_INITIALIZER, RTE_SPINLOCK_INITIALIZER }
+
+/**
+ * Initialize the seqlock.
+ *
+ * @param seqlock
+ *   A pointer to the seqlock.
+ */
+static inline void
+rte_seqlock_init(rte_seqlock_t *seqlock)
+{
+	rte_seqcount_init(&seqlock->count);
+	rte_spinlock_init(&seqlock->lock);
+}
+
+/**
+ * Begin a read of the data protected by the seqlock.
+ *
+ * @param seqlock
+ *   A pointer to the seqlock.
+ * @return
+ *   The sequence number to give to rte_seqlock_read_retry().
+ */
+static inline uint32_t
+rte_seqlock_read_begin(const rte_seqlock_t *seqlock)
+{
+	return rte_seqcount_read_begin(&seqlock->count);
+}
+
+/**
+ * End a read of the data protected by the seqlock, and tell whether it
+ * must be retried.
+ *
+ * @param seqlock
+ *   A pointer to the seqlock.
+ * @param begin_sn
+ *   The sequence number returned by rte_seqlock_read_begin().
+ * @return
+ *   true if the data read may be inconsistent and must be read again.
+ */
+static inline bool
+rte_seqlock_read_retry(const rte_seqlock_t *seqlock, uint32_t begin_sn)
+{
+	return rte_seqcount_read_retry(&seqlock->count, begin_sn);
+}
+
+/**
+ * Take the seqlock to write the data.
+ *
+ * @param seqlock
+ *   A pointer to the seqlock.
+ */
+static inline void
+rte_seqlock_write_lock(rte_seqlock_t *seqlock)
+{
+	rte_spinlock_lock(&seqlock->lock);
+	rte_seqcount_write_begin(&seqlock->count);
+}
+
+/**
+ * Release the seqlock after writing the data.
+ *
+ * @param seqlock
+ *   A pointer to the seqlock.
+ */
+static inline void
+rte_seqlock_write_unlock(rte_seqlock_t *seqlock)
+{
+	rte_seqcount_write_end(&seqlock->count);
+	rte_spinlock_unlock(&seqlock->lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_SEQLOCK_H_ */
@@ -35,6 +35,7 @@ malloc_elem_init(struct malloc_elem *elem,
 	elem->state = ELEM_FREE;
 	elem->size = size;
 	elem->pad = 0;
+	elem->trimmed = 0;
 	set_header(elem);
 	set_trailer(elem);
 }
@@ -146,6 +147,69 @@ malloc_elem_free_list_index(size_t size)
 	        index: RTE_HEAP_NUM_FREELISTS-1;
 }
 
+/*
+ * Given a freelist index, compute the greatest element size it holds.
+ */
+size_t
+malloc_elem_free_list_max_size(size_t idx)
+{
+	if (idx >= RTE_HEAP_NUM_FREELISTS - 1)
+		return SIZE_MAX;
+
+	return 1UL << (MALLOC_MINSIZE_LOG2 + idx * MALLOC_LOG2_INCREMENT);
+}
+
+/*
+ * Account for an element added to a free list.
+ */
+static void
+free_stats_add(struct malloc_heap *heap, size_t idx, size_t size)
+{
+	struct malloc_heap_free_stats *stats = &heap->free_stats[idx];
+
+	stats->size += size;
+	stats->count++;
+	if (size > stats->max) {
+		stats->max = size;
+		stats->max_count = 1;
+	} else if (size == stats->max) {
+		stats->max_count++;
+	}
+
+	heap->free_size += size;
+	heap->free_count++;
+}
+
+/*
+ * Account for an element removed from a free list. When the last of the
+ * greatest elements of the list is removed, the list is walked to find
+ * the new greatest size.
+ */
+static void
+free_stats_del(struct malloc_heap *heap, size_t idx, size_t size)
+{
+	struct malloc_heap_free_stats *stats = &heap->free_stats[idx];
+	struct malloc_elem *elem;
+
+	heap->free_count--;
+	heap->free_size -= size;
+
+	stats->size -= size;
+	stats->count--;
+	if (size != stats->max || --stats->max_count != 0)
+		return;
+
+	stats->max = 0;
+	LIST_FOREACH(elem, &heap->free_head[idx], free_list) {
+		if (elem->size > stats->max) {
+			stats->max = elem->size;
+			stats->max_count = 1;
+		} else if (elem->size == stats->max) {
+			stats->max_count++;
+		}
+	}
+}
+
 /*
  * Add the specified element to its heap's free list.
  */
@@ -157,15 +221,83 @@ malloc_elem_free_list_insert(struct malloc_elem *elem)
 	idx = malloc_elem_free_list_index(elem->size - MALLOC_ELEM_HEADER_LEN);
 	elem->state = ELEM_FREE;
 	LIST_INSERT_HEAD(&elem->heap->free_head[idx], elem, free_list);
+	free_stats_add(elem->heap, idx, elem->size);
 }
 
 /*
  * Remove the specified element from its heap's free list.
  */
-static void
-elem_free_list_remove(struct malloc_elem *elem)
+void
+malloc_elem_free_list_remove(struct malloc_elem *elem)
 {
+	size_t idx;
+
+	idx = malloc_elem_free_list_index(elem->size - MALLOC_ELEM_HEADER_LEN);
 	LIST_REMOVE(elem, free_list);
+	free_stats_del(elem->heap, idx, elem->size);
+}
+
+/*
+ * Get the whole pages of the data of a free element, which can be given
+ * back to the system. The pages of a trimmed element are the first
+ * elem->trimmed bytes of them. Returns their length.
+ */
+size_t
+malloc_elem_trim_bounds(const struct malloc_elem *elem, uintptr_t *start)
+{
+	uint64_t page_sz = elem->ms->hugepage_sz;
+	uintptr_t end;
+
+	*start = RTE_ALIGN_CEIL((uintptr_t)elem + MALLOC_ELEM_HEADER_LEN,
+			page_sz);
+	end = RTE_ALIGN_FLOOR((uintptr_t)elem + elem->size -
+			MALLOC_ELEM_TRAILER_LEN, page_sz);
+	return end > *start ? end - *start : 0;
+}
+
+/*
+ * Get the end of the pages of an element given back to the system, 0 if
+ * none.
+ */
+static uintptr_t
+elem_trim_end(const struct malloc_elem *elem)
+{
+	uintptr_t start;
+
+	if (elem->trimmed == 0)
+		return 0;
+	malloc_elem_trim_bounds(elem, &start);
+	return start + elem->trimmed;
+}
+
+/*
+ * Account for the pages given back to the system, up to trim_end, of the
+ * free part of an element which was split. The pages of the part are
+ * still released, except the ones holding its header and trailer.
+ */
+static void
+elem_retrim(struct malloc_elem *elem, uintptr_t trim_end)
+{
+	uintptr_t start;
+	size_t len = malloc_elem_trim_bounds(elem, &start);
+
+	if (trim_end <= start || len == 0)
+		return;
+	elem->trimmed = RTE_MIN(len, trim_end - start);
+	elem->heap->trimmed_size += elem->trimmed;
+}
+
+/*
+ * Forget the pages of an element given back to the system, before the
+ * element is allocated or merged.
+ */
+void
+malloc_elem_untrim(struct malloc_elem *elem)
+{
+	if (elem->trimmed == 0)
+		return;
+	elem->heap->trimmed_size -= elem->trimmed;
+	elem->trimmed = 0;
 }
 
 /*
@@ -182,8 +314,10 @@ malloc_elem_alloc(struct malloc_elem *elem, size_t size, unsigned align,
 	const size_t old_elem_size = (uintptr_t)new_elem - (uintptr_t)elem;
 	const size_t trailer_size = elem->size - old_elem_size - size -
 		MALLOC_ELEM_OVERHEAD;
+	const uintptr_t trim_end = elem_trim_end(elem);
 
-	elem_free_list_remove(elem);
+	malloc_elem_free_list_remove(elem);
+	malloc_elem_untrim(elem);
 
 	if (trailer_size > MALLOC_ELEM_OVERHEAD + MIN_DATA_SIZE) {
 		/* split it, too much free space after elem */
@@ -191,6 +325,7 @@ malloc_elem_alloc(struct malloc_elem *elem, size_t size, unsigned align,
 				RTE_PTR_ADD(new_elem, size + MALLOC_ELEM_OVERHEAD);
 
 		split_elem(elem, new_free_elem);
+		elem_retrim(new_free_elem, trim_end);
 		malloc_elem_free_list_insert(new_free_elem);
 	}
 
@@ -218,6 +353,7 @@ malloc_elem_alloc(struct malloc_elem *elem, size_t size, unsigned align,
 	 */
 	split_elem(elem, new_elem);
 	new_elem->state = ELEM_BUSY;
+	elem_retrim(elem, trim_end);
 	malloc_elem_free_list_insert(elem);
 
 	return new_elem;
@@ -231,10 +367,40 @@ static inline void
 join_elem(struct malloc_elem *elem1, struct malloc_elem *elem2)
 {
 	struct malloc_elem *next = RTE_PTR_ADD(elem2, elem2->size);
+	malloc_elem_untrim(elem1);
+	malloc_elem_untrim(elem2);
 	elem1->size += elem2->size;
 	next->prev = elem1;
 }
 
+/*
+ * Put an element taken off the free lists back on them, merging it with
+ * the free elements around it. The header and trailer left inside the
+ * merged element are zeroed, as the free memory is.
+ */
+void
+malloc_elem_free_list_reinsert(struct malloc_elem *elem)
+{
+	struct malloc_elem *next = RTE_PTR_ADD(elem, elem->size);
+	struct malloc_elem *prev = elem->prev;
+
+	if (next->state == ELEM_FREE) {
+		malloc_elem_free_list_remove(next);
+		join_elem(elem, next);
+		memset(RTE_PTR_SUB(next, MALLOC_ELEM_TRAILER_LEN), 0,
+				MALLOC_ELEM_OVERHEAD);
+	}
+
+	if (prev != NULL && prev->state == ELEM_FREE) {
+		malloc_elem_free_list_remove(prev);
+		join_elem(prev, elem);
+		memset(RTE_PTR_SUB(elem, MALLOC_ELEM_TRAILER_LEN), 0,
+				MALLOC_ELEM_OVERHEAD);
+		elem = prev;
+	}
+	malloc_elem_free_list_insert(elem);
+}
+
 /*
  * free a malloc_elem block by adding it to the free list. If the
  * blocks either immediately before or immediately after newly freed block
@@ -246,13 +412,13 @@ malloc_elem_free(struct malloc_elem *elem)
 	if (!malloc_elem_cookies_ok(elem) || elem->state != ELEM_BUSY)
 		return -1;
 
-	rte_spinlock_lock(&(elem->heap->lock));
+	rte_heap_lock(&(elem->heap->lock));
 	size_t sz = elem->size - sizeof(*elem) - MALLOC_ELEM_TRAILER_LEN;
 	uint8_t *ptr = (uint8_t *)&elem[1];
 	struct malloc_elem *next = RTE_PTR_ADD(elem, elem->size);
 	if (next->state == ELEM_FREE){
 		/* remove from free list, join to this one */
-		elem_free_list_remove(next);
+		malloc_elem_free_list_remove(next);
 		join_elem(elem, next);
 		sz += (sizeof(*elem) + MALLOC_ELEM_TRAILER_LEN);
 	}
@@ -261,7 +427,7 @@ malloc_elem_free(struct malloc_elem *elem)
 	 * need to re-insert in free list, as that element's size is changing
 	 */
 	if (elem->prev != NULL && elem->prev->state == ELEM_FREE) {
-		elem_free_list_remove(elem->prev);
+		malloc_elem_free_list_remove(elem->prev);
 		join_elem(elem->prev, elem);
 		sz += (sizeof(*elem) + MALLOC_ELEM_TRAILER_LEN);
 		ptr -= (sizeof(*elem) + MALLOC_ELEM_TRAILER_LEN);
@@ -274,7 +440,7 @@ malloc_elem_free(struct malloc_elem *elem)
 
 	memset(ptr, 0, sz);
 
-	rte_spinlock_unlock(&(elem->heap->lock));
+	rte_heap_unlock(&(elem->heap->lock));
 
 	return 0;
 }
@@ -292,7 +458,8 @@ malloc_elem_resize(struct malloc_elem *elem, size_t size)
 		return 0;
 
 	struct malloc_elem *next = RTE_PTR_ADD(elem, elem->size);
-	rte_spinlock_lock(&elem->heap->lock);
+	uintptr_t trim_end;
+	rte_heap_lock(&elem->heap->lock);
 	if (next ->state != ELEM_FREE)
 		goto err_return;
 	if (elem->size + next->size < new_size)
@@ -301,7 +468,8 @@ malloc_elem_resize(struct malloc_elem *elem, size_t size)
 	/* we now know the element fits, so remove from free list,
 	 * join the two
 	 */
-	elem_free_list_remove(next);
+	trim_end = elem_trim_end(next);
+	malloc_elem_free_list_remove(next);
 	join_elem(elem, next);
 
 	if (elem->size - new_size >= MIN_DATA_SIZE + MALLOC_ELEM_OVERHEAD) {
@@ -309,12 +477,13 @@ malloc_elem_resize(struct malloc_elem *elem, size_t size)
 		struct malloc_elem *split_pt = RTE_PTR_ADD(elem, new_size);
 		split_pt = RTE_PTR_ALIGN_CEIL(split_pt, RTE_CACHE_LINE_SIZE);
 		split_elem(elem, split_pt);
+		elem_retrim(split_pt, trim_end);
 		malloc_elem_free_list_insert(split_pt);
 	}
-	rte_spinlock_unlock(&elem->heap->lock);
+	rte_heap_unlock(&elem->heap->lock);
 	return 0;
 
 err_return:
-	rte_spinlock_unlock(&elem->heap->lock);
+	rte_heap_unlock(&elem->heap->lock);
 	return -1;
 }
@@ -24,6 +24,7 @@ struct malloc_elem {
 	volatile enum elem_state state;
 	uint32_t pad;
 	size_t size;
+	size_t trimmed;     /* bytes of a free elem given back to the system */
 #ifdef RTE_MALLOC_DEBUG
 	uint64_t header_cookie;         /* Cookie marking start of data */
 	                                /* trailer cookie at start + size */
@@ -133,6 +134,27 @@ struct malloc_elem *
 malloc_elem_alloc(struct malloc_elem *elem, size_t size,
 		unsigned align, size_t bound);
 
+/*
+ * get the whole pages of the data of a free element, which can be given
+ * back to the system, and return their length
+ */
+size_t
+malloc_elem_trim_bounds(const struct malloc_elem *elem, uintptr_t *start);
+
+/*
+ * forget the pages of an element given back to the system, as they are
+ * about to be used again
+ */
+void
+malloc_elem_untrim(struct malloc_elem *elem);
+
+/*
+ * put an element taken off the free lists back on them, merging it with
+ * the free elements around it
+ */
+void
+malloc_elem_free_list_reinsert(struct malloc_elem *elem);
+
 /*
  * free a malloc_elem block by adding it to the free list. If the
  * blocks either immediately before or immediately after newly freed block
@@ -154,10 +176,22 @@ malloc_elem_resize(struct malloc_elem *elem, size_t size);
 size_t
 malloc_elem_free_list_index(size_t size);
 
+/*
+ * Given a freelist index, compute the greatest element size it holds.
+ */
+size_t
+malloc_elem_free_list_max_size(size_t idx);
+
 /*
  * Add element to its heap's free list.
  */
 void
 malloc_elem_free_list_insert(struct malloc_elem *elem);
 
+/*
+ * Remove element from its heap's free list.
+ */
+void
+malloc_elem_free_list_remove(struct malloc_elem *elem);
+
 #endif /* MALLOC_ELEM_H_ */
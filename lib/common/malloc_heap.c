@@ -6,8 +6,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include <errno.h>
 #include <sys/queue.h>
+#include <sys/mman.h>
 
 #include <rte_memory.h>
 #include <rte_eal.h>
@@ -21,9 +23,16 @@
 #include <rte_memcpy.h>
 #include <rte_atomic.h>
 
+#include "eal_internal_cfg.h"
+#include "eal_memalloc.h"
 #include "malloc_elem.h"
 #include "malloc_heap.h"
 
+#ifdef RTE_MALLOC_HEAP_LOCK_MCS
+/* queue node of the thread for the heap locks, which are never nested */
+RTE_DEFINE_PER_LCORE(rte_mcslock_t, _heap_lock_node);
+#endif
+
 static unsigned
 check_hugepage_sz(unsigned flags, uint64_t hugepage_sz)
 {
@@ -116,11 +125,61 @@ find_suitable_element(struct malloc_heap *heap, size_t size,
 	return NULL;
 }
 
+/*
+ * Grow the heap with a new memseg able to hold an element of the given
+ * size and alignment, using the smallest page size matching the flags.
+ * Called without the heap lock, from the primary process, as the pages of
+ * the memseg are mapped and faulted in meanwhile: the lock is only taken
+ * to add the memseg to the heap.
+ */
+static int
+malloc_heap_grow(struct malloc_heap *heap, size_t size, unsigned flags,
+		size_t align)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	int socket_id = heap - mcfg->malloc_heaps;
+	struct rte_memseg *ms;
+	uint64_t page_sz;
+	size_t need, len;
+	int i, hint;
+
+	/* external heaps only hold the memory added by the application */
+	if (socket_id >= RTE_MAX_NUMA_NODES)
+		return -1;
+
+	/* start and end elements, plus the worst case padding */
+	need = size + align + 2 * MALLOC_ELEM_OVERHEAD + RTE_CACHE_LINE_SIZE;
+
+	/* page sizes are sorted from the largest one */
+	for (hint = 0; hint < 2; hint++) {
+		if (hint && !(flags & RTE_MEMZONE_SIZE_HINT_ONLY))
+			break;
+
+		for (i = internal_config.num_hugepage_sizes - 1; i >= 0; i--) {
+			page_sz = internal_config.hugepage_info[i].hugepage_sz;
+			if (!hint && !check_hugepage_sz(flags, page_sz))
+				continue;
+
+			len = RTE_ALIGN_CEIL(need, page_sz);
+			ms = eal_memalloc_alloc_seg(len, page_sz, socket_id);
+			if (ms == NULL)
+				continue;
+
+			rte_heap_lock(&heap->lock);
+			malloc_heap_add_memseg(heap, ms);
+			rte_heap_unlock(&heap->lock);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
 /*
  * Main function to allocate a block of memory from the heap.
  * It locks the free list, scans it, and adds a new memseg if the
- * scan fails. Once the new memseg is added, it re-scans and should return
- * the new element after releasing the lock.
+ * scan fails. The lock is dropped while the memseg is added, then the free
+ * list is scanned again, as other threads may have used it meanwhile.
  */
 void *
 malloc_heap_alloc(struct malloc_heap *heap,
@@ -132,54 +191,338 @@ malloc_heap_alloc(struct malloc_heap *heap,
 	size = RTE_CACHE_LINE_ROUNDUP(size);
 	align = RTE_CACHE_LINE_ROUNDUP(align);
 
-	rte_spinlock_lock(&heap->lock);
+	/* the heap may hold memsegs added by the primary process */
+	if (rte_eal_process_type() == RTE_PROC_SECONDARY &&
+			eal_memalloc_sync() < 0)
+		return NULL;
+
+	rte_heap_lock(&heap->lock);
 
 	elem = find_suitable_element(heap, size, flags, align, bound);
+	if (elem == NULL && internal_config.memory_hotplug &&
+			rte_eal_process_type() == RTE_PROC_PRIMARY) {
+		rte_heap_unlock(&heap->lock);
+		if (malloc_heap_grow(heap, size, flags, align) < 0)
+			return NULL;
+		rte_heap_lock(&heap->lock);
+		elem = find_suitable_element(heap, size, flags, align, bound);
+	}
 	if (elem != NULL) {
 		elem = malloc_elem_alloc(elem, size, align, bound);
 		/* increase heap's count of allocated elements */
 		heap->alloc_count++;
 	}
-	rte_spinlock_unlock(&heap->lock);
+	rte_heap_unlock(&heap->lock);
 
 	return elem == NULL ? NULL : (void *)(&elem[1]);
 }
 
 /*
- * Function to retrieve data for heap on given socket
+ * Release the memsegs of the heap added at runtime which are entirely
+ * free, as long as they are at the end of the memseg table.
+ */
+void
+malloc_heap_shrink(struct malloc_heap *heap)
+{
+	struct malloc_elem *elem, *next;
+	struct rte_memseg *ms;
+
+	if (!internal_config.memory_hotplug ||
+			rte_eal_process_type() != RTE_PROC_PRIMARY)
+		return;
+
+	for (;;) {
+		rte_heap_lock(&heap->lock);
+
+		ms = eal_memalloc_last_seg();
+		if (ms == NULL)
+			break;
+
+		/* a free memseg is a single free element and the end one */
+		elem = ms->addr;
+		if (elem->heap != heap || elem->state != ELEM_FREE)
+			break;
+		next = RTE_PTR_ADD(elem, elem->size);
+		if (next->size != 0 || next->state != ELEM_BUSY)
+			break;
+
+		/* detach the element, the memseg is released without the lock */
+		malloc_elem_free_list_remove(elem);
+		malloc_elem_untrim(elem);
+		elem->state = ELEM_BUSY;
+		heap->total_size -= elem->size;
+		rte_heap_unlock(&heap->lock);
+
+		if (eal_memalloc_free_seg(ms) == 0)
+			continue;
+
+		/* another heap added a memseg meanwhile */
+		rte_heap_lock(&heap->lock);
+		heap->total_size += elem->size;
+		malloc_elem_free_list_insert(elem);
+		break;
+	}
+
+	rte_heap_unlock(&heap->lock);
+}
+
+/*
+ * Only memory whose IO address does not depend on the physical pages can
+ * be trimmed, as pages may be replaced when faulted in again.
+ */
+static int
+malloc_heap_can_trim(const struct rte_memseg *ms)
+{
+	return ms->iova == RTE_BAD_IOVA || rte_eal_iova_mode() == RTE_IOVA_VA;
+}
+
+/*
+ * Give a range of free memory back to the system. Punching a hole in the
+ * backing file of hugepages frees them for good; anonymous memory is
+ * simply dropped. Either way, the range reads as zeros when touched again.
+ */
+static int
+malloc_heap_trim_range(void *addr, size_t len)
+{
+	if (madvise(addr, len, MADV_REMOVE) == 0)
+		return 0;
+	if (errno != EINVAL && errno != EOPNOTSUPP)
+		return -1;
+	return madvise(addr, len, MADV_DONTNEED);
+}
+
+/* number of free elements set aside at once to be trimmed */
+#define MALLOC_HEAP_TRIM_BATCH 32
+
+/*
+ * Give the whole pages of the free elements of a heap back to the system.
+ * The element headers and trailers are kept, and the elements whose pages
+ * were already given back are skipped. The elements are taken off the
+ * free lists, as busy ones, while their pages are dropped without the heap
+ * lock, then put back.
+ * Returns the number of bytes trimmed.
+ */
+size_t
+malloc_heap_trim(struct malloc_heap *heap)
+{
+	struct malloc_elem *batch[MALLOC_HEAP_TRIM_BATCH];
+	size_t len[MALLOC_HEAP_TRIM_BATCH];
+	struct malloc_elem *elem, *next;
+	uintptr_t start;
+	size_t idx, trimmed = 0;
+	unsigned int i, n;
+	int failed = 0;
+
+	do {
+		n = 0;
+		rte_heap_lock(&heap->lock);
+		for (idx = 0; idx < RTE_HEAP_NUM_FREELISTS; idx++) {
+			for (elem = LIST_FIRST(&heap->free_head[idx]);
+					elem != NULL && n < MALLOC_HEAP_TRIM_BATCH;
+					elem = next) {
+				next = LIST_NEXT(elem, free_list);
+				if (elem->trimmed != 0 ||
+						!malloc_heap_can_trim(elem->ms) ||
+						malloc_elem_trim_bounds(elem,
+							&start) == 0)
+					continue;
+
+				/* not allocated nor merged while trimmed */
+				malloc_elem_free_list_remove(elem);
+				elem->state = ELEM_BUSY;
+				batch[n++] = elem;
+			}
+		}
+		rte_heap_unlock(&heap->lock);
+
+		for (i = 0; i < n; i++) {
+			len[i] = malloc_elem_trim_bounds(batch[i], &start);
+			if (malloc_heap_trim_range((void *)start, len[i]) < 0) {
+				len[i] = 0;
+				failed = 1;
+			}
+		}
+
+		rte_heap_lock(&heap->lock);
+		for (i = 0; i < n; i++) {
+			batch[i]->trimmed = len[i];
+			heap->trimmed_size += len[i];
+			if (len[i] != 0)
+				heap->trimmed_count++;
+			trimmed += len[i];
+			malloc_elem_free_list_reinsert(batch[i]);
+		}
+		rte_heap_unlock(&heap->lock);
+
+		/* the elements failing to be trimmed would be taken again */
+	} while (n == MALLOC_HEAP_TRIM_BATCH && !failed);
+
+	return trimmed;
+}
+
+/*
+ * Function to retrieve data for heap on given socket. The counters are
+ * maintained along the free lists and read without the heap lock, so they
+ * may be slightly out of sync with each other while the heap is in use.
  */
 int
 malloc_heap_get_stats(struct malloc_heap *heap,
 		struct rte_malloc_socket_stats *socket_stats)
 {
+	const volatile struct malloc_heap *h = heap;
 	size_t idx;
-	struct malloc_elem *elem;
 
-	rte_spinlock_lock(&heap->lock);
+	socket_stats->free_count = h->free_count;
+	socket_stats->heap_freesz_bytes = h->free_size;
 
-	/* Initialise variables for heap */
-	socket_stats->free_count = 0;
-	socket_stats->heap_freesz_bytes = 0;
+	/* the greatest free element is in the last non-empty list */
 	socket_stats->greatest_free_size = 0;
-
-	/* Iterate through free list */
-	for (idx = 0; idx < RTE_HEAP_NUM_FREELISTS; idx++) {
-		for (elem = LIST_FIRST(&heap->free_head[idx]);
-			!!elem; elem = LIST_NEXT(elem, free_list))
-		{
-			socket_stats->free_count++;
-			socket_stats->heap_freesz_bytes += elem->size;
-			if (elem->size > socket_stats->greatest_free_size)
-				socket_stats->greatest_free_size = elem->size;
+	for (idx = RTE_HEAP_NUM_FREELISTS; idx-- > 0; ) {
+		if (h->free_stats[idx].count != 0) {
+			socket_stats->greatest_free_size =
+				h->free_stats[idx].max;
+			break;
 		}
 	}
+
 	/* Get stats on overall heap and allocated memory on this heap */
-	socket_stats->heap_totalsz_bytes = heap->total_size;
+	socket_stats->heap_totalsz_bytes = h->total_size;
 	socket_stats->heap_allocsz_bytes = (socket_stats->heap_totalsz_bytes -
 			socket_stats->heap_freesz_bytes);
-	socket_stats->alloc_count = heap->alloc_count;
+	socket_stats->alloc_count = h->alloc_count;
+	socket_stats->heap_trimmed_bytes = h->trimmed_size;
+	socket_stats->trimmed_count = h->trimmed_count;
+
+	return 0;
+}
+
+/*
+ * Function to retrieve the distribution of the free elements of a heap
+ * by size, without the heap lock.
+ */
+int
+malloc_heap_get_free_stats(struct malloc_heap *heap,
+		struct rte_malloc_free_class_stats *stats, unsigned int n)
+{
+	const volatile struct malloc_heap *h = heap;
+	unsigned int idx;
+
+	for (idx = 0; idx < n && idx < RTE_HEAP_NUM_FREELISTS; idx++) {
+		stats[idx].min_size = idx == 0 ? 0 :
+			malloc_elem_free_list_max_size(idx - 1);
+		stats[idx].max_size = malloc_elem_free_list_max_size(idx);
+		stats[idx].free_count = h->free_stats[idx].count;
+		stats[idx].free_bytes = h->free_stats[idx].size;
+		stats[idx].greatest_free_size = h->free_stats[idx].max;
+	}
+
+	return RTE_HEAP_NUM_FREELISTS;
+}
+
+/*
+ * Find a heap by name. Called with mlock held.
+ */
+struct malloc_heap *
+malloc_heap_find(const char *name)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	unsigned int i;
+
+	for (i = 0; i < RTE_MAX_HEAPS; i++) {
+		if (strncmp(mcfg->malloc_heaps[i].name, name,
+				RTE_HEAP_NAME_MAX_LEN) == 0)
+			return &mcfg->malloc_heaps[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Name the contention statistics of the heap locks, with RTE_LOCK_PROFILE.
+ */
+void
+malloc_heap_lock_prof_register(struct malloc_heap *heap)
+{
+#ifdef RTE_LOCK_PROFILE
+	/* truncated to RTE_LOCK_PROF_NAMESIZE by the registration */
+	char name[sizeof("heap  slabs") + RTE_HEAP_NAME_MAX_LEN];
+
+	snprintf(name, sizeof(name), "heap %s", heap->name);
+	rte_lock_prof_register(&heap->lock.prof, name);
+	snprintf(name, sizeof(name), "heap %s slabs", heap->name);
+	rte_lock_prof_register(&heap->slab_lock.prof, name);
+#else
+	RTE_SET_USED(heap);
+#endif
+}
+
+/*
+ * Set up an unused external heap with the given name, which must not be
+ * in use. Called with mlock held.
+ */
+struct malloc_heap *
+malloc_heap_create(const char *name)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	struct malloc_heap *heap;
+	unsigned int i;
+
+	for (i = RTE_MAX_NUMA_NODES; i < RTE_MAX_HEAPS; i++) {
+		heap = &mcfg->malloc_heaps[i];
+		if (heap->name[0] != '\0')
+			continue;
+
+		memset(heap, 0, sizeof(*heap));
+		rte_heap_lock_init(&heap->lock);
+		rte_heap_lock_init(&heap->slab_lock);
+		snprintf(heap->name, sizeof(heap->name), "%s", name);
+		malloc_heap_lock_prof_register(heap);
+		return heap;
+	}
+
+	return NULL;
+}
+
+/*
+ * Add an area of memory to an external heap. A memseg describing it is
+ * taken from the table of external memsegs, and the area is added to the
+ * heap as a single free element. Called with mlock held.
+ */
+int
+malloc_heap_add_external_memory(struct malloc_heap *heap, void *va_addr,
+		size_t len, size_t page_sz)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	struct rte_memseg *ms, *free_ms = NULL;
+	unsigned int i;
+
+	for (i = 0; i < RTE_MAX_MEMSEG; i++) {
+		ms = &mcfg->ext_memseg[i];
+		if (ms->len == 0) {
+			if (free_ms == NULL)
+				free_ms = ms;
+			continue;
+		}
+		/* the memory must not be in another heap */
+		if ((uintptr_t)va_addr < (uintptr_t)ms->addr + ms->len &&
+				(uintptr_t)ms->addr < (uintptr_t)va_addr + len)
+			return -EEXIST;
+	}
+	if (free_ms == NULL)
+		return -ENOSPC;
+
+	free_ms->iova = RTE_BAD_IOVA;
+	free_ms->addr = va_addr;
+	free_ms->hugepage_sz = page_sz;
+	free_ms->socket_id = heap - mcfg->malloc_heaps;
+	free_ms->nchannel = mcfg->nchannel;
+	free_ms->nrank = mcfg->nrank;
+	free_ms->len = len;
+
+	rte_heap_lock(&heap->lock);
+	malloc_heap_add_memseg(heap, free_ms);
+	rte_heap_unlock(&heap->lock);
 
-	rte_spinlock_unlock(&heap->lock);
 	return 0;
 }
 
@@ -193,6 +536,10 @@ rte_eal_malloc_heap_init(void)
 	if (mcfg == NULL)
 		return -1;
 
+	for (ms_cnt = 0; ms_cnt < RTE_MAX_NUMA_NODES; ms_cnt++)
+		snprintf(mcfg->malloc_heaps[ms_cnt].name, RTE_HEAP_NAME_MAX_LEN,
+				"socket_%u", ms_cnt);
+
 	for (ms = &mcfg->memseg[0], ms_cnt = 0;
 			(ms_cnt < RTE_MAX_MEMSEG) && (ms->len > 0);
 			ms_cnt++, ms++) {
@@ -27,10 +27,33 @@ void *
 malloc_heap_alloc(struct malloc_heap *heap,	const char *type, size_t size,
 		unsigned flags, size_t align, size_t bound);
 
+void
+malloc_heap_shrink(struct malloc_heap *heap);
+
+size_t
+malloc_heap_trim(struct malloc_heap *heap);
+
 int
 malloc_heap_get_stats(struct malloc_heap *heap,
 		struct rte_malloc_socket_stats *socket_stats);
 
+int
+malloc_heap_get_free_stats(struct malloc_heap *heap,
+		struct rte_malloc_free_class_stats *stats, unsigned int n);
+
+struct malloc_heap *
+malloc_heap_find(const char *name);
+
+struct malloc_heap *
+malloc_heap_create(const char *name);
+
+void
+malloc_heap_lock_prof_register(struct malloc_heap *heap);
+
+int
+malloc_heap_add_external_memory(struct malloc_heap *heap, void *va_addr,
+		size_t len, size_t page_sz);
+
 int
 rte_eal_malloc_heap_init(void);
 
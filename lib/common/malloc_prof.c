@@ -0,0 +1,285 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+/* RTE_BACKTRACE must be known before execinfo.h is needed */
+#include <rte_config.h>
+#ifdef RTE_BACKTRACE
+#include <execinfo.h>
+#endif
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_log.h>
+#include <rte_cycles.h>
+#include <rte_per_lcore.h>
+#include <rte_atomic.h>
+#include <rte_spinlock.h>
+#include <rte_malloc_prof.h>
+
+#define MALLOC_PROF_TABLE_MASK (RTE_MALLOC_PROF_MAX_SAMPLES - 1)
+
+/* keys of the sample table which are not addresses */
+#define SAMPLE_EMPTY   0
+#define SAMPLE_DELETED 1
+#define SAMPLE_BUSY    2
+
+/*
+ * Slots probed from the hash of an address. A sample is only stored in
+ * the first slots, so that looking it up stops there however many
+ * DELETED slots the freed samples left in the table.
+ */
+#define MALLOC_PROF_MAX_PROBE 64
+
+/* frames of the profiler itself, at the top of the recorded stacks */
+#define SAMPLE_SKIP_FRAMES 1
+
+/*
+ * A sample is owned by the thread which changed its key from EMPTY or
+ * DELETED to BUSY, and is published by setting the key to the address of
+ * the allocation.
+ */
+struct malloc_prof_sample {
+	volatile uint64_t key;
+	uint64_t weight;
+	size_t size;
+	int depth;
+	void *stack[RTE_MALLOC_PROF_MAX_DEPTH];
+};
+
+volatile uint64_t rte_malloc_prof_period;
+
+/* samples of the live allocations, open addressing on the address */
+static struct malloc_prof_sample *prof_table;
+static rte_spinlock_t prof_lock = RTE_SPINLOCK_INITIALIZER;
+static rte_atomic64_t prof_dropped;
+
+/* bytes left to allocate by the lcore before the next sample, 0 unset */
+static RTE_DEFINE_PER_LCORE(int64_t, prof_left);
+
+static inline unsigned int
+malloc_prof_hash(const void *addr)
+{
+	/* allocations are at least 16-byte aligned */
+	return (unsigned int)((((uintptr_t)addr >> 4) *
+			0x9e3779b97f4a7c15ULL) >> 32) & MALLOC_PROF_TABLE_MASK;
+}
+
+/* random distance to the first sample of a thread, in [1, period] */
+static int64_t
+malloc_prof_first_left(uint64_t period)
+{
+	uint64_t x = rte_rdtsc() ^ (uintptr_t)&RTE_PER_LCORE(prof_left);
+
+	/* splitmix64 finalizer, so that close seeds give distant draws */
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+
+	return (int64_t)(1 + x % period);
+}
+
+void
+__rte_malloc_prof_alloc(const void *addr, size_t size)
+{
+	struct malloc_prof_sample *s;
+	uint64_t period = rte_malloc_prof_period;
+	void *stack[RTE_MALLOC_PROF_MAX_DEPTH];
+	unsigned int i, idx;
+	int64_t left;
+	uint64_t n, key;
+	int depth = 0;
+
+	if (period == 0 || prof_table == NULL)
+		return;
+
+	/*
+	 * Start each thread at a random point of the period, so that its
+	 * first allocation is not always sampled.
+	 */
+	if (unlikely(RTE_PER_LCORE(prof_left) == 0))
+		RTE_PER_LCORE(prof_left) = malloc_prof_first_left(period);
+
+	left = RTE_PER_LCORE(prof_left) - (int64_t)size;
+	if (left > 0) {
+		RTE_PER_LCORE(prof_left) = left;
+		return;
+	}
+	/* a large allocation may cross several periods */
+	n = 1 + (uint64_t)(-left) / period;
+	RTE_PER_LCORE(prof_left) = left + (int64_t)(n * period);
+
+#ifdef RTE_BACKTRACE
+	depth = backtrace(stack, RTE_MALLOC_PROF_MAX_DEPTH);
+#endif
+
+	idx = malloc_prof_hash(addr);
+	for (i = 0; i < MALLOC_PROF_MAX_PROBE; i++) {
+		s = &prof_table[(idx + i) & MALLOC_PROF_TABLE_MASK];
+		key = s->key;
+		if (key != SAMPLE_EMPTY && key != SAMPLE_DELETED)
+			continue;
+		if (!rte_atomic64_cmpset(&s->key, key, SAMPLE_BUSY))
+			continue;
+
+		s->weight = n * period;
+		s->size = size;
+		s->depth = depth;
+		memcpy(s->stack, stack, depth * sizeof(stack[0]));
+		rte_smp_wmb();
+		s->key = (uintptr_t)addr;
+		return;
+	}
+
+	rte_atomic64_inc(&prof_dropped);
+}
+
+void
+__rte_malloc_prof_free(const void *addr)
+{
+	struct malloc_prof_sample *s;
+	unsigned int i, idx;
+
+	if (prof_table == NULL)
+		return;
+
+	idx = malloc_prof_hash(addr);
+	for (i = 0; i < MALLOC_PROF_MAX_PROBE; i++) {
+		s = &prof_table[(idx + i) & MALLOC_PROF_TABLE_MASK];
+		if (s->key == SAMPLE_EMPTY)
+			return;
+		if (s->key == (uintptr_t)addr) {
+			rte_atomic64_cmpset(&s->key, (uintptr_t)addr,
+					SAMPLE_DELETED);
+			return;
+		}
+	}
+}
+
+int
+rte_malloc_prof_start(uint64_t period)
+{
+#ifdef RTE_BACKTRACE
+	void *probe[1];
+
+	if (period == 0)
+		return -EINVAL;
+
+	rte_spinlock_lock(&prof_lock);
+	if (prof_table == NULL) {
+		/* the table is never freed, as it can be used concurrently */
+		prof_table = calloc(RTE_MALLOC_PROF_MAX_SAMPLES,
+				sizeof(*prof_table));
+		if (prof_table == NULL) {
+			rte_spinlock_unlock(&prof_lock);
+			return -ENOMEM;
+		}
+		/* load the unwinder now, it may allocate on first use */
+		backtrace(probe, 1);
+	}
+	rte_malloc_prof_period = period;
+	rte_spinlock_unlock(&prof_lock);
+
+	return 0;
+#else
+	RTE_SET_USED(period);
+	return -ENOTSUP;
+#endif
+}
+
+void
+rte_malloc_prof_stop(void)
+{
+	unsigned int i;
+
+	rte_spinlock_lock(&prof_lock);
+	rte_malloc_prof_period = 0;
+	if (prof_table != NULL) {
+		for (i = 0; i < RTE_MALLOC_PROF_MAX_SAMPLES; i++)
+			prof_table[i].key = SAMPLE_EMPTY;
+	}
+	rte_atomic64_clear(&prof_dropped);
+	rte_spinlock_unlock(&prof_lock);
+}
+
+#ifdef RTE_BACKTRACE
+/* print the function name of a frame as resolved by backtrace_symbols() */
+static void
+malloc_prof_print_frame(FILE *f, const char *symb, void *addr)
+{
+	const char *start = NULL;
+	size_t len = 0;
+
+	if (symb != NULL)
+		start = strchr(symb, '(');
+	if (start != NULL) {
+		start++;
+		len = strcspn(start, "+)");
+	}
+
+	if (len > 0)
+		fprintf(f, "%.*s", (int)len, start);
+	else
+		fprintf(f, "%p", addr);
+}
+#endif
+
+unsigned int
+rte_malloc_prof_dump(FILE *f)
+{
+	unsigned int count = 0;
+#ifdef RTE_BACKTRACE
+	struct malloc_prof_sample sample;
+	struct malloc_prof_sample *s;
+	char **symb;
+	unsigned int i;
+	uint64_t key;
+	int j;
+
+	rte_spinlock_lock(&prof_lock);
+	if (prof_table == NULL) {
+		rte_spinlock_unlock(&prof_lock);
+		return 0;
+	}
+
+	for (i = 0; i < RTE_MALLOC_PROF_MAX_SAMPLES; i++) {
+		s = &prof_table[i];
+		key = s->key;
+		if (key <= SAMPLE_BUSY)
+			continue;
+		rte_smp_rmb();
+		memcpy(&sample, s, sizeof(sample));
+		rte_smp_rmb();
+		/* freed and maybe reused meanwhile */
+		if (s->key != key || sample.depth <= SAMPLE_SKIP_FRAMES)
+			continue;
+
+		symb = backtrace_symbols(sample.stack, sample.depth);
+		for (j = sample.depth - 1; j >= SAMPLE_SKIP_FRAMES; j--) {
+			malloc_prof_print_frame(f, symb != NULL ? symb[j] : NULL,
+					sample.stack[j]);
+			fprintf(f, "%s", j > SAMPLE_SKIP_FRAMES ? ";" : "");
+		}
+		fprintf(f, " %" PRIu64 "\n", sample.weight);
+		free(symb);
+		count++;
+	}
+
+	/* not in the output, which must only hold stacks */
+	if (rte_atomic64_read(&prof_dropped) != 0)
+		RTE_LOG(WARNING, EAL, "%" PRId64 " malloc samples dropped, "
+			"no free slot near their address\n",
+			rte_atomic64_read(&prof_dropped));
+	rte_spinlock_unlock(&prof_lock);
+#else
+	RTE_SET_USED(f);
+#endif
+
+	return count;
+}
@@ -6,6 +6,10 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/queue.h>
 
 #include <rte_memcpy.h>
@@ -19,25 +23,242 @@
 #include <rte_lcore.h>
 #include <rte_common.h>
 #include <rte_spinlock.h>
+#include <rte_errno.h>
 
 #include <rte_malloc.h>
+#include <rte_malloc_prof.h>
 #include "malloc_elem.h"
 #include "malloc_heap.h"
+#include "eal_memalloc.h"
 
+/*
+ * Small objects are allocated from slabs, each slab being a single
+ * element of a heap, aligned on its size so that the slab of an object is
+ * found by masking its address. The objects are 16-byte aligned, but never
+ * cache line aligned, unlike the data of malloc elements: this is how
+ * rte_free() tells them apart without reading any memory.
+ */
+#define MALLOC_SLAB_SIZE      32768
+#define MALLOC_SLAB_MIN_SHIFT 4
+#define MALLOC_SLAB_MAX_SIZE  (1 << (MALLOC_SLAB_MIN_SHIFT + \
+		RTE_HEAP_NUM_SLAB_CLASSES - 1))
+#define MALLOC_SLAB_ALIGN     (1 << MALLOC_SLAB_MIN_SHIFT)
+#define MALLOC_SLAB_MAX_OBJS  (MALLOC_SLAB_SIZE >> MALLOC_SLAB_MIN_SHIFT)
+
+struct malloc_slab {
+	struct malloc_heap *heap;
+	LIST_ENTRY(malloc_slab) next;   /* in the list of its size class */
+	uint32_t cls;                   /* size class */
+	uint32_t obj_size;
+	uint32_t nb_obj;                /* number of usable objects */
+	uint32_t nb_free;
+	uint64_t free_bmp[MALLOC_SLAB_MAX_OBJS / 64]; /* bit set if free */
+};
+
+/* offset of the first object, not cache line aligned */
+#define MALLOC_SLAB_OBJ_OFFSET \
+	(RTE_ALIGN_CEIL(sizeof(struct malloc_slab), RTE_CACHE_LINE_SIZE) + \
+	 MALLOC_SLAB_ALIGN)
+
+static inline int
+malloc_slab_is_obj(const void *addr)
+{
+	return ((uintptr_t)addr & (RTE_CACHE_LINE_SIZE - 1)) != 0;
+}
+
+static inline struct malloc_slab *
+malloc_slab_from_obj(const void *addr)
+{
+	return (struct malloc_slab *)RTE_ALIGN_FLOOR((uintptr_t)addr,
+			MALLOC_SLAB_SIZE);
+}
+
+static inline void *
+malloc_slab_obj(struct malloc_slab *slab, unsigned int idx)
+{
+	return RTE_PTR_ADD(slab, MALLOC_SLAB_OBJ_OFFSET +
+			(size_t)idx * slab->obj_size);
+}
+
+/* return the size class of a small object */
+static inline unsigned int
+malloc_slab_class(size_t size)
+{
+	if (size <= MALLOC_SLAB_ALIGN)
+		return 0;
+	return sizeof(unsigned int) * CHAR_BIT -
+		__builtin_clz((unsigned int)size - 1) - MALLOC_SLAB_MIN_SHIFT;
+}
+
+/*
+ * Allocate a new slab of a size class from the heap. The slots which would
+ * be cache line aligned are not used.
+ */
+static struct malloc_slab *
+malloc_slab_create(struct malloc_heap *heap, unsigned int cls)
+{
+	struct malloc_slab *slab;
+	unsigned int i, nb_slots;
+
+	slab = malloc_heap_alloc(heap, "malloc_slab", MALLOC_SLAB_SIZE, 0,
+			MALLOC_SLAB_SIZE, 0);
+	if (slab == NULL)
+		return NULL;
+
+	slab->heap = heap;
+	slab->cls = cls;
+	slab->obj_size = MALLOC_SLAB_ALIGN << cls;
+	slab->nb_obj = 0;
+	nb_slots = (MALLOC_SLAB_SIZE - MALLOC_SLAB_OBJ_OFFSET) / slab->obj_size;
+	memset(slab->free_bmp, 0, sizeof(slab->free_bmp));
+	for (i = 0; i < nb_slots; i++) {
+		if (!malloc_slab_is_obj(malloc_slab_obj(slab, i)))
+			continue;
+		slab->free_bmp[i / 64] |= 1ULL << (i % 64);
+		slab->nb_obj++;
+	}
+	slab->nb_free = slab->nb_obj;
+
+	return slab;
+}
+
+/*
+ * Allocate a small object from the slabs of the heap.
+ */
+static void *
+malloc_slab_alloc(struct malloc_heap *heap, size_t size)
+{
+	unsigned int cls = malloc_slab_class(size);
+	struct malloc_slab *slab, *new_slab = NULL;
+	unsigned int i;
+	void *obj;
+
+	rte_heap_lock(&heap->slab_lock);
+	slab = LIST_FIRST(&heap->slabs[cls]);
+	if (slab == NULL) {
+		/* don't hold the slab lock while allocating from the heap */
+		rte_heap_unlock(&heap->slab_lock);
+		new_slab = malloc_slab_create(heap, cls);
+		if (new_slab == NULL)
+			return NULL;
+		rte_heap_lock(&heap->slab_lock);
+		LIST_INSERT_HEAD(&heap->slabs[cls], new_slab, next);
+		slab = new_slab;
+	}
+
+	for (i = 0; slab->free_bmp[i] == 0; i++)
+		;
+	i = i * 64 + __builtin_ctzll(slab->free_bmp[i]);
+	slab->free_bmp[i / 64] &= ~(1ULL << (i % 64));
+	if (--slab->nb_free == 0)
+		LIST_REMOVE(slab, next);
+	obj = malloc_slab_obj(slab, i);
+
+	rte_heap_unlock(&heap->slab_lock);
+
+	return obj;
+}
+
+/*
+ * Give a small object back to its slab. As for malloc elements, the
+ * memory is cleared, as rte_zmalloc() relies on it. An empty slab is
+ * given back to the heap, unless it is the last one of its size class.
+ */
+static int
+malloc_slab_free(void *addr)
+{
+	struct malloc_slab *slab = malloc_slab_from_obj(addr);
+	struct malloc_heap *heap = slab->heap;
+	size_t off = RTE_PTR_DIFF(addr, slab);
+	unsigned int idx;
+	uint64_t mask;
+	int release = 0;
+
+	if (off < MALLOC_SLAB_OBJ_OFFSET ||
+			(off - MALLOC_SLAB_OBJ_OFFSET) % slab->obj_size != 0)
+		return -1;
+	idx = (off - MALLOC_SLAB_OBJ_OFFSET) / slab->obj_size;
+	mask = 1ULL << (idx % 64);
+
+	memset(addr, 0, slab->obj_size);
+
+	rte_heap_lock(&heap->slab_lock);
+	if (slab->free_bmp[idx / 64] & mask) {
+		rte_heap_unlock(&heap->slab_lock);
+		return -1;
+	}
+	slab->free_bmp[idx / 64] |= mask;
+	if (slab->nb_free++ == 0)
+		LIST_INSERT_HEAD(&heap->slabs[slab->cls], slab, next);
+	if (slab->nb_free == slab->nb_obj &&
+			(LIST_FIRST(&heap->slabs[slab->cls]) != slab ||
+			 LIST_NEXT(slab, next) != NULL)) {
+		LIST_REMOVE(slab, next);
+		release = 1;
+	}
+	rte_heap_unlock(&heap->slab_lock);
+
+	if (release)
+		rte_free(slab);
+
+	return 0;
+}
+
+/*
+ * Allocate from a heap, using the slabs for small objects with a small
+ * alignment.
+ */
+static void *
+malloc_socket_heap_alloc(struct malloc_heap *heap, const char *type,
+		size_t size, unsigned int align)
+{
+	void *ret;
+
+	if (size <= MALLOC_SLAB_MAX_SIZE && align <= MALLOC_SLAB_ALIGN) {
+		ret = malloc_slab_alloc(heap, size);
+		if (ret != NULL)
+			return ret;
+	}
+
+	return malloc_heap_alloc(heap, type, size, 0,
+			align == 0 ? 1 : align, 0);
+}
 
 /* Free the memory space back to heap */
 void rte_free(void *addr)
 {
+	struct malloc_elem *elem;
+	struct malloc_heap *heap;
+	int hotplug;
+
 	if (addr == NULL) return;
-	if (malloc_elem_free(malloc_elem_from_data(addr)) < 0)
+	rte_malloc_prof_free(addr);
+	if (malloc_slab_is_obj(addr)) {
+		if (malloc_slab_free(addr) < 0)
+			rte_panic("Fatal error: Invalid memory\n");
+		return;
+	}
+	elem = malloc_elem_from_data(addr);
+	if (elem == NULL)
 		rte_panic("Fatal error: Invalid memory\n");
+
+	/* the element header may be merged away when freed */
+	heap = elem->heap;
+	hotplug = eal_memalloc_is_hotplug(elem->ms);
+
+	if (malloc_elem_free(elem) < 0)
+		rte_panic("Fatal error: Invalid memory\n");
+
+	/* give the memory added at runtime back to the system */
+	if (hotplug)
+		malloc_heap_shrink(heap);
 }
 
 /*
  * Allocate memory on specified heap.
  */
-void *
-rte_malloc_socket(const char *type, size_t size, unsigned align, int socket_arg)
+static void *
+malloc_socket(const char *type, size_t size, unsigned align, int socket_arg)
 {
 	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
 	int socket, i;
@@ -47,20 +268,29 @@ rte_malloc_socket(const char *type, size_t size, unsigned align, int socket_arg)
 	if (size == 0 || (align && !rte_is_power_of_2(align)))
 		return NULL;
 
-	if (!rte_eal_has_hugepages())
-		socket_arg = SOCKET_ID_ANY;
-
 	if (socket_arg == SOCKET_ID_ANY)
 		socket = malloc_get_numa_socket();
 	else
 		socket = socket_arg;
 
+	/* external heaps are only used when asked for */
+	if (socket >= RTE_MAX_NUMA_NODES && socket < RTE_MAX_HEAPS) {
+		if (mcfg->malloc_heaps[socket].name[0] == '\0')
+			return NULL;
+		return malloc_socket_heap_alloc(&mcfg->malloc_heaps[socket],
+				type, size, align);
+	}
+
+	/* without hugepages, the socket is only a preference */
+	if (!rte_eal_has_hugepages())
+		socket_arg = SOCKET_ID_ANY;
+
 	/* Check socket parameter */
 	if (socket >= RTE_MAX_NUMA_NODES)
 		return NULL;
 
-	ret = malloc_heap_alloc(&mcfg->malloc_heaps[socket], type,
-				size, 0, align == 0 ? 1 : align, 0);
+	ret = malloc_socket_heap_alloc(&mcfg->malloc_heaps[socket], type,
+				size, align);
 	if (ret != NULL || socket_arg != SOCKET_ID_ANY)
 		return ret;
 
@@ -70,8 +300,8 @@ rte_malloc_socket(const char *type, size_t size, unsigned align, int socket_arg)
 		if (i == socket)
 			continue;
 
-		ret = malloc_heap_alloc(&mcfg->malloc_heaps[i], type,
-					size, 0, align == 0 ? 1 : align, 0);
+		ret = malloc_socket_heap_alloc(&mcfg->malloc_heaps[i], type,
+					size, align);
 		if (ret != NULL)
 			return ret;
 	}
@@ -79,6 +309,15 @@ rte_malloc_socket(const char *type, size_t size, unsigned align, int socket_arg)
 	return NULL;
 }
 
+void *
+rte_malloc_socket(const char *type, size_t size, unsigned align, int socket_arg)
+{
+	void *ret = malloc_socket(type, size, align, socket_arg);
+
+	rte_malloc_prof_alloc(ret, size);
+	return ret;
+}
+
 /*
  * Allocate memory on default heap.
  */
@@ -133,6 +372,21 @@ rte_realloc(void *ptr, size_t size, unsigned align)
 	if (ptr == NULL)
 		return rte_malloc(NULL, size, align);
 
+	if (malloc_slab_is_obj(ptr)) {
+		const struct malloc_slab *slab = malloc_slab_from_obj(ptr);
+		void *new_ptr;
+
+		/* the object is 16-byte aligned */
+		if (size <= slab->obj_size && align <= MALLOC_SLAB_ALIGN)
+			return ptr;
+		new_ptr = rte_malloc(NULL, size, align);
+		if (new_ptr == NULL)
+			return NULL;
+		rte_memcpy(new_ptr, ptr, RTE_MIN(size, (size_t)slab->obj_size));
+		rte_free(ptr);
+		return new_ptr;
+	}
+
 	struct malloc_elem *elem = malloc_elem_from_data(ptr);
 	if (elem == NULL)
 		rte_panic("Fatal error: memory corruption detected\n");
@@ -158,6 +412,18 @@ rte_realloc(void *ptr, size_t size, unsigned align)
 int
 rte_malloc_validate(const void *ptr, size_t *size)
 {
+	if (ptr != NULL && malloc_slab_is_obj(ptr)) {
+		const struct malloc_slab *slab = malloc_slab_from_obj(ptr);
+
+		if (RTE_PTR_DIFF(ptr, slab) < MALLOC_SLAB_OBJ_OFFSET ||
+				(RTE_PTR_DIFF(ptr, slab) -
+				 MALLOC_SLAB_OBJ_OFFSET) % slab->obj_size != 0)
+			return -1;
+		if (size != NULL)
+			*size = slab->obj_size;
+		return 0;
+	}
+
 	const struct malloc_elem *elem = malloc_elem_from_data(ptr);
 	if (!malloc_elem_cookies_ok(elem))
 		return -1;
@@ -175,26 +441,156 @@ rte_malloc_get_socket_stats(int socket,
 {
 	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
 
-	if (socket >= RTE_MAX_NUMA_NODES || socket < 0)
+	if (socket >= RTE_MAX_HEAPS || socket < 0)
+		return -1;
+	if (mcfg->malloc_heaps[socket].name[0] == '\0')
 		return -1;
 
 	return malloc_heap_get_stats(&mcfg->malloc_heaps[socket], socket_stats);
 }
 
+/*
+ * Give the free pages of the heap on given socket back to the system
+ */
+int
+rte_malloc_heap_trim(int socket, size_t *trimmed)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	size_t total = 0;
+	int i;
+
+	if (socket != SOCKET_ID_ANY &&
+			(socket < 0 || socket >= RTE_MAX_NUMA_NODES)) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+		if (socket == SOCKET_ID_ANY || socket == i)
+			total += malloc_heap_trim(&mcfg->malloc_heaps[i]);
+	}
+
+	if (trimmed != NULL)
+		*trimmed = total;
+	return 0;
+}
+
+static pthread_t trim_thread;
+static pthread_mutex_t trim_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trim_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int trim_period_ms;
+static int trim_running;
+
+/* trim all the heaps periodically until stopped */
+static void *
+malloc_heap_trim_thread(__rte_unused void *arg)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&trim_mutex);
+	while (trim_running) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += trim_period_ms / 1000;
+		ts.tv_nsec += (trim_period_ms % 1000) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		if (pthread_cond_timedwait(&trim_cond, &trim_mutex, &ts) !=
+				ETIMEDOUT)
+			continue;
+
+		pthread_mutex_unlock(&trim_mutex);
+		rte_malloc_heap_trim(SOCKET_ID_ANY, NULL);
+		pthread_mutex_lock(&trim_mutex);
+	}
+	pthread_mutex_unlock(&trim_mutex);
+
+	return NULL;
+}
+
+int
+rte_malloc_heap_trim_start(unsigned int period_ms)
+{
+	int ret;
+
+	if (period_ms == 0) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&trim_mutex);
+	if (trim_running) {
+		pthread_mutex_unlock(&trim_mutex);
+		rte_errno = EALREADY;
+		return -1;
+	}
+	trim_period_ms = period_ms;
+	trim_running = 1;
+	ret = pthread_create(&trim_thread, NULL, malloc_heap_trim_thread, NULL);
+	if (ret != 0)
+		trim_running = 0;
+	pthread_mutex_unlock(&trim_mutex);
+
+	if (ret != 0) {
+		rte_errno = ret;
+		return -1;
+	}
+	return 0;
+}
+
+void
+rte_malloc_heap_trim_stop(void)
+{
+	pthread_mutex_lock(&trim_mutex);
+	if (!trim_running) {
+		pthread_mutex_unlock(&trim_mutex);
+		return;
+	}
+	trim_running = 0;
+	pthread_cond_signal(&trim_cond);
+	pthread_mutex_unlock(&trim_mutex);
+
+	pthread_join(trim_thread, NULL);
+}
+
+/*
+ * Function to retrieve the free memory distribution of heap on given socket
+ */
+int
+rte_malloc_get_socket_free_stats(int socket,
+		struct rte_malloc_free_class_stats *stats, unsigned int n)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+
+	if (socket >= RTE_MAX_HEAPS || socket < 0)
+		return -1;
+	if (mcfg->malloc_heaps[socket].name[0] == '\0')
+		return -1;
+
+	return malloc_heap_get_free_stats(&mcfg->malloc_heaps[socket],
+			stats, n);
+}
+
 /*
  * Print stats on memory type. If type is NULL, info on all types is printed
  */
 void
 rte_malloc_dump_stats(FILE *f, __rte_unused const char *type)
 {
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
 	unsigned int socket;
 	struct rte_malloc_socket_stats sock_stats;
 	/* Iterate through all initialised heaps */
-	for (socket=0; socket< RTE_MAX_NUMA_NODES; socket++) {
+	for (socket=0; socket< RTE_MAX_HEAPS; socket++) {
 		if ((rte_malloc_get_socket_stats(socket, &sock_stats) < 0))
 			continue;
 
-		fprintf(f, "Socket:%u\n", socket);
+		if (socket < RTE_MAX_NUMA_NODES)
+			fprintf(f, "Socket:%u\n", socket);
+		else
+			fprintf(f, "Heap:%s (id %u)\n",
+					mcfg->malloc_heaps[socket].name, socket);
 		fprintf(f, "\tHeap_size:%zu,\n", sock_stats.heap_totalsz_bytes);
 		fprintf(f, "\tFree_size:%zu,\n", sock_stats.heap_freesz_bytes);
 		fprintf(f, "\tAlloc_size:%zu,\n", sock_stats.heap_allocsz_bytes);
@@ -202,10 +598,119 @@ rte_malloc_dump_stats(FILE *f, __rte_unused const char *type)
 				sock_stats.greatest_free_size);
 		fprintf(f, "\tAlloc_count:%u,\n",sock_stats.alloc_count);
 		fprintf(f, "\tFree_count:%u,\n", sock_stats.free_count);
+		fprintf(f, "\tTrimmed_size:%zu,\n",
+				sock_stats.heap_trimmed_bytes);
+		fprintf(f, "\tTrimmed_count:%u,\n", sock_stats.trimmed_count);
 	}
 	return;
 }
 
+/*
+ * Create an external heap, without memory.
+ */
+int
+rte_malloc_heap_create(const char *heap_name)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	int ret = 0;
+
+	if (heap_name == NULL || heap_name[0] == '\0') {
+		rte_errno = EINVAL;
+		return -1;
+	}
+	if (strnlen(heap_name, RTE_HEAP_NAME_MAX_LEN) ==
+			RTE_HEAP_NAME_MAX_LEN) {
+		rte_errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	rte_mcfg_write_lock(mcfg);
+
+	if (malloc_heap_find(heap_name) != NULL) {
+		rte_errno = EEXIST;
+		ret = -1;
+	} else if (malloc_heap_create(heap_name) == NULL) {
+		rte_errno = ENOSPC;
+		ret = -1;
+	}
+
+	rte_mcfg_write_unlock(mcfg);
+
+	return ret;
+}
+
+/*
+ * Add an area of memory mapped by the application to an external heap.
+ */
+int
+rte_malloc_heap_memory_add(const char *heap_name, void *va_addr, size_t len,
+		size_t page_sz)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	struct malloc_heap *heap;
+	int ret;
+
+	if (heap_name == NULL || va_addr == NULL || len == 0 ||
+			!rte_is_power_of_2(page_sz) ||
+			RTE_PTR_ALIGN(va_addr, page_sz) != va_addr ||
+			len % page_sz != 0 ||
+			len < 2 * MALLOC_ELEM_OVERHEAD + RTE_CACHE_LINE_SIZE) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	rte_mcfg_write_lock(mcfg);
+
+	heap = malloc_heap_find(heap_name);
+	if (heap == NULL) {
+		ret = -ENOENT;
+	} else if (heap - mcfg->malloc_heaps < RTE_MAX_NUMA_NODES) {
+		/* socket heaps only hold memory of the EAL */
+		ret = -EPERM;
+	} else {
+		ret = malloc_heap_add_external_memory(heap, va_addr, len,
+				page_sz);
+	}
+
+	rte_mcfg_write_unlock(mcfg);
+
+	if (ret < 0) {
+		rte_errno = -ret;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Get the socket identifier of a heap, to allocate from it.
+ */
+int
+rte_malloc_heap_get_socket(const char *heap_name)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	struct malloc_heap *heap;
+	int ret;
+
+	if (heap_name == NULL || heap_name[0] == '\0') {
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	rte_mcfg_read_lock(mcfg);
+
+	heap = malloc_heap_find(heap_name);
+	if (heap == NULL) {
+		rte_errno = ENOENT;
+		ret = -1;
+	} else {
+		ret = heap - mcfg->malloc_heaps;
+	}
+
+	rte_mcfg_read_unlock(mcfg);
+
+	return ret;
+}
+
 /*
  * TODO: Set limit to memory that can be allocated to memory type
  */
@@ -215,3 +720,30 @@ rte_malloc_set_limit(__rte_unused const char *type,
 {
 	return 0;
 }
+
+/*
+ * Return the IO address of a virtual address obtained through rte_malloc
+ */
+rte_iova_t
+rte_malloc_virt2iova(const void *addr)
+{
+	rte_iova_t iova;
+	const struct malloc_elem *elem;
+
+	/* small objects are in the element of their slab */
+	if (malloc_slab_is_obj(addr))
+		elem = malloc_elem_from_data(malloc_slab_from_obj(addr));
+	else
+		elem = malloc_elem_from_data(addr);
+	if (elem == NULL)
+		return RTE_BAD_IOVA;
+	if (elem->ms->iova == RTE_BAD_IOVA)
+		return RTE_BAD_IOVA;
+
+	if (rte_eal_iova_mode() == RTE_IOVA_VA)
+		iova = (uintptr_t)addr;
+	else
+		iova = elem->ms->iova +
+			RTE_PTR_DIFF(addr, elem->ms->addr);
+	return iova;
+}
@@ -25,6 +25,7 @@
 #include <rte_eal_memconfig.h>
 #include <rte_per_lcore.h>
 #include <rte_lcore.h>
+#include <rte_parallel.h>
 #include <rte_branch_prediction.h>
 #include <rte_errno.h>
 #include <rte_string_fns.h>
@@ -98,8 +99,11 @@ static unsigned optimize_object_size(unsigned obj_size)
 	return new_obj_size * RTE_MEMPOOL_ALIGN;
 }
 
+/* number of objects enqueued at once when populating a pool */
+#define MEMPOOL_POPULATE_BULK 64
+
 static void
-mempool_add_elem(struct rte_mempool *mp, void *obj)
+mempool_init_elem(struct rte_mempool *mp, void *obj)
 {
 	struct rte_mempool_objhdr *hdr;
 	struct rte_mempool_objtlr *tlr __rte_unused;
@@ -107,17 +111,106 @@ mempool_add_elem(struct rte_mempool *mp, void *obj)
 	/* set mempool ptr in header */
 	hdr = RTE_PTR_SUB(obj, sizeof(*hdr));
 	hdr->mp = mp;
-	STAILQ_INSERT_TAIL(&mp->elt_list, hdr, next);
-	mp->populated_size++;
 
 #ifdef RTE_LIBRTE_MEMPOOL_DEBUG
 	hdr->cookie = RTE_MEMPOOL_HEADER_COOKIE2;
 	tlr = __mempool_get_trailer(obj);
 	tlr->cookie = RTE_MEMPOOL_TRAILER_COOKIE;
 #endif
+}
+
+/* Initialize n objects stored from vaddr + off, append them to the
+ * given list, call obj_cb() on each of them if not NULL, and enqueue
+ * them in the pool by bulks. The objects are written by the calling
+ * thread, so their pages are first touched from its lcore.
+ */
+static void
+mempool_populate_objs(struct rte_mempool *mp, char *vaddr, size_t off,
+	unsigned int obj_idx, unsigned int n,
+	rte_mempool_obj_cb_t *obj_cb, void *obj_cb_arg,
+	struct rte_mempool_objhdr_list *list)
+{
+	void *objs[MEMPOOL_POPULATE_BULK];
+	struct rte_mempool_objhdr *hdr;
+	unsigned int i, count = 0;
+	void *obj;
+
+	for (i = 0; i < n; i++) {
+		off += mp->header_size;
+		obj = vaddr + off;
+		mempool_init_elem(mp, obj);
+		hdr = RTE_PTR_SUB(obj, sizeof(*hdr));
+		STAILQ_INSERT_TAIL(list, hdr, next);
+		if (obj_cb != NULL)
+			obj_cb(mp, obj_cb_arg, obj, obj_idx + i);
+		off += mp->elt_size + mp->trailer_size;
+
+		objs[count++] = obj;
+		if (count == MEMPOOL_POPULATE_BULK) {
+			rte_mempool_ops_enqueue_bulk(mp, objs, count);
+			count = 0;
+		}
+	}
+
+	if (count != 0)
+		rte_mempool_ops_enqueue_bulk(mp, objs, count);
+}
 
-	/* enqueue in ring */
-	rte_mempool_ops_enqueue_bulk(mp, &obj, 1);
+/* offset of the first object in a memory chunk */
+static size_t
+mempool_memchunk_off(const struct rte_mempool *mp, const char *vaddr)
+{
+	if (mp->flags & MEMPOOL_F_NO_CACHE_ALIGN)
+		return RTE_PTR_ALIGN_CEIL(vaddr, 8) - vaddr;
+	else
+		return RTE_PTR_ALIGN_CEIL(vaddr, RTE_CACHE_LINE_SIZE) - vaddr;
+}
+
+/* number of objects stored in a memory chunk, at most max_objs */
+static unsigned int
+mempool_memchunk_nb_objs(const struct rte_mempool *mp, const char *vaddr,
+	size_t len, unsigned int max_objs)
+{
+	size_t total_elt_sz, off;
+
+	total_elt_sz = mp->header_size + mp->elt_size + mp->trailer_size;
+	off = mempool_memchunk_off(mp, vaddr);
+	if (off + total_elt_sz > len)
+		return 0;
+
+	return RTE_MIN((len - off) / total_elt_sz, (size_t)max_objs);
+}
+
+/* Register a memory chunk in the pool without initializing its objects.
+ * Return the number of objects it will hold (at most max_objs), or a
+ * negative value on error.
+ */
+static int
+mempool_add_memchunk(struct rte_mempool *mp, char *vaddr, size_t len,
+	rte_mempool_memchunk_free_cb_t *free_cb, void *opaque,
+	unsigned int max_objs)
+{
+	struct rte_mempool_memhdr *memhdr;
+	unsigned int n;
+
+	n = mempool_memchunk_nb_objs(mp, vaddr, len, max_objs);
+	/* not enough room to store one object */
+	if (n == 0)
+		return -EINVAL;
+
+	memhdr = rte_zmalloc("MEMPOOL_MEMHDR", sizeof(*memhdr), 0);
+	if (memhdr == NULL)
+		return -ENOMEM;
+
+	memhdr->mp = mp;
+	memhdr->addr = vaddr;
+	memhdr->len = len;
+	memhdr->free_cb = free_cb;
+	memhdr->opaque = opaque;
+
+	STAILQ_INSERT_TAIL(&mp->mem_list, memhdr, next);
+	mp->nb_mem_chunks++;
+	return n;
 }
 
 /* call obj_cb() for each mempool element */
@@ -271,11 +364,7 @@ rte_mempool_populate_phy(struct rte_mempool *mp, char *vaddr,
 	size_t len, rte_mempool_memchunk_free_cb_t *free_cb,
 	void *opaque)
 {
-	unsigned total_elt_sz;
-	unsigned int mp_capa_flags;
-	unsigned i = 0;
-	size_t off;
-	struct rte_mempool_memhdr *memhdr;
+	struct rte_mempool_objhdr_list list;
 	int ret;
 
 	/* create the internal ring if not already done */
@@ -290,72 +379,41 @@ rte_mempool_populate_phy(struct rte_mempool *mp, char *vaddr,
 	if (mp->populated_size >= mp->size)
 		return -ENOSPC;
 
-	total_elt_sz = mp->header_size + mp->elt_size + mp->trailer_size;
-
-	memhdr = rte_zmalloc("MEMPOOL_MEMHDR", sizeof(*memhdr), 0);
-	if (memhdr == NULL)
-		return -ENOMEM;
-
-	memhdr->mp = mp;
-	memhdr->addr = vaddr;
-	memhdr->len = len;
-	memhdr->free_cb = free_cb;
-	memhdr->opaque = opaque;
-
-	if (mp->flags & MEMPOOL_F_NO_CACHE_ALIGN)
-		off = RTE_PTR_ALIGN_CEIL(vaddr, 8) - vaddr;
-	else
-		off = RTE_PTR_ALIGN_CEIL(vaddr, RTE_CACHE_LINE_SIZE) - vaddr;
+	ret = mempool_add_memchunk(mp, vaddr, len, free_cb, opaque,
+		mp->size - mp->populated_size);
+	if (ret < 0)
+		return ret;
 
-	while (off + total_elt_sz <= len && mp->populated_size < mp->size) {
-		off += mp->header_size;
-		mempool_add_elem(mp, (char *)vaddr + off);
-		off += mp->elt_size + mp->trailer_size;
-		i++;
-	}
+	STAILQ_INIT(&list);
+	mempool_populate_objs(mp, vaddr, mempool_memchunk_off(mp, vaddr),
+		mp->populated_size, ret, NULL, NULL, &list);
+	STAILQ_CONCAT(&mp->elt_list, &list);
+	mp->populated_size += ret;
 
-	/* not enough room to store one object */
-	if (i == 0) {
-		ret = -EINVAL;
-		goto fail;
-	}
-
-	STAILQ_INSERT_TAIL(&mp->mem_list, memhdr, next);
-	mp->nb_mem_chunks++;
-	return i;
-
-fail:
-	rte_free(memhdr);
 	return ret;
 }
 
-/* Default function to populate the mempool: allocate memory in memzones,
- * and populate them. Return the number of objects added, or a negative
- * value on error.
+/* Reserve memzones for all the objects of a mempool, and add them as
+ * memory chunks. The objects are initialized and enqueued along with the
+ * chunks if populate is set, else only the chunks are added. Return 0, or
+ * a negative value on error, the chunks already added being freed.
  */
-int
-rte_mempool_populate_default(struct rte_mempool *mp)
+static int
+mempool_reserve_memzones(struct rte_mempool *mp, int populate)
 {
 	unsigned int mz_flags = RTE_MEMZONE_1GB|RTE_MEMZONE_SIZE_HINT_ONLY;
 	char mz_name[RTE_MEMZONE_NAMESIZE];
 	const struct rte_memzone *mz;
-	size_t size, total_elt_sz, align, pg_sz, pg_shift;
+	size_t size, total_elt_sz, align, pg_shift;
 	unsigned mz_id, n;
-	unsigned int mp_flags;
 	int ret;
 
-	/* mempool must not be populated */
-	if (mp->nb_mem_chunks != 0)
-		return -EEXIST;
-
 	if (rte_eal_has_hugepages()) {
 		pg_shift = 0; /* not needed, zone is physically contiguous */
-		pg_sz = 0;
 		align = RTE_CACHE_LINE_SIZE;
 	} else {
-		pg_sz = getpagesize();
-		pg_shift = rte_bsf32(pg_sz);
-		align = pg_sz;
+		pg_shift = rte_bsf32(getpagesize());
+		align = getpagesize();
 	}
 
 	total_elt_sz = mp->header_size + mp->elt_size + mp->trailer_size;
@@ -381,23 +439,157 @@ rte_mempool_populate_default(struct rte_mempool *mp)
 			goto fail;
 		}
 
-		ret = rte_mempool_populate_phy(mp, mz->addr,
-			mz->len, rte_mempool_memchunk_mz_free,
-			(void *)(uintptr_t)mz);
-
+		if (populate)
+			ret = rte_mempool_populate_phy(mp, mz->addr,
+				mz->len, rte_mempool_memchunk_mz_free,
+				(void *)(uintptr_t)mz);
+		else
+			ret = mempool_add_memchunk(mp, mz->addr, mz->len,
+				rte_mempool_memchunk_mz_free,
+				(void *)(uintptr_t)mz, n);
 		if (ret < 0) {
 			rte_memzone_free(mz);
 			goto fail;
 		}
 	}
 
-	return mp->size;
+	return 0;
 
  fail:
 	rte_mempool_free_memchunks(mp);
 	return ret;
 }
 
+/* Default function to populate the mempool: allocate memory in memzones,
+ * and populate them. Return the number of objects added, or a negative
+ * value on error.
+ */
+int
+rte_mempool_populate_default(struct rte_mempool *mp)
+{
+	int ret;
+
+	/* mempool must not be populated */
+	if (mp->nb_mem_chunks != 0)
+		return -EEXIST;
+
+	ret = mempool_reserve_memzones(mp, 1);
+	if (ret < 0)
+		return ret;
+
+	return mp->size;
+}
+
+/* maximum number of ranges of objects initialized in parallel */
+#define MEMPOOL_POPULATE_RANGES 256
+
+/* work shared by the lcores when populating a mempool in parallel */
+struct mempool_populate_arg {
+	struct rte_mempool *mp;
+	uint64_t grain;		/**< Number of objects of a range. */
+	rte_mempool_obj_cb_t *obj_init;
+	void *obj_init_arg;
+	/** Objects initialized, for each range. */
+	struct rte_mempool_objhdr_list elt_list[MEMPOOL_POPULATE_RANGES];
+};
+
+/* Initialize objects [first, end) of a pool whose memory chunks are all
+ * registered. Called by rte_parallel_for() on the lcores taking part to
+ * the population.
+ */
+static void
+mempool_populate_range(uint64_t first, uint64_t end, void *arg)
+{
+	struct mempool_populate_arg *pa = arg;
+	struct rte_mempool *mp = pa->mp;
+	struct rte_mempool_objhdr_list *list = &pa->elt_list[first / pa->grain];
+	struct rte_mempool_memhdr *memhdr;
+	unsigned int obj_idx = 0, start, n;
+	size_t total_elt_sz, off;
+
+	total_elt_sz = mp->header_size + mp->elt_size + mp->trailer_size;
+
+	STAILQ_FOREACH(memhdr, &mp->mem_list, next) {
+		if (obj_idx >= end)
+			break;
+
+		n = mempool_memchunk_nb_objs(mp, memhdr->addr, memhdr->len,
+			mp->size - obj_idx);
+		if (obj_idx + n > first) {
+			start = RTE_MAX(obj_idx, (unsigned int)first);
+			off = mempool_memchunk_off(mp, memhdr->addr) +
+				(size_t)(start - obj_idx) * total_elt_sz;
+			mempool_populate_objs(mp, memhdr->addr, off, start,
+				RTE_MIN(obj_idx + n, (unsigned int)end) - start,
+				pa->obj_init, pa->obj_init_arg, list);
+		}
+		obj_idx += n;
+	}
+}
+
+/* Same as rte_mempool_populate_default() followed by a call to obj_init()
+ * on each object, but the objects are initialized and enqueued by the
+ * idle slave lcores along with the calling master lcore, using
+ * rte_parallel_for(). Return the number of objects added, or a negative
+ * value on error.
+ */
+int
+rte_mempool_populate_parallel(struct rte_mempool *mp,
+	rte_mempool_obj_cb_t *obj_init, void *obj_init_arg)
+{
+	struct mempool_populate_arg pa;
+	unsigned int i, nb_ranges;
+	int ret;
+
+	/* mempool must not be populated */
+	if (mp->nb_mem_chunks != 0)
+		return -EEXIST;
+
+	/* create the internal ring if not already done */
+	if ((mp->flags & MEMPOOL_F_POOL_CREATED) == 0) {
+		ret = rte_mempool_ops_alloc(mp);
+		if (ret != 0)
+			return ret;
+		mp->flags |= MEMPOOL_F_POOL_CREATED;
+	}
+
+	/* reserve all the memory first, objects are initialized afterwards */
+	ret = mempool_reserve_memzones(mp, 0);
+	if (ret < 0)
+		return ret;
+
+	pa.mp = mp;
+	pa.grain = (mp->size + MEMPOOL_POPULATE_RANGES - 1) /
+		MEMPOOL_POPULATE_RANGES;
+	pa.obj_init = obj_init;
+	pa.obj_init_arg = obj_init_arg;
+	nb_ranges = (mp->size + pa.grain - 1) / pa.grain;
+	for (i = 0; i < nb_ranges; i++)
+		STAILQ_INIT(&pa.elt_list[i]);
+
+	/* concurrent enqueues require a multi-producer handler */
+	if (mp->flags & MEMPOOL_F_SP_PUT) {
+		for (i = 0; i < nb_ranges; i++)
+			mempool_populate_range(i * pa.grain,
+				RTE_MIN((i + 1) * pa.grain, (uint64_t)mp->size),
+				&pa);
+	} else {
+		ret = rte_parallel_for(0, mp->size, pa.grain,
+			mempool_populate_range, &pa);
+		if (ret < 0) {
+			rte_mempool_free_memchunks(mp);
+			return ret;
+		}
+	}
+
+	/* keep the object list in the same order as a serial population */
+	for (i = 0; i < nb_ranges; i++)
+		STAILQ_CONCAT(&mp->elt_list, &pa.elt_list[i]);
+	mp->populated_size = mp->size;
+
+	return mp->size;
+}
+
 /* free a mempool */
 void
 rte_mempool_free(struct rte_mempool *mp)
@@ -409,18 +601,22 @@ rte_mempool_free(struct rte_mempool *mp)
 		return;
 
 	mempool_list = RTE_TAILQ_CAST(rte_mempool_tailq.head, rte_mempool_list);
-	rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK);
+	rte_mcfg_tailq_write_lock(rte_eal_get_configuration()->mem_config);
 	/* find out tailq entry */
 	TAILQ_FOREACH(te, mempool_list, next) {
 		if (te->data == (void *)mp)
 			break;
 	}
 
-	if (te != NULL) {
+	if (te != NULL)
 		TAILQ_REMOVE(mempool_list, te, next);
+	rte_mcfg_tailq_write_unlock(rte_eal_get_configuration()->mem_config);
+
+	/* lock-free lookups may still read the entry and the mempool name */
+	if (te != NULL) {
+		rte_mcfg_qsbr_synchronize();
 		rte_free(te);
 	}
-	rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
 
 	rte_mempool_free_memchunks(mp);
 	rte_mempool_ops_free(mp);
@@ -483,7 +679,7 @@ rte_mempool_create_empty(const char *name, unsigned n, unsigned elt_size,
 		return NULL;
 	}
 
-	rte_rwlock_write_lock(RTE_EAL_MEMPOOL_RWLOCK);
+	rte_mcfg_mempool_write_lock(rte_eal_get_configuration()->mem_config);
 
 	/*
 	 * reserve a memory zone for this mempool: private data is
@@ -551,15 +747,17 @@ rte_mempool_create_empty(const char *name, unsigned n, unsigned elt_size,
 
 	te->data = mp;
 
-	rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK);
+	rte_mcfg_tailq_write_lock(rte_eal_get_configuration()->mem_config);
+	/* publish the entry to the lock-free lookups once filled */
+	rte_smp_wmb();
 	TAILQ_INSERT_TAIL(mempool_list, te, next);
-	rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
-	rte_rwlock_write_unlock(RTE_EAL_MEMPOOL_RWLOCK);
+	rte_mcfg_tailq_write_unlock(rte_eal_get_configuration()->mem_config);
+	rte_mcfg_mempool_write_unlock(rte_eal_get_configuration()->mem_config);
 
 	return mp;
 
 exit_unlock:
-	rte_rwlock_write_unlock(RTE_EAL_MEMPOOL_RWLOCK);
+	rte_mcfg_mempool_write_unlock(rte_eal_get_configuration()->mem_config);
 	rte_free(te);
 	rte_mempool_free(mp);
 	return NULL;
@@ -601,12 +799,21 @@ rte_mempool_create(const char *name, unsigned n, unsigned elt_size,
 	if (mp_init)
 		mp_init(mp, mp_init_arg);
 
-	if (rte_mempool_populate_default(mp) < 0)
-		goto fail;
+	if (flags & MEMPOOL_F_POPULATE_PARALLEL) {
+		/* populate and call the object initializers on all the idle
+		 * lcores of the pool socket
+		 */
+		if (rte_mempool_populate_parallel(mp, obj_init,
+				obj_init_arg) < 0)
+			goto fail;
+	} else {
+		if (rte_mempool_populate_default(mp) < 0)
+			goto fail;
 
-	/* call the object initializers */
-	if (obj_init)
-		rte_mempool_obj_iter(mp, obj_init, obj_init_arg);
+		/* call the object initializers */
+		if (obj_init)
+			rte_mempool_obj_iter(mp, obj_init, obj_init_arg);
+	}
 
 	return mp;
 
@@ -882,14 +1089,14 @@ rte_mempool_list_dump(FILE *f)
 
 	mempool_list = RTE_TAILQ_CAST(rte_mempool_tailq.head, rte_mempool_list);
 
-	rte_rwlock_read_lock(RTE_EAL_MEMPOOL_RWLOCK);
+	rte_mcfg_mempool_read_lock(rte_eal_get_configuration()->mem_config);
 
 	TAILQ_FOREACH(te, mempool_list, next) {
 		mp = (struct rte_mempool *) te->data;
 		rte_mempool_dump(f, mp);
 	}
 
-	rte_rwlock_read_unlock(RTE_EAL_MEMPOOL_RWLOCK);
+	rte_mcfg_mempool_read_unlock(rte_eal_get_configuration()->mem_config);
 }
 
 /* search a mempool from its name */
@@ -899,10 +1106,15 @@ rte_mempool_lookup(const char *name)
 	struct rte_mempool *mp = NULL;
 	struct rte_tailq_entry *te;
 	struct rte_mempool_list *mempool_list;
+	struct rte_mem_config *mcfg;
+	int locked;
 
 	mempool_list = RTE_TAILQ_CAST(rte_mempool_tailq.head, rte_mempool_list);
 
-	rte_rwlock_read_lock(RTE_EAL_MEMPOOL_RWLOCK);
+	mcfg = rte_eal_get_configuration()->mem_config;
+	locked = !rte_mcfg_qsbr_is_online();
+	if (locked)
+		rte_mcfg_mempool_read_lock_tm(mcfg);
 
 	TAILQ_FOREACH(te, mempool_list, next) {
 		mp = (struct rte_mempool *) te->data;
@@ -910,7 +1122,8 @@ rte_mempool_lookup(const char *name)
 			break;
 	}
 
-	rte_rwlock_read_unlock(RTE_EAL_MEMPOOL_RWLOCK);
+	if (locked)
+		rte_mcfg_mempool_read_unlock_tm(mcfg);
 
 	if (te == NULL) {
 		rte_errno = ENOENT;
@@ -929,11 +1142,11 @@ void rte_mempool_walk(void (*func)(struct rte_mempool *, void *),
 
 	mempool_list = RTE_TAILQ_CAST(rte_mempool_tailq.head, rte_mempool_list);
 
-	rte_rwlock_read_lock(RTE_EAL_MEMPOOL_RWLOCK);
+	rte_mcfg_mempool_read_lock(rte_eal_get_configuration()->mem_config);
 
 	TAILQ_FOREACH_SAFE(te, mempool_list, next, tmp_te) {
 		(*func)((struct rte_mempool *) te->data, arg);
 	}
 
-	rte_rwlock_read_unlock(RTE_EAL_MEMPOOL_RWLOCK);
+	rte_mcfg_mempool_read_unlock(rte_eal_get_configuration()->mem_config);
 }
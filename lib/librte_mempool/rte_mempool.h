@@ -47,9 +47,11 @@
 #include <rte_lcore.h>
 #include <rte_memory.h>
 #include <rte_branch_prediction.h>
+#include <rte_prefetch.h>
 #include <rte_ring.h>
 #include <rte_memcpy.h>
 #include <rte_common.h>
+#include <rte_malloc_prof.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -234,6 +236,8 @@ struct rte_mempool {
 #define MEMPOOL_F_SP_PUT         0x0004 /**< Default put is "single-producer".*/
 #define MEMPOOL_F_SC_GET         0x0008 /**< Default get is "single-consumer".*/
 #define MEMPOOL_F_POOL_CREATED   0x0010 /**< Internal: pool is created. */
+/** Populate and init the objects in parallel, see rte_mempool_create(). */
+#define MEMPOOL_F_POPULATE_PARALLEL 0x0020
 
 /**
  * @internal When debug is enabled, store some statistics.
@@ -624,6 +628,10 @@ typedef void (rte_mempool_ctor_t)(struct rte_mempool *, void *);
  *   - MEMPOOL_F_SC_GET: If this flag is set, the default behavior
  *     when using rte_mempool_get() or rte_mempool_get_bulk() is
  *     "single-consumer". Otherwise, it is "multi-consumers".
+ *   - MEMPOOL_F_POPULATE_PARALLEL: If this flag is set, the pool is
+ *     populated with rte_mempool_populate_parallel(), so obj_init() may
+ *     run on several slave lcores at the same time and must be
+ *     thread-safe. Otherwise, it is called from the calling thread only.
  * @return
  *   The pointer to the new allocated mempool, on success. NULL on error
  *   with rte_errno set appropriately. Possible rte_errno values include:
@@ -725,8 +733,8 @@ int rte_mempool_populate_phy(struct rte_mempool *mp, char *vaddr,
 /**
  * Add memory for objects in the pool at init
  *
- * This is the default function used by rte_mempool_create() to populate
- * the mempool. It adds memory allocated using rte_memzone_reserve().
+ * It adds memory allocated using rte_memzone_reserve(). The objects
+ * are initialized and enqueued by the calling thread.
  *
  * @param mp
  *   A pointer to the mempool structure.
@@ -737,6 +745,39 @@ int rte_mempool_populate_phy(struct rte_mempool *mp, char *vaddr,
  */
 int rte_mempool_populate_default(struct rte_mempool *mp);
 
+/**
+ * Add memory for objects in the pool at init, and initialize them in parallel
+ *
+ * This is the function used by rte_mempool_create() to populate the
+ * mempool when given MEMPOOL_F_POPULATE_PARALLEL, which is also meant to
+ * be called after rte_mempool_create_empty(). Like
+ * rte_mempool_populate_default(), it adds memory allocated
+ * using rte_memzone_reserve(), then the objects are split in contiguous
+ * ranges that are initialized with rte_parallel_for(), by the slave lcores
+ * in WAIT state and the calling lcore. Each lcore writes the headers of
+ * the objects of its ranges, calls obj_init() on them and enqueues them in
+ * the pool by bulks.
+ *
+ * The work is only spread when called from the master lcore on a mempool
+ * without the MEMPOOL_F_SP_PUT flag; otherwise everything is done by the
+ * calling thread. In all cases, obj_init() is called with the same object
+ * indexes as with rte_mempool_obj_iter(), but possibly from several lcores
+ * at the same time and before all objects are in the pool.
+ *
+ * @param mp
+ *   A pointer to the mempool structure.
+ * @param obj_init
+ *   A function called for each object at initialization, or NULL.
+ * @param obj_init_arg
+ *   An opaque pointer passed to obj_init().
+ * @return
+ *   The number of objects added on success.
+ *   On error, no memory chunk is added to the mempool and a negative
+ *   errno is returned.
+ */
+int rte_mempool_populate_parallel(struct rte_mempool *mp,
+	rte_mempool_obj_cb_t *obj_init, void *obj_init_arg);
+
 /**
  * Call a function for each mempool element
  *
@@ -897,6 +938,7 @@ rte_mempool_generic_put(struct rte_mempool *mp, void * const *obj_table,
 			unsigned int n, struct rte_mempool_cache *cache)
 {
 	__mempool_check_cookies(mp, obj_table, n, 0);
+	rte_malloc_prof_free_bulk(obj_table, n);
 	__mempool_generic_put(mp, obj_table, n, cache);
 }
 
@@ -1039,8 +1081,10 @@ rte_mempool_generic_get(struct rte_mempool *mp, void **obj_table,
 {
 	int ret;
 	ret = __mempool_generic_get(mp, obj_table, n, cache);
-	if (ret == 0)
+	if (ret == 0) {
 		__mempool_check_cookies(mp, obj_table, n, 1);
+		rte_malloc_prof_alloc_bulk(obj_table, n, mp->elt_size);
+	}
 	return ret;
 }
 
@@ -1100,6 +1144,49 @@ rte_mempool_get(struct rte_mempool *mp, void **obj_p)
 	return rte_mempool_get_bulk(mp, obj_p, 1);
 }
 
+/**
+ * Get several objects from the mempool, and prefetch the first ones for
+ * writing.
+ *
+ * The objects come first from the cache of the lcore, the last ones put
+ * being given first, but the ones refilled from the common pool are
+ * usually cold. Prefetching them with the intention to write saves a
+ * cache miss on the first write, e.g. the initialization of an object.
+ *
+ * Only the first lookahead objects are prefetched, so that the prefetches
+ * of a large bulk do not evict each other or stall on the outstanding
+ * misses. A caller using the objects in order should prefetch the object
+ * at i + lookahead while handling the one at i.
+ *
+ * @param mp
+ *   A pointer to the mempool structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to get from the mempool to obj_table.
+ * @param lookahead
+ *   The number of objects to prefetch, 0 for none.
+ * @return
+ *   - 0: Success; objects taken
+ *   - -ENOENT: Not enough entries in the mempool; no object is retrieved.
+ */
+static __rte_always_inline int
+rte_mempool_get_bulk_prefetch(struct rte_mempool *mp, void **obj_table,
+		unsigned int n, unsigned int lookahead)
+{
+	unsigned int i;
+	int ret;
+
+	ret = rte_mempool_get_bulk(mp, obj_table, n);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < RTE_MIN(n, lookahead); i++)
+		rte_prefetch0_write(obj_table[i]);
+
+	return 0;
+}
+
 /**
  * Return the number of entries in the mempool.
  *
@@ -1264,6 +1351,10 @@ size_t rte_mempool_xmem_size(uint32_t elt_num, size_t total_elt_sz,
 /**
  * Walk list of all memory pools
  *
+ * The mempools are read locked meanwhile, so the iterator function must
+ * not create nor free mempools. It may look up mempools, unless the lock
+ * is the writer-preferring one of RTE_MCFG_MEM_LOCK_WP.
+ *
  * @param func
  *   Iterator function
  * @param arg
@@ -0,0 +1,226 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_log.h>
+#include <rte_memzone.h>
+#include <rte_lcore.h>
+#include <rte_errno.h>
+
+#include "rte_mempool.h"
+#include "rte_mempool_numa.h"
+
+#define RTE_MEMPOOL_NUMA_MZ_FORMAT "MPN_%s"
+#define NODE_DISTANCE_PATH "/sys/devices/system/node/node%u/distance"
+
+/* Read the distances from a node to the other ones, as exported by the
+ * kernel. Return the number of distances read, 0 if not available.
+ */
+static unsigned int
+mempool_numa_read_distances(unsigned int node,
+	unsigned int distance[RTE_MAX_NUMA_NODES])
+{
+	char path[64];
+	unsigned int n = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), NODE_DISTANCE_PATH, node);
+	f = fopen(path, "r");
+	if (f == NULL)
+		return 0;
+
+	while (n < RTE_MAX_NUMA_NODES && fscanf(f, "%u", &distance[n]) == 1)
+		n++;
+
+	fclose(f);
+	return n;
+}
+
+/* Sort the nodes having a pool by increasing distance from each node.
+ * Without distance information, the local node comes first, then the
+ * others by increasing id.
+ */
+static void
+mempool_numa_set_order(struct rte_mempool_numa *mnp)
+{
+	unsigned int distance[RTE_MAX_NUMA_NODES];
+	unsigned int node, i, j, n, nb;
+	uint8_t tmp;
+
+	for (node = 0; node < RTE_MAX_NUMA_NODES; node++) {
+		n = mempool_numa_read_distances(node, distance);
+		/* no distance table: only the local node is close */
+		for (i = n; i < RTE_MAX_NUMA_NODES; i++)
+			distance[i] = (i == node) ? 0 : UINT32_MAX;
+		if (n <= node)
+			distance[node] = 0;
+
+		nb = 0;
+		for (i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+			if (mnp->pools[i] != NULL)
+				mnp->order[node][nb++] = i;
+		}
+
+		/* insertion sort, stable so that ties are kept by node id */
+		for (i = 1; i < nb; i++) {
+			tmp = mnp->order[node][i];
+			for (j = i; j > 0 &&
+					distance[mnp->order[node][j - 1]] >
+					distance[tmp]; j--)
+				mnp->order[node][j] = mnp->order[node][j - 1];
+			mnp->order[node][j] = tmp;
+		}
+	}
+}
+
+/* create the NUMA mempool */
+struct rte_mempool_numa *
+rte_mempool_numa_create(const char *name, unsigned int n,
+	unsigned int elt_size, unsigned int cache_size,
+	unsigned int private_data_size,
+	rte_mempool_ctor_t *mp_init, void *mp_init_arg,
+	rte_mempool_obj_cb_t *obj_init, void *obj_init_arg,
+	unsigned int flags)
+{
+	char mz_name[RTE_MEMZONE_NAMESIZE];
+	char mp_name[RTE_MEMPOOL_NAMESIZE];
+	const struct rte_memzone *mz;
+	struct rte_mempool_numa *mnp;
+	uint8_t has_lcore[RTE_MAX_NUMA_NODES] = { 0 };
+	unsigned int lcore_id, node;
+	int ret;
+
+	ret = snprintf(mz_name, sizeof(mz_name), RTE_MEMPOOL_NUMA_MZ_FORMAT,
+		name);
+	if (ret < 0 || ret >= (int)sizeof(mz_name)) {
+		rte_errno = ENAMETOOLONG;
+		return NULL;
+	}
+
+	RTE_LCORE_FOREACH(lcore_id) {
+		node = rte_lcore_to_socket_id(lcore_id);
+		if (node < RTE_MAX_NUMA_NODES)
+			has_lcore[node] = 1;
+	}
+
+	mz = rte_memzone_reserve(mz_name, sizeof(*mnp), SOCKET_ID_ANY, 0);
+	if (mz == NULL)
+		return NULL;
+
+	mnp = mz->addr;
+	memset(mnp, 0, sizeof(*mnp));
+	snprintf(mnp->name, sizeof(mnp->name), "%s", name);
+	mnp->mz = mz;
+
+	for (node = 0; node < RTE_MAX_NUMA_NODES; node++) {
+		if (!has_lcore[node])
+			continue;
+
+		ret = snprintf(mp_name, sizeof(mp_name), "%s_n%u", name, node);
+		if (ret < 0 || ret >= (int)sizeof(mp_name)) {
+			rte_errno = ENAMETOOLONG;
+			goto fail;
+		}
+
+		mnp->pools[node] = rte_mempool_create(mp_name, n, elt_size,
+			cache_size, private_data_size, mp_init, mp_init_arg,
+			obj_init, obj_init_arg, node, flags);
+		if (mnp->pools[node] == NULL) {
+			RTE_LOG(ERR, MEMPOOL,
+				"Cannot create mempool %s on node %u\n",
+				mp_name, node);
+			goto fail;
+		}
+		mnp->nb_nodes++;
+	}
+
+	if (mnp->nb_nodes == 0) {
+		rte_errno = ENODEV;
+		goto fail;
+	}
+
+	mempool_numa_set_order(mnp);
+
+	return mnp;
+
+fail:
+	rte_mempool_numa_free(mnp);
+	return NULL;
+}
+
+/* free the NUMA mempool and its sub-pools */
+void
+rte_mempool_numa_free(struct rte_mempool_numa *mnp)
+{
+	unsigned int node;
+
+	if (mnp == NULL)
+		return;
+
+	for (node = 0; node < RTE_MAX_NUMA_NODES; node++)
+		rte_mempool_free(mnp->pools[node]);
+
+	rte_memzone_free(mnp->mz);
+}
+
+/* sum the statistics of the lcores located on a node */
+int
+rte_mempool_numa_get_stats(const struct rte_mempool_numa *mnp,
+	unsigned int node, struct rte_mempool_numa_stats *stats)
+{
+	unsigned int lcore_id;
+
+	if (node >= RTE_MAX_NUMA_NODES)
+		return -EINVAL;
+
+	memset(stats, 0, sizeof(*stats));
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		if (rte_lcore_to_socket_id(lcore_id) != node)
+			continue;
+		stats->get_hit += mnp->stats[lcore_id].get_hit;
+		stats->get_miss += mnp->stats[lcore_id].get_miss;
+		stats->get_fail += mnp->stats[lcore_id].get_fail;
+		stats->put_remote += mnp->stats[lcore_id].put_remote;
+	}
+
+	return 0;
+}
+
+/* dump the status of the NUMA mempool on the console */
+void
+rte_mempool_numa_dump(FILE *f, const struct rte_mempool_numa *mnp)
+{
+	struct rte_mempool_numa_stats stats;
+	const struct rte_mempool *mp;
+	unsigned int node, i;
+
+	fprintf(f, "NUMA mempool <%s>@%p\n", mnp->name, mnp);
+	fprintf(f, "  nb_nodes=%u\n", mnp->nb_nodes);
+
+	for (node = 0; node < RTE_MAX_NUMA_NODES; node++) {
+		mp = mnp->pools[node];
+		if (mp == NULL)
+			continue;
+
+		rte_mempool_numa_get_stats(mnp, node, &stats);
+		fprintf(f, "  node %u: <%s>@%p\n", node, mp->name, mp);
+		fprintf(f, "    avail_count=%u\n", rte_mempool_avail_count(mp));
+		fprintf(f, "    fallback_order=");
+		for (i = 0; i < mnp->nb_nodes; i++)
+			fprintf(f, "%s%u", i == 0 ? "" : ",",
+				mnp->order[node][i]);
+		fprintf(f, "\n");
+		fprintf(f, "    get_hit=%"PRIu64"\n", stats.get_hit);
+		fprintf(f, "    get_miss=%"PRIu64"\n", stats.get_miss);
+		fprintf(f, "    get_fail=%"PRIu64"\n", stats.get_fail);
+		fprintf(f, "    put_remote=%"PRIu64"\n", stats.put_remote);
+	}
+}
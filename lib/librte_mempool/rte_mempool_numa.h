@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_MEMPOOL_NUMA_H_
+#define _RTE_MEMPOOL_NUMA_H_
+
+/**
+ * @file
+ * RTE NUMA-aware Mempool.
+ *
+ * A NUMA mempool is a set of regular mempools, one per NUMA node, sharing
+ * the same object size and name prefix. Each sub-pool has its own ring
+ * and memory chunks allocated on its node.
+ *
+ * Objects are taken from the pool of the node of the calling lcore first.
+ * If it is empty, the other nodes are tried by increasing distance, as
+ * reported by the kernel. Objects always go back to the pool they belong
+ * to (their home node), which is found from the object header. Objects
+ * taken from a remote node are therefore not migrated when freed.
+ *
+ * As for rte_mempool_get() and rte_mempool_put(), these functions are
+ * designed to be called from EAL threads. Per-node statistics are only
+ * updated for EAL threads.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_config.h>
+#include <rte_common.h>
+#include <rte_lcore.h>
+#include <rte_branch_prediction.h>
+
+#include "rte_mempool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Per-lcore statistics of a NUMA mempool.
+ */
+struct rte_mempool_numa_stats {
+	uint64_t get_hit;    /**< Objects got from the local node. */
+	uint64_t get_miss;   /**< Objects got from a remote node. */
+	uint64_t get_fail;   /**< Get requests that failed on all nodes. */
+	uint64_t put_remote; /**< Objects put back to a remote node. */
+} __rte_cache_aligned;
+
+/**
+ * The RTE NUMA mempool structure.
+ */
+struct rte_mempool_numa {
+	char name[RTE_MEMPOOL_NAMESIZE]; /**< Name of the NUMA mempool. */
+	const struct rte_memzone *mz;    /**< Memzone where it is allocated. */
+	unsigned int nb_nodes;           /**< Number of sub-pools. */
+	/** Sub-pool of each node, NULL if the node has no pool. */
+	struct rte_mempool *pools[RTE_MAX_NUMA_NODES];
+	/** For each node, the nodes to get objects from, closest first. */
+	uint8_t order[RTE_MAX_NUMA_NODES][RTE_MAX_NUMA_NODES];
+	/** Statistics of each lcore. */
+	struct rte_mempool_numa_stats stats[RTE_MAX_LCORE];
+} __rte_cache_aligned;
+
+/**
+ * Create a new NUMA mempool.
+ *
+ * One mempool of n objects is created with rte_mempool_create() on each
+ * NUMA node having at least one enabled lcore. The sub-pool of node i is
+ * named "<name>_n<i>". The other parameters are the same as for
+ * rte_mempool_create().
+ *
+ * @param name
+ *   The name of the NUMA mempool.
+ * @param n
+ *   The number of elements in each sub-pool.
+ * @param elt_size
+ *   The size of each element.
+ * @param cache_size
+ *   The size of the per-lcore cache of each sub-pool.
+ * @param private_data_size
+ *   The size of the private data appended after each sub-pool structure.
+ * @param mp_init
+ *   A function called to initialize each sub-pool, or NULL.
+ * @param mp_init_arg
+ *   An opaque pointer passed to mp_init().
+ * @param obj_init
+ *   A function called for each object at initialization, or NULL.
+ * @param obj_init_arg
+ *   An opaque pointer passed to obj_init().
+ * @param flags
+ *   The mempool flags, see rte_mempool_create().
+ * @return
+ *   The pointer to the new allocated NUMA mempool, on success. NULL on
+ *   error with rte_errno set appropriately.
+ */
+struct rte_mempool_numa *
+rte_mempool_numa_create(const char *name, unsigned int n,
+	unsigned int elt_size, unsigned int cache_size,
+	unsigned int private_data_size,
+	rte_mempool_ctor_t *mp_init, void *mp_init_arg,
+	rte_mempool_obj_cb_t *obj_init, void *obj_init_arg,
+	unsigned int flags);
+
+/**
+ * Free a NUMA mempool and all its sub-pools.
+ *
+ * @param mnp
+ *   A pointer to the NUMA mempool. If NULL then, the function does nothing.
+ */
+void rte_mempool_numa_free(struct rte_mempool_numa *mnp);
+
+/**
+ * Get several objects from a NUMA mempool.
+ *
+ * The objects are taken from a single sub-pool: the one of the node of
+ * the calling lcore if possible, else the closest one having enough
+ * objects.
+ *
+ * @param mnp
+ *   A pointer to the NUMA mempool.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to get from the pool.
+ * @return
+ *   - 0: Success; objects taken.
+ *   - -ENOENT: Not enough entries in any sub-pool; no object is retrieved.
+ */
+static __rte_always_inline int
+rte_mempool_numa_get_bulk(struct rte_mempool_numa *mnp, void **obj_table,
+	unsigned int n)
+{
+	unsigned int lcore_id = rte_lcore_id();
+	unsigned int node = rte_socket_id();
+	struct rte_mempool *mp;
+	unsigned int i;
+
+	if (unlikely(node >= RTE_MAX_NUMA_NODES))
+		node = 0;
+
+	for (i = 0; i < mnp->nb_nodes; i++) {
+		mp = mnp->pools[mnp->order[node][i]];
+		if (rte_mempool_get_bulk(mp, obj_table, n) < 0)
+			continue;
+		if (lcore_id < RTE_MAX_LCORE) {
+			/* the closest pool may be remote, if node has none */
+			if (mnp->order[node][i] == node)
+				mnp->stats[lcore_id].get_hit += n;
+			else
+				mnp->stats[lcore_id].get_miss += n;
+		}
+		return 0;
+	}
+
+	if (lcore_id < RTE_MAX_LCORE)
+		mnp->stats[lcore_id].get_fail++;
+	return -ENOENT;
+}
+
+/**
+ * Get one object from a NUMA mempool.
+ *
+ * @param mnp
+ *   A pointer to the NUMA mempool.
+ * @param obj_p
+ *   A pointer to a void * pointer (object) that will be filled.
+ * @return
+ *   - 0: Success; object taken.
+ *   - -ENOENT: No object available in any sub-pool.
+ */
+static __rte_always_inline int
+rte_mempool_numa_get(struct rte_mempool_numa *mnp, void **obj_p)
+{
+	return rte_mempool_numa_get_bulk(mnp, obj_p, 1);
+}
+
+/**
+ * Put several objects back in a NUMA mempool.
+ *
+ * Each object is returned to the sub-pool of its home node. Consecutive
+ * objects of the same node are put with a single bulk operation.
+ *
+ * @param mnp
+ *   A pointer to the NUMA mempool.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to add in the mempool from obj_table.
+ */
+static __rte_always_inline void
+rte_mempool_numa_put_bulk(struct rte_mempool_numa *mnp,
+	void * const *obj_table, unsigned int n)
+{
+	unsigned int lcore_id = rte_lcore_id();
+	int node = (int)rte_socket_id();
+	struct rte_mempool *mp;
+	unsigned int i, first;
+
+	for (first = 0; first < n; first = i) {
+		mp = rte_mempool_from_obj(obj_table[first]);
+		for (i = first + 1; i < n; i++) {
+			if (rte_mempool_from_obj(obj_table[i]) != mp)
+				break;
+		}
+		rte_mempool_put_bulk(mp, &obj_table[first], i - first);
+		if (mp->socket_id != node && lcore_id < RTE_MAX_LCORE)
+			mnp->stats[lcore_id].put_remote += i - first;
+	}
+}
+
+/**
+ * Put one object back in a NUMA mempool.
+ *
+ * @param mnp
+ *   A pointer to the NUMA mempool.
+ * @param obj
+ *   A pointer to the object to be added.
+ */
+static __rte_always_inline void
+rte_mempool_numa_put(struct rte_mempool_numa *mnp, void *obj)
+{
+	rte_mempool_numa_put_bulk(mnp, &obj, 1);
+}
+
+/**
+ * Get the statistics of one node of a NUMA mempool.
+ *
+ * The counters of all the lcores located on the node are summed. Hits
+ * and misses count the objects got by these lcores from their own node
+ * and from a remote node respectively.
+ *
+ * @param mnp
+ *   A pointer to the NUMA mempool.
+ * @param node
+ *   The NUMA node.
+ * @param stats
+ *   A pointer to the structure filled with the statistics.
+ * @return
+ *   0 on success, -EINVAL if the node is out of range.
+ */
+int rte_mempool_numa_get_stats(const struct rte_mempool_numa *mnp,
+	unsigned int node, struct rte_mempool_numa_stats *stats);
+
+/**
+ * Dump the status and the per-node statistics of a NUMA mempool.
+ *
+ * @param f
+ *   A pointer to a file for output
+ * @param mnp
+ *   A pointer to the NUMA mempool.
+ */
+void rte_mempool_numa_dump(FILE *f, const struct rte_mempool_numa *mnp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_MEMPOOL_NUMA_H_ */
@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_spinlock.h>
+#include <rte_ring.h>
+
+#include "rte_rcu_qsbr_dq.h"
+
+#define RTE_RCU_QSBR_DQ_RING_FORMAT "RCU_DQ_%s"
+
+/*
+ * A pending resource takes two consecutive ring entries, its token and
+ * itself, always enqueued and dequeued together.
+ */
+#define DQ_ENTRY_SLOTS 2
+
+struct rte_rcu_qsbr_dq {
+	struct rte_rcu_qsbr *v;
+	struct rte_ring *r;
+	uint32_t size;
+	uint32_t trigger_reclaim_limit;
+	uint32_t max_reclaim_size;
+	rte_rcu_qsbr_free_resource_t free_fn;
+	void *p;
+	/* serializes the reclaims, which use the ring as single consumer */
+	rte_spinlock_t lock;
+	/* dequeued resource whose grace period was not over, if any */
+	void *held[DQ_ENTRY_SLOTS];
+	int has_held;
+};
+
+struct rte_rcu_qsbr_dq *
+rte_rcu_qsbr_dq_create(const struct rte_rcu_qsbr_dq_parameters *params)
+{
+	char ring_name[RTE_RING_NAMESIZE];
+	struct rte_rcu_qsbr_dq *dq;
+	int ret;
+
+	if (params == NULL || params->name == NULL || params->v == NULL ||
+			params->free_fn == NULL || params->size == 0 ||
+			params->size > (RTE_RING_SZ_MASK >> 1)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	ret = snprintf(ring_name, sizeof(ring_name),
+			RTE_RCU_QSBR_DQ_RING_FORMAT, params->name);
+	if (ret < 0 || ret >= (int)sizeof(ring_name)) {
+		rte_errno = ENAMETOOLONG;
+		return NULL;
+	}
+
+	dq = rte_zmalloc(ring_name, sizeof(*dq), RTE_CACHE_LINE_SIZE);
+	if (dq == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+
+	dq->r = rte_ring_create(ring_name, params->size * DQ_ENTRY_SLOTS,
+			params->socket_id, RING_F_SC_DEQ | RING_F_EXACT_SZ);
+	if (dq->r == NULL) {
+		rte_free(dq);
+		return NULL;
+	}
+
+	dq->v = params->v;
+	dq->size = params->size;
+	dq->trigger_reclaim_limit = params->trigger_reclaim_limit;
+	if (dq->trigger_reclaim_limit == 0)
+		dq->trigger_reclaim_limit = params->size;
+	dq->max_reclaim_size = params->max_reclaim_size;
+	if (dq->max_reclaim_size == 0)
+		dq->max_reclaim_size = params->size;
+	dq->free_fn = params->free_fn;
+	dq->p = params->p;
+	rte_spinlock_init(&dq->lock);
+
+	return dq;
+}
+
+/* number of resources waiting for their grace period */
+static unsigned int
+dq_pending(const struct rte_rcu_qsbr_dq *dq)
+{
+	return rte_ring_count(dq->r) / DQ_ENTRY_SLOTS + dq->has_held;
+}
+
+int
+rte_rcu_qsbr_dq_enqueue(struct rte_rcu_qsbr_dq *dq, void *e)
+{
+	void *entry[DQ_ENTRY_SLOTS];
+	uint64_t token;
+
+	if (dq_pending(dq) >= dq->trigger_reclaim_limit)
+		rte_rcu_qsbr_dq_reclaim(dq, dq->max_reclaim_size, NULL, NULL);
+
+	/* the resource was removed before the grace period starts */
+	token = rte_rcu_qsbr_start(dq->v);
+	entry[0] = (void *)(uintptr_t)token;
+	entry[1] = e;
+
+	if (rte_ring_mp_enqueue_bulk(dq->r, entry, DQ_ENTRY_SLOTS,
+			NULL) == 0)
+		return -ENOSPC;
+
+	return 0;
+}
+
+/* reclaim up to n resources, with the lock held */
+static unsigned int
+dq_reclaim_locked(struct rte_rcu_qsbr_dq *dq, unsigned int n, bool wait)
+{
+	unsigned int freed = 0;
+
+	while (freed < n) {
+		if (!dq->has_held) {
+			if (rte_ring_sc_dequeue_bulk(dq->r, dq->held,
+					DQ_ENTRY_SLOTS, NULL) == 0)
+				break;
+			dq->has_held = 1;
+		}
+
+		if (!rte_rcu_qsbr_check(dq->v,
+				(uint64_t)(uintptr_t)dq->held[0], wait))
+			break;
+
+		dq->free_fn(dq->p, dq->held[1]);
+		dq->has_held = 0;
+		freed++;
+	}
+
+	return freed;
+}
+
+int
+rte_rcu_qsbr_dq_reclaim(struct rte_rcu_qsbr_dq *dq, unsigned int n,
+		unsigned int *freed, unsigned int *pending)
+{
+	unsigned int cnt;
+
+	if (!rte_spinlock_trylock(&dq->lock))
+		return -EBUSY;
+
+	cnt = dq_reclaim_locked(dq, n, false);
+	if (freed != NULL)
+		*freed = cnt;
+	if (pending != NULL)
+		*pending = dq_pending(dq);
+
+	rte_spinlock_unlock(&dq->lock);
+
+	return 0;
+}
+
+int
+rte_rcu_qsbr_dq_delete(struct rte_rcu_qsbr_dq *dq)
+{
+	if (dq == NULL)
+		return 0;
+
+	if (!rte_spinlock_trylock(&dq->lock))
+		return -EBUSY;
+
+	dq_reclaim_locked(dq, UINT32_MAX, true);
+
+	rte_ring_free(dq->r);
+	rte_free(dq);
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_RCU_QSBR_DQ_H_
+#define _RTE_RCU_QSBR_DQ_H_
+
+/**
+ * @file
+ * RTE QSBR Defer Queue.
+ *
+ * A defer queue holds the resources removed from the data shared with the
+ * readers of a QSBR variable, until the grace period started at their
+ * removal is over. They are then given back to a free function. This
+ * saves the writers waiting for the readers with
+ * rte_rcu_qsbr_synchronize().
+ *
+ * The resources are pointers, queued in a ring along with the token of
+ * their grace period. Any thread can enqueue; the resources are reclaimed
+ * in order of removal, by one thread at a time.
+ */
+
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_rcu_qsbr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Function freeing a resource once no reader can reference it.
+ *
+ * @param p
+ *   The opaque argument given at the creation of the defer queue.
+ * @param e
+ *   The resource to free.
+ */
+typedef void (*rte_rcu_qsbr_free_resource_t)(void *p, void *e);
+
+/**
+ * Parameters of a defer queue.
+ */
+struct rte_rcu_qsbr_dq_parameters {
+	const char *name;      /**< name of the defer queue and of its ring */
+	int socket_id;         /**< socket of the ring */
+	uint32_t size;         /**< maximum number of pending resources */
+	/** resources reclaimed on enqueue when more are pending, 0 for size */
+	uint32_t trigger_reclaim_limit;
+	/** maximum number of resources reclaimed on enqueue */
+	uint32_t max_reclaim_size;
+	struct rte_rcu_qsbr *v; /**< QSBR variable of the readers */
+	rte_rcu_qsbr_free_resource_t free_fn; /**< function freeing resources */
+	void *p;               /**< argument of free_fn */
+};
+
+/** Opaque defer queue. */
+struct rte_rcu_qsbr_dq;
+
+/**
+ * Create a defer queue.
+ *
+ * @param params
+ *   The parameters of the defer queue.
+ * @return
+ *   The defer queue, or NULL on error, with rte_errno set to:
+ *    - EINVAL - invalid parameters
+ *    - ENOMEM - no memory for the defer queue
+ *    - EEXIST - a ring with the same name exists
+ */
+struct rte_rcu_qsbr_dq *
+rte_rcu_qsbr_dq_create(const struct rte_rcu_qsbr_dq_parameters *params);
+
+/**
+ * Enqueue a resource removed from the shared data, starting its grace
+ * period. If many resources are pending, the ones whose grace period is
+ * over are reclaimed first.
+ *
+ * @param dq
+ *   The defer queue.
+ * @param e
+ *   The resource.
+ * @return
+ *   0 on success, -ENOSPC if the defer queue is full, the resource is
+ *   then still owned by the caller.
+ */
+int rte_rcu_qsbr_dq_enqueue(struct rte_rcu_qsbr_dq *dq, void *e);
+
+/**
+ * Free the resources whose grace period is over, without waiting.
+ *
+ * @param dq
+ *   The defer queue.
+ * @param n
+ *   The maximum number of resources to free.
+ * @param freed
+ *   If not NULL, set to the number of resources freed.
+ * @param pending
+ *   If not NULL, set to the number of resources still pending.
+ * @return
+ *   0 on success, -EBUSY if another thread is reclaiming.
+ */
+int rte_rcu_qsbr_dq_reclaim(struct rte_rcu_qsbr_dq *dq, unsigned int n,
+		unsigned int *freed, unsigned int *pending);
+
+/**
+ * Wait for the grace period of all the pending resources, free them, and
+ * free the defer queue.
+ *
+ * @param dq
+ *   The defer queue, may be NULL.
+ * @return
+ *   0 on success, -EBUSY if another thread is reclaiming.
+ */
+int rte_rcu_qsbr_dq_delete(struct rte_rcu_qsbr_dq *dq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_RCU_QSBR_DQ_H_ */
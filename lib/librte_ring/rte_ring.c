@@ -147,7 +147,7 @@ rte_ring_create(const char *name, unsigned count, int socket_id,
 		return NULL;
 	}
 
-	rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK);
+	rte_mcfg_tailq_write_lock(rte_eal_get_configuration()->mem_config);
 
 	/* reserve a memory zone for this ring. If we can't get rte_config or
 	 * we are secondary process, the memzone_reserve function will set
@@ -163,13 +163,15 @@ rte_ring_create(const char *name, unsigned count, int socket_id,
 		te->data = (void *) r;
 		r->memzone = mz;
 
+		/* publish the entry to the lock-free lookups once filled */
+		rte_smp_wmb();
 		TAILQ_INSERT_TAIL(ring_list, te, next);
 	} else {
 		r = NULL;
 		RTE_LOG(ERR, RING, "Cannot reserve memory\n");
 		rte_free(te);
 	}
-	rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
+	rte_mcfg_tailq_write_unlock(rte_eal_get_configuration()->mem_config);
 
 	return r;
 }
@@ -193,13 +195,8 @@ rte_ring_free(struct rte_ring *r)
 		return;
 	}
 
-	if (rte_memzone_free(r->memzone) != 0) {
-		RTE_LOG(ERR, RING, "Cannot free memory\n");
-		return;
-	}
-
 	ring_list = RTE_TAILQ_CAST(rte_ring_tailq.head, rte_ring_list);
-	rte_rwlock_write_lock(RTE_EAL_TAILQ_RWLOCK);
+	rte_mcfg_tailq_write_lock(rte_eal_get_configuration()->mem_config);
 
 	/* find out tailq entry */
 	TAILQ_FOREACH(te, ring_list, next) {
@@ -207,14 +204,17 @@ rte_ring_free(struct rte_ring *r)
 			break;
 	}
 
-	if (te == NULL) {
-		rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
-		return;
-	}
+	if (te != NULL)
+		TAILQ_REMOVE(ring_list, te, next);
 
-	TAILQ_REMOVE(ring_list, te, next);
+	rte_mcfg_tailq_write_unlock(rte_eal_get_configuration()->mem_config);
 
-	rte_rwlock_write_unlock(RTE_EAL_TAILQ_RWLOCK);
+	/* lock-free lookups may still read the entry and the ring name */
+	if (te != NULL)
+		rte_mcfg_qsbr_synchronize();
+
+	if (rte_memzone_free(r->memzone) != 0)
+		RTE_LOG(ERR, RING, "Cannot free memory\n");
 
 	rte_free(te);
 }
@@ -244,13 +244,13 @@ rte_ring_list_dump(FILE *f)
 
 	ring_list = RTE_TAILQ_CAST(rte_ring_tailq.head, rte_ring_list);
 
-	rte_rwlock_read_lock(RTE_EAL_TAILQ_RWLOCK);
+	rte_mcfg_tailq_read_lock(rte_eal_get_configuration()->mem_config);
 
 	TAILQ_FOREACH(te, ring_list, next) {
 		rte_ring_dump(f, (struct rte_ring *) te->data);
 	}
 
-	rte_rwlock_read_unlock(RTE_EAL_TAILQ_RWLOCK);
+	rte_mcfg_tailq_read_unlock(rte_eal_get_configuration()->mem_config);
 }
 
 /* search a ring from its name */
@@ -260,10 +260,15 @@ rte_ring_lookup(const char *name)
 	struct rte_tailq_entry *te;
 	struct rte_ring *r = NULL;
 	struct rte_ring_list *ring_list;
+	struct rte_mem_config *mcfg;
+	int locked;
 
 	ring_list = RTE_TAILQ_CAST(rte_ring_tailq.head, rte_ring_list);
 
-	rte_rwlock_read_lock(RTE_EAL_TAILQ_RWLOCK);
+	mcfg = rte_eal_get_configuration()->mem_config;
+	locked = !rte_mcfg_qsbr_is_online();
+	if (locked)
+		rte_mcfg_tailq_read_lock_tm(mcfg);
 
 	TAILQ_FOREACH(te, ring_list, next) {
 		r = (struct rte_ring *) te->data;
@@ -271,7 +276,8 @@ rte_ring_lookup(const char *name)
 			break;
 	}
 
-	rte_rwlock_read_unlock(RTE_EAL_TAILQ_RWLOCK);
+	if (locked)
+		rte_mcfg_tailq_read_unlock_tm(mcfg);
 
 	if (te == NULL) {
 		rte_errno = ENOENT;
@@ -47,6 +47,7 @@ extern "C" {
 #include <rte_branch_prediction.h>
 #include <rte_memzone.h>
 #include <rte_pause.h>
+#include <rte_prefetch.h>
 
 #define RTE_TAILQ_RING_NAME "RTE_RING"
 
@@ -941,6 +942,42 @@ rte_ring_dequeue_burst(struct rte_ring *r, void **obj_table,
 				r->cons.single, available);
 }
 
+/**
+ * Dequeue up to n objects from a ring, and prefetch the first ones.
+ *
+ * The objects are usually written by the producer on another lcore, so
+ * their first read misses the cache of the consumer. Only the first
+ * lookahead objects are prefetched; a consumer handling the objects in
+ * order should prefetch the object at i + lookahead while handling the
+ * one at i.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to dequeue from the ring to the obj_table.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @param lookahead
+ *   The number of objects to prefetch, 0 for none.
+ * @return
+ *   - Number of objects dequeued
+ */
+static __rte_always_inline unsigned
+rte_ring_dequeue_burst_prefetch(struct rte_ring *r, void **obj_table,
+		unsigned int n, unsigned int *available, unsigned int lookahead)
+{
+	unsigned int i, nb;
+
+	nb = rte_ring_dequeue_burst(r, obj_table, n, available);
+	for (i = 0; i < RTE_MIN(nb, lookahead); i++)
+		rte_prefetch0(obj_table[i]);
+
+	return nb;
+}
+
 #ifdef __cplusplus
 }
 #endif
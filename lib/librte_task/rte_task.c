@@ -0,0 +1,482 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_memory.h>
+#include <rte_malloc.h>
+#include <rte_lcore.h>
+#include <rte_pause.h>
+#include <rte_branch_prediction.h>
+#include <rte_ring.h>
+#include <rte_mempool.h>
+
+#include "rte_task.h"
+
+#define RTE_TASK_NAME_FORMAT "TASK_%s"
+
+/* size of the per-lcore caches of the task pool */
+#define TASK_POOL_CACHE_SIZE 32U
+
+/* slot of the non-EAL threads, which have no deque */
+#define TASK_SLOT_ANY RTE_MAX_LCORE
+
+struct task {
+	rte_task_fn_t fn;
+	void *arg;
+	struct rte_task_group *g;
+};
+
+/*
+ * Chase-Lev deque of fixed capacity: its lcore pushes and takes tasks at
+ * the bottom, the thieves take them at the top with a compare and swap,
+ * which also settles the race for the last task between the lcore and
+ * the thieves.
+ */
+struct task_deque {
+	int64_t top __rte_cache_aligned;
+	int64_t bottom __rte_cache_aligned;
+	int64_t mask;
+	struct task *buf[] __rte_cache_aligned;
+};
+
+struct task_lcore {
+	/* read by the thieves */
+	struct task_deque *dq;
+	/* lcores to steal from, the ones of the same socket first */
+	unsigned int nb_local;
+	unsigned int nb_victims;
+	uint16_t victims[RTE_MAX_LCORE];
+	/* written by the lcore, away from what the thieves read */
+	struct rte_task_stats stats __rte_cache_aligned;
+	/* local victim to steal from first, the last one which had tasks */
+	unsigned int next_victim;
+} __rte_cache_aligned;
+
+struct rte_task_sched {
+	char name[RTE_MEMPOOL_NAMESIZE];
+	struct rte_mempool *mp;
+	struct rte_ring *r;
+	uint32_t stop;
+	struct task_lcore lcore[RTE_MAX_LCORE + 1];
+};
+
+static inline void
+task_stat_add(struct rte_task_sched *s, struct task_lcore *lc,
+		uint64_t *counter, uint64_t n)
+{
+	/* only the slot of the non-EAL threads is shared */
+	if (unlikely(lc == &s->lcore[TASK_SLOT_ANY])) {
+		__atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* the lcore is the only writer, the readers need no locked RMW */
+	__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) +
+			n, __ATOMIC_RELAXED);
+}
+
+static int
+deque_push(struct task_deque *dq, struct task *t)
+{
+	int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+	int64_t top = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+
+	if (b - top > dq->mask)
+		return -ENOSPC;
+
+	__atomic_store_n(&dq->buf[b & dq->mask], t, __ATOMIC_RELAXED);
+	/* the task is written before thieves can see it */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+static struct task *
+deque_take(struct task_deque *dq)
+{
+	int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+	int64_t top;
+	struct task *t;
+
+	__atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+	/* reserve the bottom task before looking at the thieves */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+	if (top > b) {
+		/* empty */
+		__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	t = __atomic_load_n(&dq->buf[b & dq->mask], __ATOMIC_RELAXED);
+	if (top == b) {
+		/* last task, race with the thieves for it */
+		if (!__atomic_compare_exchange_n(&dq->top, &top, top + 1, 0,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			t = NULL;
+		__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+
+	return t;
+}
+
+static struct task *
+deque_steal(struct task_deque *dq)
+{
+	int64_t top = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+	int64_t b;
+	struct task *t;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+	if (top >= b)
+		return NULL;
+
+	t = __atomic_load_n(&dq->buf[top & dq->mask], __ATOMIC_RELAXED);
+	/* lost against the lcore or another thief */
+	if (!__atomic_compare_exchange_n(&dq->top, &top, top + 1, 0,
+			__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return NULL;
+
+	return t;
+}
+
+static inline unsigned int
+task_slot(void)
+{
+	unsigned int lcore_id = rte_lcore_id();
+
+	return lcore_id < RTE_MAX_LCORE ? lcore_id : TASK_SLOT_ANY;
+}
+
+/* steal a task, from the lcores of the same socket first */
+static struct task *
+task_steal(struct rte_task_sched *s, struct task_lcore *lc, int rotate)
+{
+	unsigned int i, idx;
+	struct task *t;
+
+	for (i = 0; i < lc->nb_local; i++) {
+		idx = rotate ? (lc->next_victim + i) % lc->nb_local : i;
+		t = deque_steal(s->lcore[lc->victims[idx]].dq);
+		if (t != NULL) {
+			if (rotate)
+				lc->next_victim = idx;
+			return t;
+		}
+	}
+
+	for (i = lc->nb_local; i < lc->nb_victims; i++) {
+		t = deque_steal(s->lcore[lc->victims[i]].dq);
+		if (t != NULL)
+			return t;
+	}
+
+	return NULL;
+}
+
+static void
+task_run(struct rte_task_sched *s, struct task_lcore *lc, struct task *t)
+{
+	struct rte_task_group *g = t->g;
+
+	t->fn(s, t->arg);
+	rte_mempool_put(s->mp, t);
+	task_stat_add(s, lc, &lc->stats.executed, 1);
+
+	/* the task is done before its group sees it */
+	__atomic_sub_fetch(&g->pending, 1, __ATOMIC_RELEASE);
+}
+
+/* run a pending task if any, return 0 if none was found */
+static int
+task_run_one(struct rte_task_sched *s, unsigned int slot)
+{
+	struct task_lcore *lc = &s->lcore[slot];
+	struct task *t = NULL;
+	void *obj;
+
+	if (lc->dq != NULL)
+		t = deque_take(lc->dq);
+
+	if (t == NULL && rte_ring_dequeue(s->r, &obj) == 0)
+		t = obj;
+
+	if (t == NULL) {
+		t = task_steal(s, lc, slot != TASK_SLOT_ANY);
+		if (t == NULL)
+			return 0;
+		task_stat_add(s, lc, &lc->stats.steals, 1);
+	}
+
+	task_run(s, lc, t);
+	return 1;
+}
+
+void
+rte_task_spawn(struct rte_task_sched *s, struct rte_task_group *g,
+		rte_task_fn_t fn, void *arg)
+{
+	struct task_lcore *lc = &s->lcore[task_slot()];
+	void *obj;
+	struct task *t;
+
+	if (unlikely(rte_mempool_get(s->mp, &obj) < 0)) {
+		task_stat_add(s, lc, &lc->stats.inlined, 1);
+		fn(s, arg);
+		return;
+	}
+
+	t = obj;
+	t->fn = fn;
+	t->arg = arg;
+	t->g = g;
+	__atomic_fetch_add(&g->pending, 1, __ATOMIC_RELAXED);
+
+	if ((lc->dq == NULL || deque_push(lc->dq, t) < 0) &&
+			rte_ring_enqueue(s->r, t) < 0) {
+		/* only a pool larger than the ring gets here */
+		task_stat_add(s, lc, &lc->stats.inlined, 1);
+		task_run(s, lc, t);
+		return;
+	}
+
+	task_stat_add(s, lc, &lc->stats.spawned, 1);
+}
+
+void
+rte_task_sync(struct rte_task_sched *s, struct rte_task_group *g)
+{
+	unsigned int slot = task_slot();
+	struct task_lcore *lc = &s->lcore[slot];
+
+	/* help with the pending tasks, the ones of the group among them */
+	while (__atomic_load_n(&g->pending, __ATOMIC_ACQUIRE) != 0) {
+		if (!task_run_one(s, slot)) {
+			task_stat_add(s, lc, &lc->stats.idle_spins, 1);
+			rte_pause();
+		}
+	}
+}
+
+int
+rte_task_sched_worker(void *arg)
+{
+	struct rte_task_sched *s = arg;
+	unsigned int slot = task_slot();
+	struct task_lcore *lc = &s->lcore[slot];
+
+	if (slot == TASK_SLOT_ANY || lc->dq == NULL)
+		return -EINVAL;
+
+	while (__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE) == 0) {
+		if (!task_run_one(s, slot)) {
+			task_stat_add(s, lc, &lc->stats.idle_spins, 1);
+			rte_pause();
+		}
+	}
+
+	return 0;
+}
+
+void
+rte_task_sched_stop(struct rte_task_sched *s)
+{
+	__atomic_store_n(&s->stop, 1, __ATOMIC_RELEASE);
+}
+
+/* order the lcores to steal from, the ones of the same socket first */
+static void
+task_victims_init(struct rte_task_sched *s, unsigned int slot)
+{
+	struct task_lcore *lc = &s->lcore[slot];
+	int socket_id = SOCKET_ID_ANY;
+	unsigned int lcore_id;
+
+	/* the non-EAL threads have no socket, all the lcores are remote */
+	if (slot != TASK_SLOT_ANY)
+		socket_id = rte_lcore_to_socket_id(slot);
+
+	lc->nb_victims = 0;
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		if (lcore_id == slot || s->lcore[lcore_id].dq == NULL)
+			continue;
+		if ((int)rte_lcore_to_socket_id(lcore_id) == socket_id)
+			lc->victims[lc->nb_victims++] = lcore_id;
+	}
+	lc->nb_local = lc->nb_victims;
+
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		if (lcore_id == slot || s->lcore[lcore_id].dq == NULL)
+			continue;
+		if ((int)rte_lcore_to_socket_id(lcore_id) != socket_id)
+			lc->victims[lc->nb_victims++] = lcore_id;
+	}
+}
+
+struct rte_task_sched *
+rte_task_sched_create(const struct rte_task_sched_params *params)
+{
+	char name[RTE_MEMPOOL_NAMESIZE];
+	struct rte_task_sched *s;
+	struct task_deque *dq;
+	unsigned int lcore_id;
+	int ret;
+
+	if (params == NULL || params->name == NULL || params->nb_tasks == 0 ||
+			params->nb_tasks > RTE_RING_SZ_MASK ||
+			!rte_is_power_of_2(params->deque_size)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	ret = snprintf(name, sizeof(name), RTE_TASK_NAME_FORMAT, params->name);
+	if (ret < 0 || ret >= (int)sizeof(name)) {
+		rte_errno = ENAMETOOLONG;
+		return NULL;
+	}
+
+	s = rte_zmalloc_socket(name, sizeof(*s), RTE_CACHE_LINE_SIZE,
+			params->socket_id);
+	if (s == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	snprintf(s->name, sizeof(s->name), "%s", name);
+
+	/* each deque on the socket of its lcore, which mostly uses it */
+	RTE_LCORE_FOREACH(lcore_id) {
+		dq = rte_zmalloc_socket(name, sizeof(*dq) +
+				params->deque_size * sizeof(dq->buf[0]),
+				RTE_CACHE_LINE_SIZE,
+				rte_lcore_to_socket_id(lcore_id));
+		if (dq == NULL) {
+			rte_errno = ENOMEM;
+			goto error;
+		}
+		dq->mask = params->deque_size - 1;
+		s->lcore[lcore_id].dq = dq;
+	}
+
+	for (lcore_id = 0; lcore_id <= TASK_SLOT_ANY; lcore_id++) {
+		if (lcore_id == TASK_SLOT_ANY || s->lcore[lcore_id].dq != NULL)
+			task_victims_init(s, lcore_id);
+	}
+
+	/* every task object fits in the ring, so enqueues cannot fail */
+	s->r = rte_ring_create(name, params->nb_tasks, params->socket_id,
+			RING_F_EXACT_SZ);
+	if (s->r == NULL)
+		goto error;
+
+	s->mp = rte_mempool_create(name, params->nb_tasks,
+			sizeof(struct task),
+			RTE_MIN(TASK_POOL_CACHE_SIZE, params->nb_tasks / 2), 0,
+			NULL, NULL, NULL, NULL, params->socket_id, 0);
+	if (s->mp == NULL)
+		goto error;
+
+	return s;
+
+error:
+	rte_task_sched_free(s);
+	return NULL;
+}
+
+void
+rte_task_sched_free(struct rte_task_sched *s)
+{
+	unsigned int lcore_id;
+
+	if (s == NULL)
+		return;
+
+	rte_mempool_free(s->mp);
+	rte_ring_free(s->r);
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++)
+		rte_free(s->lcore[lcore_id].dq);
+	rte_free(s);
+}
+
+void
+rte_task_sched_stats_get(const struct rte_task_sched *s,
+		struct rte_task_stats *stats)
+{
+	const struct rte_task_stats *c;
+	unsigned int slot;
+
+	memset(stats, 0, sizeof(*stats));
+	for (slot = 0; slot <= TASK_SLOT_ANY; slot++) {
+		c = &s->lcore[slot].stats;
+		stats->spawned += __atomic_load_n(&c->spawned,
+				__ATOMIC_RELAXED);
+		stats->inlined += __atomic_load_n(&c->inlined,
+				__ATOMIC_RELAXED);
+		stats->executed += __atomic_load_n(&c->executed,
+				__ATOMIC_RELAXED);
+		stats->steals += __atomic_load_n(&c->steals, __ATOMIC_RELAXED);
+		stats->idle_spins += __atomic_load_n(&c->idle_spins,
+				__ATOMIC_RELAXED);
+	}
+}
+
+void
+rte_task_sched_stats_reset(struct rte_task_sched *s)
+{
+	struct rte_task_stats *c;
+	unsigned int slot;
+
+	for (slot = 0; slot <= TASK_SLOT_ANY; slot++) {
+		c = &s->lcore[slot].stats;
+		__atomic_store_n(&c->spawned, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&c->inlined, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&c->executed, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&c->steals, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&c->idle_spins, 0, __ATOMIC_RELAXED);
+	}
+}
+
+static void
+task_stats_dump(FILE *f, const char *who, const struct rte_task_stats *c)
+{
+	fprintf(f, "  %-8s %14" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14"
+			PRIu64 " %16" PRIu64 "\n", who,
+			__atomic_load_n(&c->spawned, __ATOMIC_RELAXED),
+			__atomic_load_n(&c->inlined, __ATOMIC_RELAXED),
+			__atomic_load_n(&c->executed, __ATOMIC_RELAXED),
+			__atomic_load_n(&c->steals, __ATOMIC_RELAXED),
+			__atomic_load_n(&c->idle_spins, __ATOMIC_RELAXED));
+}
+
+void
+rte_task_sched_dump(FILE *f, const struct rte_task_sched *s)
+{
+	struct rte_task_stats total;
+	char who[16];
+	unsigned int lcore_id;
+
+	fprintf(f, "Task scheduler <%s>@%p\n", s->name, s);
+	fprintf(f, "  %-8s %14s %14s %14s %14s %16s\n", "lcore", "spawned",
+			"inlined", "executed", "steals", "idle_spins");
+
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		if (s->lcore[lcore_id].dq == NULL)
+			continue;
+		snprintf(who, sizeof(who), "%u", lcore_id);
+		task_stats_dump(f, who, &s->lcore[lcore_id].stats);
+	}
+	task_stats_dump(f, "non-EAL", &s->lcore[TASK_SLOT_ANY].stats);
+
+	rte_task_sched_stats_get(s, &total);
+	task_stats_dump(f, "total", &total);
+}
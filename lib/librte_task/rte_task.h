@@ -0,0 +1,193 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#ifndef _RTE_TASK_H_
+#define _RTE_TASK_H_
+
+/**
+ * @file
+ * RTE Task Scheduler.
+ *
+ * A work-stealing scheduler running tasks, i.e. a function and its
+ * argument, on the EAL lcores. Tasks can spawn other tasks, and wait for
+ * them with a task group.
+ *
+ * Each lcore has a deque of tasks, allocated on its socket: the lcore
+ * pushes the tasks it spawns at the bottom of its deque and runs them back
+ * from the bottom, while the other lcores steal from the top. An idle
+ * lcore first tries to steal from the lcores of its own socket, then from
+ * the others. The tasks spawned by non-EAL threads, or by an lcore whose
+ * deque is full, go through a ring shared by all the lcores.
+ *
+ * The task objects come from a mempool of the scheduler, so spawning does
+ * not allocate memory. A task is run by the spawning thread itself when no
+ * object or queue entry is left.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque task scheduler. */
+struct rte_task_sched;
+
+/**
+ * Function run by a task.
+ *
+ * @param s
+ *   The scheduler running the task, on which it can spawn other tasks.
+ * @param arg
+ *   The argument given at the spawn of the task.
+ */
+typedef void (*rte_task_fn_t)(struct rte_task_sched *s, void *arg);
+
+/**
+ * Group of tasks, waited for with rte_task_sync(). It must be zeroed
+ * before its first use, e.g. with RTE_TASK_GROUP_INITIALIZER.
+ */
+struct rte_task_group {
+	uint32_t pending; /**< tasks spawned in the group and not done */
+};
+
+/** Initializer of a task group. */
+#define RTE_TASK_GROUP_INITIALIZER { 0 }
+
+/**
+ * Parameters of a task scheduler.
+ */
+struct rte_task_sched_params {
+	const char *name;       /**< name of the scheduler, its pool and ring */
+	int socket_id;          /**< socket of the pool and of the ring */
+	uint32_t nb_tasks;      /**< maximum number of pending tasks */
+	/** capacity of the deque of each lcore, a power of 2 */
+	uint32_t deque_size;
+};
+
+/**
+ * Counters of a task scheduler, summed over the lcores.
+ */
+struct rte_task_stats {
+	uint64_t spawned;    /**< tasks queued by rte_task_spawn() */
+	uint64_t inlined;    /**< tasks run at spawn, nothing being left */
+	uint64_t executed;   /**< queued tasks run */
+	uint64_t steals;     /**< tasks stolen from the deque of an lcore */
+	uint64_t idle_spins; /**< loops of an idle lcore finding no task */
+};
+
+/**
+ * Create a task scheduler, with a deque for each enabled lcore.
+ *
+ * @param params
+ *   The parameters of the scheduler.
+ * @return
+ *   The scheduler on success, NULL on error with rte_errno set:
+ *   - EINVAL: invalid parameters, deque_size not being a power of 2
+ *   - ENAMETOOLONG: the name is too long
+ *   - ENOMEM: not enough memory
+ *   - EEXIST: a pool or ring of the same name exists
+ */
+struct rte_task_sched *
+rte_task_sched_create(const struct rte_task_sched_params *params);
+
+/**
+ * Free a task scheduler. Its workers must have returned, and no task must
+ * be pending.
+ *
+ * @param s
+ *   The scheduler, NULL being ignored.
+ */
+void rte_task_sched_free(struct rte_task_sched *s);
+
+/**
+ * Run the tasks of a scheduler until rte_task_sched_stop() is called.
+ * It is meant to be launched on the slave lcores, with
+ * rte_eal_remote_launch() or rte_eal_mp_remote_launch().
+ *
+ * @param arg
+ *   The scheduler.
+ * @return
+ *   0, or -EINVAL when not called from an enabled lcore.
+ */
+int rte_task_sched_worker(void *arg);
+
+/**
+ * Make the workers of a scheduler return once their current task is done.
+ * The tasks still queued are not run, so all the task groups should be
+ * synced before.
+ *
+ * @param s
+ *   The scheduler.
+ */
+void rte_task_sched_stop(struct rte_task_sched *s);
+
+/**
+ * Spawn a task in a group. The task may run on any lcore, before
+ * rte_task_spawn() returns.
+ *
+ * @param s
+ *   The scheduler.
+ * @param g
+ *   The group of the task.
+ * @param fn
+ *   The function run by the task.
+ * @param arg
+ *   The argument given to fn.
+ */
+void rte_task_spawn(struct rte_task_sched *s, struct rte_task_group *g,
+		rte_task_fn_t fn, void *arg);
+
+/**
+ * Wait until all the tasks of a group are done, running the pending tasks
+ * of the scheduler meanwhile. The memory operations of the tasks are
+ * visible to the caller on return.
+ *
+ * @param s
+ *   The scheduler.
+ * @param g
+ *   The group to wait for.
+ */
+void rte_task_sync(struct rte_task_sched *s, struct rte_task_group *g);
+
+/**
+ * Get the counters of a scheduler. They are read while the lcores update
+ * them, so they are only consistent once the workers are stopped.
+ *
+ * @param s
+ *   The scheduler.
+ * @param stats
+ *   The counters, filled on return.
+ */
+void rte_task_sched_stats_get(const struct rte_task_sched *s,
+		struct rte_task_stats *stats);
+
+/**
+ * Reset the counters of a scheduler. The lcores update their counters
+ * without atomic operations, so the reset is only reliable once the
+ * workers are stopped.
+ *
+ * @param s
+ *   The scheduler.
+ */
+void rte_task_sched_stats_reset(struct rte_task_sched *s);
+
+/**
+ * Dump the counters of a scheduler, for each lcore.
+ *
+ * @param f
+ *   A pointer to a file for output.
+ * @param s
+ *   The scheduler.
+ */
+void rte_task_sched_dump(FILE *f, const struct rte_task_sched *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTE_TASK_H_ */
@@ -279,6 +279,15 @@ rte_config_init(void)
 {
 	rte_config.process_type = internal_config.process_type;
 
+	/*
+	 * physical addressing unless IOVA as VA was set in the internal
+	 * config, no EAL option selects it
+	 */
+	if (internal_config.iova_mode == RTE_IOVA_VA)
+		rte_config.iova_mode = RTE_IOVA_VA;
+	else
+		rte_config.iova_mode = RTE_IOVA_PA;
+
 	switch (rte_config.process_type){
 	case RTE_PROC_PRIMARY:
 		rte_eal_config_create();
@@ -558,6 +567,7 @@ int __rte_experimental
 rte_eal_cleanup(void)
 {
 	// rte_service_finalize();
+	rte_eal_memfd_server_stop();
 	return 0;
 }
 
@@ -574,6 +584,13 @@ rte_eal_process_type(void)
 	return rte_config.process_type;
 }
 
+/* Return the IOVA mode */
+enum rte_iova_mode
+rte_eal_iova_mode(void)
+{
+	return rte_eal_get_configuration()->iova_mode;
+}
+
 int rte_eal_has_hugepages(void)
 {
 	return ! internal_config.no_hugetlbfs;
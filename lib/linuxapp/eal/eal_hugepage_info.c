@@ -273,6 +273,17 @@ eal_hugepage_info_init(void)
 		hpi = &internal_config.hugepage_info[num_sizes];
 		hpi->hugepage_sz =
 			rte_str_to_size(&dirent->d_name[dirent_start_len]);
+
+		/* in-memory mode, the pages are backed by memfd: no
+		 * mountpoint is needed and there is no stale file to clear */
+		if (internal_config.in_memory) {
+			hpi->hugedir = NULL;
+			hpi->lock_descriptor = -1;
+			hpi->num_pages[0] = get_num_hugepages(dirent->d_name);
+			num_sizes++;
+			continue;
+		}
+
 		hpi->hugedir = get_hugepage_dir(hpi->hugepage_sz);
 
 		/* first, check if we have a mountpoint */
@@ -322,7 +333,8 @@ eal_hugepage_info_init(void)
 
 	/* now we have all info, check we have at least one valid size */
 	for (i = 0; i < num_sizes; i++)
-		if (internal_config.hugepage_info[i].hugedir != NULL &&
+		if ((internal_config.hugepage_info[i].hugedir != NULL ||
+		     internal_config.in_memory) &&
 		    internal_config.hugepage_info[i].num_pages[0] > 0)
 			return 0;
 
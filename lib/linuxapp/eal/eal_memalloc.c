@@ -0,0 +1,529 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2018 Intel Corporation
+ */
+
+#define _GNU_SOURCE /* fallocate() */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/types.h>
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+#include <rte_log.h>
+#include <rte_memory.h>
+#include <rte_eal.h>
+#include <rte_eal_memconfig.h>
+#include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_spinlock.h>
+
+#include "eal_private.h"
+#include "eal_internal_cfg.h"
+#include "eal_filesystem.h"
+#include "eal_hugepages.h"
+#include "eal_memalloc.h"
+
+/*
+ * Memory hotplug: memory segments added to the malloc heaps after init,
+ * when they run dry. Each segment is backed by a single file in hugetlbfs,
+ * or a single memfd in in-memory mode, so that secondary processes can map
+ * it in one go from the path stored in the shared memory config, or from
+ * the memfd passed by the memfd server of the primary process.
+ */
+
+/* String format of the backing file of a memseg added at runtime. */
+#define HOTPLUG_FILE_FMT "%s/%sseg_%u"
+/* String format of the memfd name of a memseg added at runtime. */
+#define HOTPLUG_MEMFD_FMT "%sseg_%u"
+
+#ifndef MAP_FIXED_NOREPLACE
+/* ignored by kernels older than 4.17, the address is then a hint */
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/* memfd of each memseg added at runtime, in the primary process */
+static int hotplug_fd[RTE_MAX_MEMSEG];
+
+/*
+ * Serialize the memsegs added and released by the primary process, which
+ * is the only one to change the table: the memseg_lock is only taken to
+ * publish a change, not while the pages are allocated or freed.
+ */
+static pthread_mutex_t hotplug_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* memsegs mapped by a secondary process, and the generation it has seen */
+static void *local_addr[RTE_MAX_MEMSEG];
+static size_t local_len[RTE_MAX_MEMSEG];
+static uint32_t local_seg_gen[RTE_MAX_MEMSEG];
+static uint32_t local_gen;
+static rte_spinlock_t local_lock = RTE_SPINLOCK_INITIALIZER;
+
+/* Reserve a virtual area, without backing memory */
+static void *
+hotplug_va_reserve(void *addr, size_t len, int flags)
+{
+	return mmap(addr, len, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | flags, -1, 0);
+}
+
+int
+eal_memalloc_init(void)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	size_t len = (size_t)RTE_MAX_HOTPLUG_MEM_MB << 20;
+	uint64_t align = 0;
+	void *addr, *start;
+	unsigned int i;
+
+	if (rte_eal_process_type() == RTE_PROC_SECONDARY) {
+		if (mcfg->hotplug_va_len == 0)
+			return 0;
+
+		start = (void *)(uintptr_t)mcfg->hotplug_va_addr;
+		addr = hotplug_va_reserve(start, mcfg->hotplug_va_len,
+				MAP_FIXED_NOREPLACE);
+		if (addr != start) {
+			if (addr != MAP_FAILED)
+				munmap(addr, mcfg->hotplug_va_len);
+			RTE_LOG(ERR, EAL, "Could not reserve the hotplug memory "
+				"area at %p, it is used by another mapping\n",
+				start);
+			return -1;
+		}
+		return 0;
+	}
+
+	if (!internal_config.memory_hotplug)
+		return 0;
+
+	/* align the area on the largest page size */
+	for (i = 0; i < internal_config.num_hugepage_sizes; i++)
+		align = RTE_MAX(align,
+			internal_config.hugepage_info[i].hugepage_sz);
+	if (align == 0)
+		align = RTE_PGSIZE_4K;
+
+	addr = hotplug_va_reserve(NULL, len + align, 0);
+	if (addr == MAP_FAILED) {
+		RTE_LOG(ERR, EAL, "Cannot reserve %zu bytes for the hotplug "
+			"memory: %s\n", len, strerror(errno));
+		return -1;
+	}
+	start = RTE_PTR_ALIGN_CEIL(addr, align);
+	if (start != addr)
+		munmap(addr, RTE_PTR_DIFF(start, addr));
+	munmap(RTE_PTR_ADD(start, len),
+		RTE_PTR_DIFF(RTE_PTR_ADD(addr, len + align),
+			RTE_PTR_ADD(start, len)));
+
+	mcfg->hotplug_va_addr = (uintptr_t)start;
+	mcfg->hotplug_va_len = len;
+
+	RTE_LOG(DEBUG, EAL, "Reserved %zu bytes at %p for hotplug memory\n",
+		len, start);
+	return 0;
+}
+
+/*
+ * Get the address of a new memseg in the reserved area: the memsegs added
+ * at runtime follow each other there, as only the last one is released.
+ */
+static void *
+hotplug_va_next(unsigned int idx, size_t len, uint64_t page_sz)
+{
+	const struct rte_mem_config *mcfg =
+		rte_eal_get_configuration()->mem_config;
+	uintptr_t addr = mcfg->hotplug_va_addr;
+	const struct rte_memseg *prev;
+
+	if (idx > 0 && mcfg->memseg_file[idx - 1].path[0] != '\0') {
+		prev = &mcfg->memseg[idx - 1];
+		addr = (uintptr_t)prev->addr + prev->len;
+	}
+	addr = RTE_ALIGN_CEIL(addr, page_sz);
+
+	if (addr + len > mcfg->hotplug_va_addr + mcfg->hotplug_va_len)
+		return NULL;
+	return (void *)addr;
+}
+
+/*
+ * Allocate the pages of a new segment in its file. In linux, hugetlb
+ * limitations, like cgroup, are enforced when a page is allocated:
+ * fallocate() reports a shortage as an error, where faulting the pages
+ * in would raise SIGBUS.
+ */
+static int
+hotplug_fallocate(int fd, size_t len, int socket_id)
+{
+	int ret, err;
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+	unsigned long nodemask = 1UL << socket_id, oldmask = 0;
+	int oldpolicy = MPOL_DEFAULT, bind = 0;
+
+	/* the pages follow the memory policy of the calling thread */
+	if (numa_available() == 0 && socket_id >= 0 &&
+			socket_id < (int)(sizeof(nodemask) * CHAR_BIT)) {
+		if (get_mempolicy(&oldpolicy, &oldmask,
+				sizeof(oldmask) * CHAR_BIT, NULL, 0) < 0 ||
+				set_mempolicy(MPOL_BIND, &nodemask,
+				sizeof(nodemask) * CHAR_BIT) < 0)
+			RTE_LOG(WARNING, EAL, "Cannot bind memory to "
+				"socket %d: %s\n", socket_id, strerror(errno));
+		else
+			bind = 1;
+	}
+#else
+	RTE_SET_USED(socket_id);
+#endif
+
+	ret = fallocate(fd, 0, 0, len);
+	err = errno;
+
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+	if (bind)
+		set_mempolicy(oldpolicy,
+			oldpolicy == MPOL_DEFAULT ? NULL : &oldmask,
+			oldpolicy == MPOL_DEFAULT ? 0 :
+			sizeof(oldmask) * CHAR_BIT);
+#endif
+
+	errno = err;
+	return ret;
+}
+
+/* Get the IOVA of a new segment, which must be physically contiguous */
+static rte_iova_t
+hotplug_iova(void *addr, size_t len, uint64_t page_sz)
+{
+	phys_addr_t first, pa;
+	size_t off;
+
+	if (rte_eal_iova_mode() == RTE_IOVA_VA || !rte_eal_using_phys_addrs())
+		return (uintptr_t)addr;
+
+	first = rte_mem_virt2phy(addr);
+	if (first == RTE_BAD_PHYS_ADDR)
+		return RTE_BAD_IOVA;
+
+	for (off = page_sz; off < len; off += page_sz) {
+		pa = rte_mem_virt2phy(RTE_PTR_ADD(addr, off));
+		if (pa != first + off)
+			return RTE_BAD_IOVA;
+	}
+
+	return first;
+}
+
+struct rte_memseg *
+eal_memalloc_alloc_seg(size_t len, uint64_t page_sz, int socket_id)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	const struct hugepage_info *hpi = NULL;
+	struct rte_memseg *ms = NULL;
+	char path[RTE_MEMSEG_FILE_LEN];
+	void *addr = MAP_FAILED, *va;
+	rte_iova_t iova;
+	unsigned int idx, i;
+	int fd = -1;
+
+	for (i = 0; i < internal_config.num_hugepage_sizes; i++)
+		if (internal_config.hugepage_info[i].hugepage_sz == page_sz)
+			hpi = &internal_config.hugepage_info[i];
+	if (hpi == NULL || (hpi->hugedir == NULL && !internal_config.in_memory))
+		return NULL;
+
+	pthread_mutex_lock(&hotplug_lock);
+
+	/* memsegs are used in order, the first empty one ends the table */
+	for (idx = 0; idx < RTE_MAX_MEMSEG; idx++)
+		if (mcfg->memseg[idx].len == 0)
+			break;
+	if (idx == RTE_MAX_MEMSEG) {
+		RTE_LOG(ERR, EAL, "Cannot add memseg: %s=%d is not enough\n",
+			RTE_STR(CONFIG_RTE_MAX_MEMSEG), RTE_MAX_MEMSEG);
+		goto out;
+	}
+
+	va = hotplug_va_next(idx, len, page_sz);
+	if (va == NULL) {
+		RTE_LOG(ERR, EAL, "Cannot add memseg: %s=%d is not enough\n",
+			RTE_STR(CONFIG_RTE_MAX_HOTPLUG_MEM_MB),
+			RTE_MAX_HOTPLUG_MEM_MB);
+		goto out;
+	}
+
+	if (internal_config.in_memory) {
+		snprintf(path, sizeof(path), HOTPLUG_MEMFD_FMT,
+			internal_config.hugefile_prefix, idx);
+		fd = eal_hugepage_memfd_create(path, page_sz, len);
+	} else {
+		snprintf(path, sizeof(path), HOTPLUG_FILE_FMT, hpi->hugedir,
+			internal_config.hugefile_prefix, idx);
+		fd = open(path, O_CREAT | O_RDWR, 0600);
+		if (fd >= 0 && ftruncate(fd, len) < 0) {
+			close(fd);
+			unlink(path);
+			fd = -1;
+		}
+	}
+	if (fd < 0) {
+		RTE_LOG(DEBUG, EAL, "%s(): cannot create %s: %s\n", __func__,
+			path, strerror(errno));
+		goto out;
+	}
+
+	if (hotplug_fallocate(fd, len, socket_id) < 0) {
+		RTE_LOG(DEBUG, EAL, "%s(): Cannot allocate %zu bytes of "
+			"%u MB hugepages: %s\n", __func__, len,
+			(unsigned int)(page_sz / 0x100000), strerror(errno));
+		goto fail;
+	}
+
+	/* the pages are allocated, mapping them in cannot fault */
+	addr = mmap(va, len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED | MAP_POPULATE, fd, 0);
+	if (addr == MAP_FAILED) {
+		RTE_LOG(DEBUG, EAL, "%s(): mmap failed: %s\n", __func__,
+			strerror(errno));
+		goto fail;
+	}
+
+	iova = hotplug_iova(addr, len, page_sz);
+	if (iova == RTE_BAD_IOVA) {
+		RTE_LOG(DEBUG, EAL, "%s(): %zu bytes at %p are not physically "
+			"contiguous\n", __func__, len, addr);
+		goto fail;
+	}
+
+	if (!internal_config.in_memory) {
+		/* the mapping keeps the file and its lock */
+		flock(fd, LOCK_SH | LOCK_NB);
+		close(fd);
+	}
+
+	rte_rwlock_write_lock(&mcfg->memseg_lock);
+	/* in-memory mode, the memfd name only marks the memseg */
+	snprintf(mcfg->memseg_file[idx].path, RTE_MEMSEG_FILE_LEN, "%s", path);
+	if (internal_config.in_memory)
+		hotplug_fd[idx] = fd;
+
+	ms = &mcfg->memseg[idx];
+	ms->iova = iova;
+	ms->addr = addr;
+	ms->hugepage_sz = page_sz;
+	ms->socket_id = socket_id;
+	ms->nchannel = mcfg->nchannel;
+	ms->nrank = mcfg->nrank;
+	/* a non-zero length makes the memseg visible */
+	rte_smp_wmb();
+	ms->len = len;
+	eal_mem_lookup_add(idx);
+	mcfg->memseg_file[idx].gen = ++mcfg->memseg_gen;
+	rte_rwlock_write_unlock(&mcfg->memseg_lock);
+
+	RTE_LOG(DEBUG, EAL, "Added memseg %u: %zu bytes at %p on socket %d\n",
+		idx, len, addr, socket_id);
+	goto out;
+
+fail:
+	/* give the range back to the reserved area */
+	hotplug_va_reserve(va, len, MAP_FIXED);
+	close(fd);
+	if (!internal_config.in_memory)
+		unlink(path);
+out:
+	pthread_mutex_unlock(&hotplug_lock);
+	return ms;
+}
+
+int
+eal_memalloc_free_seg(struct rte_memseg *ms)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	unsigned int idx = ms - mcfg->memseg;
+	char path[RTE_MEMSEG_FILE_LEN];
+	void *addr;
+	size_t len;
+	int ret = 0;
+
+	pthread_mutex_lock(&hotplug_lock);
+
+	if (idx >= RTE_MAX_MEMSEG || mcfg->memseg_file[idx].path[0] == '\0') {
+		ret = -EINVAL;
+		goto out;
+	}
+	/* keep the table without holes: only the last memseg can go */
+	if (idx + 1 < RTE_MAX_MEMSEG && mcfg->memseg[idx + 1].len != 0) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	RTE_LOG(DEBUG, EAL, "Releasing memseg %u: %zu bytes at %p\n",
+		idx, ms->len, ms->addr);
+
+	addr = ms->addr;
+	len = ms->len;
+	snprintf(path, sizeof(path), "%s", mcfg->memseg_file[idx].path);
+
+	rte_rwlock_write_lock(&mcfg->memseg_lock);
+	eal_mem_lookup_del(idx);
+	ms->len = 0;
+	rte_smp_wmb();
+	memset(ms, 0, sizeof(*ms));
+	mcfg->memseg_file[idx].path[0] = '\0';
+	mcfg->memseg_gen++;
+	rte_rwlock_write_unlock(&mcfg->memseg_lock);
+
+	hotplug_va_reserve(addr, len, MAP_FIXED);
+	if (internal_config.in_memory)
+		close(hotplug_fd[idx]);
+	else if (unlink(path) < 0)
+		RTE_LOG(WARNING, EAL, "%s(): Removing %s failed: %s\n",
+			__func__, path, strerror(errno));
+
+out:
+	pthread_mutex_unlock(&hotplug_lock);
+	return ret;
+}
+
+struct rte_memseg *
+eal_memalloc_last_seg(void)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	struct rte_memseg *ms = NULL;
+	unsigned int idx;
+
+	rte_rwlock_read_lock(&mcfg->memseg_lock);
+	for (idx = 0; idx < RTE_MAX_MEMSEG; idx++)
+		if (mcfg->memseg[idx].len == 0)
+			break;
+	if (idx > 0 && mcfg->memseg_file[idx - 1].path[0] != '\0')
+		ms = &mcfg->memseg[idx - 1];
+	rte_rwlock_read_unlock(&mcfg->memseg_lock);
+
+	return ms;
+}
+
+int
+eal_memalloc_is_hotplug(const struct rte_memseg *ms)
+{
+	const struct rte_mem_config *mcfg =
+		rte_eal_get_configuration()->mem_config;
+	unsigned int idx = ms - mcfg->memseg;
+
+	return idx < RTE_MAX_MEMSEG && mcfg->memseg_file[idx].path[0] != '\0';
+}
+
+int
+eal_memalloc_seg_fd(unsigned int idx, uint32_t gen)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	int fd = -1;
+
+	if (!internal_config.in_memory || idx >= RTE_MAX_MEMSEG)
+		return -1;
+
+	/* the memfd is closed after the memseg is unpublished */
+	rte_rwlock_read_lock(&mcfg->memseg_lock);
+	if (mcfg->memseg[idx].len != 0 &&
+			mcfg->memseg_file[idx].path[0] != '\0' &&
+			mcfg->memseg_file[idx].gen == gen)
+		fd = fcntl(hotplug_fd[idx], F_DUPFD_CLOEXEC, 0);
+	rte_rwlock_read_unlock(&mcfg->memseg_lock);
+
+	return fd;
+}
+
+int
+eal_memalloc_sync(void)
+{
+	struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	const struct rte_memseg *ms;
+	unsigned int idx;
+	uint32_t gen;
+	void *addr;
+	int fd, ret = 0;
+
+	if (mcfg->memseg_gen == local_gen)
+		return 0;
+
+	rte_spinlock_lock(&local_lock);
+	rte_rwlock_read_lock(&mcfg->memseg_lock);
+
+	gen = mcfg->memseg_gen;
+	for (idx = 0; idx < RTE_MAX_MEMSEG; idx++) {
+		int hotplug;
+
+		ms = &mcfg->memseg[idx];
+		hotplug = ms->len != 0 && mcfg->memseg_file[idx].path[0] != '\0';
+
+		/* segment released, or replaced by another one */
+		if (local_addr[idx] != NULL && (!hotplug ||
+				local_seg_gen[idx] != mcfg->memseg_file[idx].gen)) {
+			hotplug_va_reserve(local_addr[idx], local_len[idx],
+				MAP_FIXED);
+			local_addr[idx] = NULL;
+			local_len[idx] = 0;
+		}
+		if (!hotplug || local_addr[idx] != NULL)
+			continue;
+
+		/* the area is reserved, so the memseg is mapped over it */
+		if ((uintptr_t)ms->addr < mcfg->hotplug_va_addr ||
+				(uintptr_t)ms->addr + ms->len >
+				mcfg->hotplug_va_addr + mcfg->hotplug_va_len) {
+			RTE_LOG(ERR, EAL, "Memseg %u at %p is out of the "
+				"hotplug memory area\n", idx, ms->addr);
+			ret = -1;
+			continue;
+		}
+
+		/* a memfd can only be passed by the primary process, whose
+		 * server takes the memseg_lock as a reader too */
+		if (internal_config.in_memory)
+			fd = eal_memfd_request_seg(idx,
+				mcfg->memseg_file[idx].gen);
+		else
+			fd = open(mcfg->memseg_file[idx].path, O_RDWR);
+		if (fd < 0) {
+			RTE_LOG(ERR, EAL, "Could not open %s\n",
+				mcfg->memseg_file[idx].path);
+			ret = -1;
+			continue;
+		}
+		addr = mmap(ms->addr, ms->len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED) {
+			RTE_LOG(ERR, EAL, "Could not map memseg %u at %p: %s\n",
+				idx, ms->addr, strerror(errno));
+			hotplug_va_reserve(ms->addr, ms->len, MAP_FIXED);
+			ret = -1;
+			continue;
+		}
+		local_addr[idx] = addr;
+		local_len[idx] = ms->len;
+		local_seg_gen[idx] = mcfg->memseg_file[idx].gen;
+	}
+	if (ret == 0)
+		local_gen = gen;
+
+	rte_rwlock_read_unlock(&mcfg->memseg_lock);
+	rte_spinlock_unlock(&local_lock);
+
+	return ret;
+}
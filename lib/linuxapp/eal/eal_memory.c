@@ -4,6 +4,9 @@
  */
 
 #define _FILE_OFFSET_BITS 64
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* struct ucred, fallocate() */
+#endif
 #include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -17,12 +20,17 @@
 #include <sys/stat.h>
 #include <sys/queue.h>
 #include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <linux/falloc.h>
 #include <unistd.h>
 #include <limits.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
 #include <signal.h>
 #include <setjmp.h>
+#include <pthread.h>
 #ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
 #include <numa.h>
 #include <numaif.h>
@@ -36,15 +44,37 @@
 #include <rte_per_lcore.h>
 #include <rte_lcore.h>
 #include <rte_common.h>
+#include <rte_atomic.h>
+#include <rte_pause.h>
 #include <rte_string_fns.h>
 
 #include "eal_private.h"
 #include "eal_internal_cfg.h"
 #include "eal_filesystem.h"
 #include "eal_hugepages.h"
+#include "eal_memalloc.h"
 
 #define PFN_MASK_SIZE	8
 
+/* memfd flags, not exported by older C libraries */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB	0x0004U
+#endif
+#ifndef MFD_HUGE_SHIFT
+#define MFD_HUGE_SHIFT	26
+#endif
+
+/* get_mempolicy flags, not exported without libnuma headers */
+#ifndef MPOL_F_NODE
+#define MPOL_F_NODE	(1 << 0)
+#endif
+#ifndef MPOL_F_ADDR
+#define MPOL_F_ADDR	(1 << 1)
+#endif
+
 /**
  * @file
  * Huge page mapping under linux
@@ -76,6 +106,14 @@ test_phys_addrs_available(void)
 		return;
 	}
 
+	/* IOVA are virtual addresses, don't parse /proc/self/pagemap */
+	if (rte_eal_iova_mode() == RTE_IOVA_VA) {
+		RTE_LOG(DEBUG, EAL,
+			"IOVA as VA mode, physical addresses not used\n");
+		phys_addrs_available = false;
+		return;
+	}
+
 	physaddr = rte_mem_virt2phy(&tmp);
 	if (physaddr == RTE_BAD_PHYS_ADDR) {
 		phys_addrs_available = false;
@@ -98,6 +136,14 @@ rte_mem_virt2phy(const void *virtaddr)
 	if (!phys_addrs_available)
 		return RTE_BAD_PHYS_ADDR;
 
+	/* memsegs are physically contiguous, no need to read pagemap */
+	if (rte_eal_iova_mode() == RTE_IOVA_PA) {
+		const struct rte_memseg *ms = rte_mem_virt2memseg(virtaddr);
+
+		if (ms != NULL)
+			return ms->phys_addr + RTE_PTR_DIFF(virtaddr, ms->addr);
+	}
+
 	/* standard page size */
 	page_size = getpagesize();
 
@@ -163,7 +209,8 @@ find_physaddrs(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi)
 }
 
 /*
- * For each hugepage in hugepg_tbl, fill the physaddr value sequentially.
+ * For each hugepage in hugepg_tbl, fill the physaddr value sequentially,
+ * or with the virtual address of the page in IOVA as VA mode.
  */
 static int
 set_physaddrs(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi)
@@ -171,6 +218,13 @@ set_physaddrs(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi)
 	unsigned int i;
 	static phys_addr_t addr;
 
+	if (rte_eal_iova_mode() == RTE_IOVA_VA) {
+		for (i = 0; i < hpi->num_pages[0]; i++)
+			hugepg_tbl[i].physaddr =
+				(uintptr_t)hugepg_tbl[i].orig_va;
+		return 0;
+	}
+
 	for (i = 0; i < hpi->num_pages[0]; i++) {
 		hugepg_tbl[i].physaddr = addr;
 		addr += hugepg_tbl[i].size;
@@ -284,11 +338,14 @@ get_virtual_area(size_t *size, size_t hugepage_sz)
 	return addr;
 }
 
-static sigjmp_buf huge_jmpenv;
+/* SIGBUS is raised in the thread doing the faulting access, so each
+ * thread mapping hugepages has its own jump environment.
+ */
+static RTE_DEFINE_PER_LCORE(sigjmp_buf, huge_jmpenv);
 
 static void huge_sigbus_handler(int signo __rte_unused)
 {
-	siglongjmp(huge_jmpenv, 1);
+	siglongjmp(RTE_PER_LCORE(huge_jmpenv), 1);
 }
 
 /* Put setjmp into a wrap method to avoid compiling error. Any non-volatile,
@@ -297,7 +354,7 @@ static void huge_sigbus_handler(int signo __rte_unused)
  */
 static int huge_wrap_sigsetjmp(void)
 {
-	return sigsetjmp(huge_jmpenv, 1);
+	return sigsetjmp(RTE_PER_LCORE(huge_jmpenv), 1);
 }
 
 #ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
@@ -308,6 +365,202 @@ void numa_error(char *where)
 }
 #endif
 
+/* memfd holding all the pages of a size, in-memory single file mode */
+static int single_memfd[MAX_HUGEPAGE_SIZES];
+
+/*
+ * Set up a hugepage table entry before it is mapped the first time. With
+ * single file segments, all the pages of a size are in the file of the
+ * first page, at an offset given by their id. The table must be set up
+ * from the first page.
+ */
+static void
+hugepage_file_init(struct hugepage_file *hf, struct hugepage_info *hpi,
+		int file_id)
+{
+	int name_id = file_id;
+
+	hf->file_id = file_id;
+	hf->size = hpi->hugepage_sz;
+	hf->fd = -1;
+	hf->file_offset = 0;
+
+	if (internal_config.single_file_segments) {
+		name_id = 0;
+		hf->file_offset = (uint64_t)file_id * hpi->hugepage_sz;
+	}
+
+	if (internal_config.in_memory)
+		eal_get_hugefile_memfd_name(hf->filepath,
+				sizeof(hf->filepath), name_id);
+	else
+		eal_get_hugefile_path(hf->filepath, sizeof(hf->filepath),
+				hpi->hugedir, name_id);
+
+	if (internal_config.in_memory && internal_config.single_file_segments) {
+		int *memfd = &single_memfd[hpi - internal_config.hugepage_info];
+
+		if (file_id == 0)
+			*memfd = eal_hugepage_memfd_create(hf->filepath,
+					hpi->hugepage_sz, (size_t)hpi->num_pages[0] *
+					hpi->hugepage_sz);
+		hf->fd = *memfd;
+	}
+}
+
+/* Create an anonymous hugetlb file of len bytes, return its fd or -1 */
+int
+eal_hugepage_memfd_create(const char *name, uint64_t hugepage_sz, size_t len)
+{
+#ifdef SYS_memfd_create
+	unsigned int flags = MFD_CLOEXEC | MFD_HUGETLB;
+	int fd;
+
+	/* the page size is encoded as its log2 */
+	flags |= (unsigned int)__builtin_ctzll(hugepage_sz) << MFD_HUGE_SHIFT;
+
+	fd = syscall(SYS_memfd_create, name, flags);
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, len) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+#else
+	RTE_SET_USED(name);
+	RTE_SET_USED(hugepage_sz);
+	RTE_SET_USED(len);
+	errno = ENOTSUP;
+	return -1;
+#endif
+}
+
+/*
+ * Free the memory of a page which is not mapped anymore: remove its file,
+ * or close its memfd, or punch a hole in the file shared with the other
+ * pages of the same size.
+ */
+static int
+hugepage_file_drop(struct hugepage_file *hf)
+{
+	int fd, ret;
+
+	if (internal_config.single_file_segments) {
+		fd = internal_config.in_memory ? hf->fd :
+			open(hf->filepath, O_RDWR);
+		if (fd < 0)
+			return -1;
+		ret = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				hf->file_offset, hf->size);
+		if (!internal_config.in_memory)
+			close(fd);
+		return ret;
+	}
+
+	if (internal_config.in_memory) {
+		close(hf->fd);
+		hf->fd = -1;
+		return 0;
+	}
+
+	return unlink(hf->filepath);
+}
+
+/* Close the file of a page which could not be mapped */
+static void
+hugepage_file_release(struct hugepage_file *hf, int fd)
+{
+	/* memfds are kept in hf->fd */
+	if (!internal_config.in_memory)
+		close(fd);
+	hugepage_file_drop(hf);
+}
+
+/*
+ * Open (or create) the backing file of a hugepage and mmap() it at addr,
+ * populating the page tables. addr is only a hint unless MAP_FIXED is
+ * given in flags. If touch is set, the page is written once under SIGBUS
+ * protection: in linux, hugetlb limitations, like cgroup, are enforced at
+ * fault time instead of mmap(), even with the option of MAP_POPULATE.
+ *
+ * In in-memory mode, the page is backed by a memfd which is created on
+ * the first call and kept open in hf->fd, so that it can be mapped again
+ * and passed to secondary processes. Return the mapped address, or NULL
+ * on error.
+ */
+static void *
+map_hugepage_file(struct hugepage_file *hf, uint64_t hugepage_sz, void *addr,
+		int flags, int touch)
+{
+	void *virtaddr;
+	int fd;
+
+	if (internal_config.in_memory) {
+		fd = hf->fd;
+		if (fd < 0 && !internal_config.single_file_segments)
+			fd = eal_hugepage_memfd_create(hf->filepath,
+					hugepage_sz, hugepage_sz);
+		if (fd < 0) {
+			RTE_LOG(DEBUG, EAL, "%s(): memfd_create failed: %s\n",
+					__func__, strerror(errno));
+			return NULL;
+		}
+		hf->fd = fd;
+	} else {
+		/* try to create hugepage file */
+		fd = open(hf->filepath, O_CREAT | O_RDWR, 0600);
+		if (fd < 0) {
+			RTE_LOG(DEBUG, EAL, "%s(): open failed: %s\n",
+					__func__, strerror(errno));
+			return NULL;
+		}
+	}
+
+	/* map the segment, and populate page tables,
+	 * the kernel fills this segment with zeros */
+	virtaddr = mmap(addr, hugepage_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE | flags, fd, hf->file_offset);
+	if (virtaddr == MAP_FAILED) {
+		RTE_LOG(DEBUG, EAL, "%s(): mmap failed: %s\n", __func__,
+				strerror(errno));
+		hugepage_file_release(hf, fd);
+		return NULL;
+	}
+
+	if (touch) {
+		/* To avoid to be killed by SIGBUS, save stack environment
+		 * here, if SIGBUS happens, we can jump back here.
+		 */
+		if (huge_wrap_sigsetjmp()) {
+			RTE_LOG(DEBUG, EAL, "SIGBUS: Cannot mmap more "
+				"hugepages of size %u MB\n",
+				(unsigned)(hugepage_sz / 0x100000));
+			munmap(virtaddr, hugepage_sz);
+			hugepage_file_release(hf, fd);
+			return NULL;
+		}
+		*(int *)virtaddr = 0;
+	}
+
+	/* no other process can open a memfd by name, keep it open */
+	if (internal_config.in_memory)
+		return virtaddr;
+
+	/* set shared flock on the file. */
+	if (flock(fd, LOCK_SH | LOCK_NB) == -1) {
+		RTE_LOG(DEBUG, EAL, "%s(): Locking file failed:%s \n",
+			__func__, strerror(errno));
+		munmap(virtaddr, hugepage_sz);
+		close(fd);
+		return NULL;
+	}
+
+	close(fd);
+	return virtaddr;
+}
+
 /*
  * Mmap all hugepages of hugepage table: it first open a file in
  * hugetlbfs, then mmap() hugepage_sz data in it. If orig is set, the
@@ -319,7 +572,6 @@ static unsigned
 map_all_hugepages(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi,
 		  uint64_t *essential_memory __rte_unused, int orig)
 {
-	int fd;
 	unsigned i;
 	void *virtaddr;
 	void *vma_addr = NULL;
@@ -388,14 +640,8 @@ map_all_hugepages(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi,
 		}
 #endif
 
-		if (orig) {
-			hugepg_tbl[i].file_id = i;
-			hugepg_tbl[i].size = hugepage_sz;
-			eal_get_hugefile_path(hugepg_tbl[i].filepath,
-					sizeof(hugepg_tbl[i].filepath), hpi->hugedir,
-					hugepg_tbl[i].file_id);
-			hugepg_tbl[i].filepath[sizeof(hugepg_tbl[i].filepath) - 1] = '\0';
-		}
+		if (orig)
+			hugepage_file_init(&hugepg_tbl[i], hpi, i);
 		else if (vma_len == 0) {
 			unsigned j, num_pages;
 
@@ -418,67 +664,20 @@ map_all_hugepages(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi,
 				vma_len = hugepage_sz;
 		}
 
-		/* try to create hugepage file */
-		fd = open(hugepg_tbl[i].filepath, O_CREAT | O_RDWR, 0600);
-		if (fd < 0) {
-			RTE_LOG(DEBUG, EAL, "%s(): open failed: %s\n", __func__,
-					strerror(errno));
-			goto out;
-		}
-
-		/* map the segment, and populate page tables,
-		 * the kernel fills this segment with zeros */
-		virtaddr = mmap(vma_addr, hugepage_sz, PROT_READ | PROT_WRITE,
-				MAP_SHARED | MAP_POPULATE, fd, 0);
-		if (virtaddr == MAP_FAILED) {
-			RTE_LOG(DEBUG, EAL, "%s(): mmap failed: %s\n", __func__,
-					strerror(errno));
-			close(fd);
-			goto out;
-		}
-
-		if (orig) {
-			hugepg_tbl[i].orig_va = virtaddr;
-		}
-		else {
-			hugepg_tbl[i].final_va = virtaddr;
-		}
-
-		if (orig) {
-			/* In linux, hugetlb limitations, like cgroup, are
-			 * enforced at fault time instead of mmap(), even
-			 * with the option of MAP_POPULATE. Kernel will send
-			 * a SIGBUS signal. To avoid to be killed, save stack
-			 * environment here, if SIGBUS happens, we can jump
-			 * back here.
-			 */
-			if (huge_wrap_sigsetjmp()) {
-				RTE_LOG(DEBUG, EAL, "SIGBUS: Cannot mmap more "
-					"hugepages of size %u MB\n",
-					(unsigned)(hugepage_sz / 0x100000));
-				munmap(virtaddr, hugepage_sz);
-				close(fd);
-				unlink(hugepg_tbl[i].filepath);
+		virtaddr = map_hugepage_file(&hugepg_tbl[i],
+				hugepage_sz, vma_addr, 0, orig);
+		if (virtaddr == NULL) {
 #ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
-				if (maxnode)
-					essential_memory[node_id] =
-						essential_prev;
+			if (orig && maxnode)
+				essential_memory[node_id] = essential_prev;
 #endif
-				goto out;
-			}
-			*(int *)virtaddr = 0;
-		}
-
-
-		/* set shared flock on the file. */
-		if (flock(fd, LOCK_SH | LOCK_NB) == -1) {
-			RTE_LOG(DEBUG, EAL, "%s(): Locking file failed:%s \n",
-				__func__, strerror(errno));
-			close(fd);
 			goto out;
 		}
 
-		close(fd);
+		if (orig)
+			hugepg_tbl[i].orig_va = virtaddr;
+		else
+			hugepg_tbl[i].final_va = virtaddr;
 
 		vma_addr = (char *)vma_addr + hugepage_sz;
 		vma_len -= hugepage_sz;
@@ -503,6 +702,255 @@ out:
 	return i;
 }
 
+/* maximum number of helper threads mapping hugepages at init */
+#define MAX_HUGEPAGE_MAP_THREADS 64
+
+/* Share of the hugepage table mapped by one helper thread */
+struct hugepage_map_job {
+	struct hugepage_file *hugepg_tbl; /**< first page of the share */
+	unsigned int num_pages;     /**< number of pages in the share */
+	unsigned int num_essential; /**< leading pages of essential memory */
+	unsigned int num_mapped;    /**< number of pages actually mapped */
+	uint64_t hugepage_sz;       /**< size of the pages */
+	char *va;                   /**< fixed address of first page, or NULL */
+	int node_id;                /**< NUMA node to use, or -1 */
+	int bind;                   /**< true if running in a helper thread */
+	pthread_t thread;
+};
+
+/*
+ * Map the pages of a job, stopping at the first failure. The pages are
+ * faulted in, hence zeroed by the kernel, from the calling thread, which
+ * runs on the job NUMA node when it is a helper thread.
+ */
+static void *
+hugepage_map_thread(void *arg)
+{
+	struct hugepage_map_job *job = arg;
+	unsigned int i;
+	void *addr;
+
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+	if (job->bind && job->node_id >= 0) {
+		if (numa_run_on_node(job->node_id) < 0)
+			RTE_LOG(DEBUG, EAL, "Cannot run on node %d: %s\n",
+				job->node_id, strerror(errno));
+		numa_set_preferred(job->node_id);
+	}
+#endif
+
+	for (i = 0; i < job->num_pages; i++) {
+		addr = map_hugepage_file(&job->hugepg_tbl[i],
+				job->hugepage_sz,
+				job->va != NULL ?
+					job->va + i * job->hugepage_sz : NULL,
+				job->va != NULL ? MAP_FIXED : 0, 1);
+		if (addr == NULL)
+			break;
+		job->hugepg_tbl[i].orig_va = addr;
+	}
+	job->num_mapped = i;
+
+	return NULL;
+}
+
+/* number of CPUs helper threads can use on a node, -1 for any node */
+static unsigned int
+hugepage_map_node_cpus(int node_id __rte_unused)
+{
+	long n = 0;
+
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+	if (node_id >= 0) {
+		struct bitmask *cpus = numa_allocate_cpumask();
+
+		if (numa_node_to_cpus(node_id, cpus) == 0)
+			n = numa_bitmask_weight(cpus);
+		numa_free_cpumask(cpus);
+		return n > 0 ? n : 1;
+	}
+#endif
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+}
+
+/*
+ * Parallel version of the first map_all_hugepages() pass. The pages are
+ * split by NUMA node as map_all_hugepages() would do, and the share of
+ * each node is split again between helper threads bound to the node.
+ * Without NUMA information, the pages are split between unbound threads.
+ *
+ * If *contig is set, the pages are mapped in a single virtual area,
+ * each node share being contiguous, so that the remapping pass can be
+ * skipped. *contig is cleared if no such area can be reserved.
+ *
+ * The mapped pages are moved at the beginning of the table. Return the
+ * number of mapped pages.
+ */
+static unsigned
+map_all_hugepages_parallel(struct hugepage_file *hugepg_tbl,
+		struct hugepage_info *hpi, uint64_t *essential_memory __rte_unused,
+		int *contig)
+{
+	struct hugepage_map_job jobs[MAX_HUGEPAGE_MAP_THREADS];
+	unsigned int node_pages[RTE_MAX_NUMA_NODES] = { 0 };
+	unsigned int node_essential[RTE_MAX_NUMA_NODES] = { 0 };
+	uint64_t hugepage_sz = hpi->hugepage_sz;
+	unsigned int num_pages = hpi->num_pages[0];
+	unsigned int nb_nodes = 0, nb_jobs = 0, nb_threads, node_threads;
+	unsigned int i, j, first, share, node_first, num_mapped;
+	size_t va_len = 0;
+	char *va = NULL;
+	int node_id, numa = 0;
+
+	for (i = 0; i < num_pages; i++)
+		hugepage_file_init(&hugepg_tbl[i], hpi, i);
+
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+	if (numa_available() == 0) {
+		unsigned long maxnode = 0;
+
+		for (i = 0; i < RTE_MAX_NUMA_NODES; i++)
+			if (internal_config.socket_mem[i])
+				maxnode = i + 1;
+
+		/* same distribution as map_all_hugepages(), essential
+		 * memory of each node first */
+		node_id = -1;
+		for (i = 0; maxnode != 0 && i < num_pages; i++) {
+			for (j = 0; j < maxnode; j++)
+				if (essential_memory[j])
+					break;
+
+			if (j == maxnode) {
+				node_id = (node_id + 1) % maxnode;
+				while (!internal_config.socket_mem[node_id]) {
+					node_id++;
+					node_id %= maxnode;
+				}
+			} else {
+				node_id = j;
+				node_essential[j]++;
+				if (essential_memory[j] < hugepage_sz)
+					essential_memory[j] = 0;
+				else
+					essential_memory[j] -= hugepage_sz;
+			}
+			node_pages[node_id]++;
+		}
+		numa = maxnode != 0;
+	}
+#endif
+	if (!numa)
+		node_pages[0] = num_pages;
+
+	for (i = 0; i < RTE_MAX_NUMA_NODES; i++)
+		if (node_pages[i] != 0)
+			nb_nodes++;
+
+	if (*contig) {
+		va_len = (size_t)num_pages * hugepage_sz;
+		va = get_virtual_area(&va_len, hugepage_sz);
+		/* keep the area reserved while the threads map into it */
+		if (va != NULL && va_len == (size_t)num_pages * hugepage_sz &&
+				mmap(va, va_len, PROT_NONE,
+					MAP_PRIVATE | MAP_ANONYMOUS |
+					MAP_NORESERVE | MAP_FIXED,
+					-1, 0) == va) {
+			RTE_LOG(DEBUG, EAL, "Mapping %u MB pages at %p\n",
+				(unsigned int)(hugepage_sz / 0x100000), va);
+		} else {
+			va = NULL;
+			*contig = 0;
+		}
+	}
+
+	/* split the pages of each node between its threads */
+	first = 0;
+	for (i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+		if (node_pages[i] == 0)
+			continue;
+
+		node_id = numa ? (int)i : -1;
+		node_threads = RTE_MIN(hugepage_map_node_cpus(node_id),
+				MAX_HUGEPAGE_MAP_THREADS / nb_nodes);
+		node_threads = RTE_MAX(RTE_MIN(node_threads, node_pages[i]), 1U);
+
+		node_first = first;
+		for (j = 0; j < node_threads; j++) {
+			struct hugepage_map_job *job = &jobs[nb_jobs++];
+
+			share = (uint64_t)node_pages[i] * (j + 1) /
+				node_threads - (first - node_first);
+			job->hugepg_tbl = &hugepg_tbl[first];
+			job->num_pages = share;
+			/* essential pages are the first ones of the node */
+			job->num_essential = RTE_MIN(share, node_essential[i] -
+				RTE_MIN(node_essential[i], first - node_first));
+			job->num_mapped = 0;
+			job->hugepage_sz = hugepage_sz;
+			job->va = va != NULL ?
+				va + (size_t)first * hugepage_sz : NULL;
+			job->node_id = node_id;
+			job->bind = 1;
+			first += share;
+		}
+	}
+
+	nb_threads = 0;
+	for (i = 0; i < nb_jobs; i++) {
+		if (pthread_create(&jobs[i].thread, NULL,
+				hugepage_map_thread, &jobs[i]) != 0) {
+			RTE_LOG(DEBUG, EAL, "Cannot create hugepage mapping "
+				"thread, mapping %u pages locally\n",
+				jobs[i].num_pages);
+			jobs[i].bind = 0;
+			hugepage_map_thread(&jobs[i]);
+			continue;
+		}
+		nb_threads++;
+	}
+	for (i = 0; i < nb_jobs; i++)
+		if (jobs[i].bind)
+			pthread_join(jobs[i].thread, NULL);
+
+	RTE_LOG(DEBUG, EAL, "Mapped %u MB pages with %u threads on %u nodes\n",
+		(unsigned int)(hugepage_sz / 0x100000), nb_threads, nb_nodes);
+
+	/* move mapped pages at the beginning of the table, release the
+	 * reserved area of failed pages and give back their essential
+	 * memory */
+	num_mapped = 0;
+	for (i = 0; i < nb_jobs; i++) {
+		struct hugepage_map_job *job = &jobs[i];
+
+		if (job->num_mapped != 0 &&
+				job->hugepg_tbl != &hugepg_tbl[num_mapped])
+			memmove(&hugepg_tbl[num_mapped], job->hugepg_tbl,
+				job->num_mapped * sizeof(*hugepg_tbl));
+		num_mapped += job->num_mapped;
+
+		if (job->num_mapped == job->num_pages)
+			continue;
+
+		if (job->va != NULL)
+			munmap(job->va + (size_t)job->num_mapped * hugepage_sz,
+				(size_t)(job->num_pages - job->num_mapped) *
+				hugepage_sz);
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+		if (job->node_id >= 0 && job->num_essential > job->num_mapped)
+			essential_memory[job->node_id] +=
+				(job->num_essential - job->num_mapped) *
+				hugepage_sz;
+#endif
+	}
+	if (num_mapped < num_pages)
+		memset(&hugepg_tbl[num_mapped], 0,
+			(num_pages - num_mapped) * sizeof(*hugepg_tbl));
+
+	return num_mapped;
+}
+
 /* Unmap all hugepages from original mapping */
 static int
 unmap_all_hugepages_orig(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi)
@@ -517,6 +965,37 @@ unmap_all_hugepages_orig(struct hugepage_file *hugepg_tbl, struct hugepage_info
         return 0;
 }
 
+/*
+ * Ask the kernel for the NUMA socket ID of each huge page. This is used
+ * with single file segments, where the mappings of adjacent pages of the
+ * file are merged in /proc/self/numa_maps.
+ */
+static int
+find_numasocket_by_addr(struct hugepage_file *hugepg_tbl,
+		struct hugepage_info *hpi)
+{
+	unsigned int i;
+	int node;
+
+	for (i = 0; i < hpi->num_pages[0]; i++) {
+		if (syscall(SYS_get_mempolicy, &node, NULL, 0,
+				hugepg_tbl[i].orig_va,
+				MPOL_F_NODE | MPOL_F_ADDR) < 0) {
+			if (errno == ENOSYS) {
+				RTE_LOG(NOTICE, EAL, "NUMA support not available"
+					" consider that all memory is in socket_id 0\n");
+				return 0;
+			}
+			RTE_LOG(ERR, EAL, "%s(): get_mempolicy failed: %s\n",
+				__func__, strerror(errno));
+			return -1;
+		}
+		hugepg_tbl[i].socket_id = node;
+	}
+
+	return 0;
+}
+
 /*
  * Parse /proc/self/numa_maps to get the NUMA socket ID for each huge
  * page.
@@ -532,6 +1011,9 @@ find_numasocket(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi)
 	char hugedir_str[PATH_MAX];
 	FILE *f;
 
+	if (internal_config.single_file_segments)
+		return find_numasocket_by_addr(hugepg_tbl, hpi);
+
 	f = fopen("/proc/self/numa_maps", "r");
 	if (f == NULL) {
 		RTE_LOG(NOTICE, EAL, "NUMA support not available"
@@ -539,8 +1021,13 @@ find_numasocket(struct hugepage_file *hugepg_tbl, struct hugepage_info *hpi)
 		return 0;
 	}
 
-	snprintf(hugedir_str, sizeof(hugedir_str),
-			"%s/%s", hpi->hugedir, internal_config.hugefile_prefix);
+	if (internal_config.in_memory)
+		snprintf(hugedir_str, sizeof(hugedir_str),
+				"/memfd:%s", internal_config.hugefile_prefix);
+	else
+		snprintf(hugedir_str, sizeof(hugedir_str),
+				"%s/%s", hpi->hugedir,
+				internal_config.hugefile_prefix);
 
 	/* parse numa map */
 	while (fgets(buf, sizeof(buf), f) != NULL) {
@@ -683,7 +1170,10 @@ unlink_hugepage_files(struct hugepage_file *hugepg_tbl,
 	for (page = 0; page < nrpages; page++) {
 		struct hugepage_file *hp = &hugepg_tbl[page];
 
-		if (hp->final_va != NULL && unlink(hp->filepath)) {
+		/* with single file segments, the file may be gone already */
+		if (hp->final_va != NULL && unlink(hp->filepath) &&
+				!(internal_config.single_file_segments &&
+				  errno == ENOENT)) {
 			RTE_LOG(WARNING, EAL, "%s(): Removing %s failed: %s\n",
 				__func__, hp->filepath, strerror(errno));
 		}
@@ -730,7 +1220,7 @@ unmap_unneeded_hugepages(struct hugepage_file *hugepg_tbl,
 						munmap(hp->final_va, (size_t) unmap_len);
 
 						hp->final_va = NULL;
-						if (unlink(hp->filepath) == -1) {
+						if (hugepage_file_drop(hp) == -1) {
 							RTE_LOG(ERR, EAL, "%s(): Removing %s failed: %s\n",
 									__func__, hp->filepath, strerror(errno));
 							return -1;
@@ -756,7 +1246,7 @@ get_socket_mem_size(int socket)
 
 	for (i = 0; i < internal_config.num_hugepage_sizes; i++){
 		struct hugepage_info *hpi = &internal_config.hugepage_info[i];
-		if (hpi->hugedir != NULL)
+		if (hpi->hugedir != NULL || internal_config.in_memory)
 			size += hpi->hugepage_sz * hpi->num_pages[socket];
 	}
 
@@ -907,7 +1397,7 @@ eal_get_hugepage_mem_size(void)
 
 	for (i = 0; i < internal_config.num_hugepage_sizes; i++) {
 		struct hugepage_info *hpi = &internal_config.hugepage_info[i];
-		if (hpi->hugedir != NULL) {
+		if (hpi->hugedir != NULL || internal_config.in_memory) {
 			for (j = 0; j < RTE_MAX_NUMA_NODES; j++) {
 				size += hpi->hugepage_sz * hpi->num_pages[j];
 			}
@@ -944,54 +1434,598 @@ huge_recover_sigbus(void)
 	}
 }
 
+#define THP_PMD_SIZE_FILE "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size"
+
 /*
- * Prepare physical memory mapping: fill configuration structure with
- * these infos, return 0 on success.
- *  1. map N huge pages in separate files in hugetlbfs
- *  2. find associated physical addr
- *  3. find associated NUMA socket ID
- *  4. sort all huge pages by physical address
- *  5. remap these N huge pages in the correct order
- *  6. unmap the first mapping
- *  7. fill memsegs in configuration with contiguous zones
+ * Return the size of the pages backing an anonymous area: the transparent
+ * huge page size if the whole resident part of the area is made of them,
+ * else the standard page size. It is found by browsing /proc/self/smaps.
  */
-int
-rte_eal_hugepage_init(void)
+static uint64_t
+eal_nohuge_page_size(const void *addr)
 {
-	struct rte_mem_config *mcfg;
-	struct hugepage_file *hugepage = NULL, *tmp_hp = NULL;
-	struct hugepage_info used_hp[MAX_HUGEPAGE_SIZES];
-
-	uint64_t memory[RTE_MAX_NUMA_NODES];
-
-	unsigned hp_offset;
-	int i, j, new_memseg;
-	int nr_hugefiles, nr_hugepages = 0;
-	void *addr;
+	uint64_t start, end, rss = 0, anon_huge = 0, thp_size = 0;
+	bool found = false;
+	char buf[BUFSIZ];
+	char *end_ptr;
+	FILE *f;
 
-	test_phys_addrs_available();
+	f = fopen(THP_PMD_SIZE_FILE, "r");
+	if (f != NULL) {
+		if (fscanf(f, "%" SCNu64, &thp_size) != 1)
+			thp_size = 0;
+		fclose(f);
+	}
+	if (thp_size == 0)
+		return getpagesize();
 
-	memset(used_hp, 0, sizeof(used_hp));
+	f = fopen("/proc/self/smaps", "r");
+	if (f == NULL)
+		return getpagesize();
 
-	/* get pointer to global configuration */
-	mcfg = rte_eal_get_configuration()->mem_config;
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		/* a new area starts with its address range */
+		start = strtoull(buf, &end_ptr, 16);
+		if (end_ptr != buf && *end_ptr == '-') {
+			if (found)
+				break;
+			end = strtoull(end_ptr + 1, NULL, 16);
+			found = (uintptr_t)addr >= start &&
+				(uintptr_t)addr < end;
+			continue;
+		}
+		if (!found)
+			continue;
+		if (strncmp(buf, "Rss:", 4) == 0)
+			rss = strtoull(buf + 4, NULL, 10);
+		else if (strncmp(buf, "AnonHugePages:", 14) == 0)
+			anon_huge = strtoull(buf + 14, NULL, 10);
+	}
+	fclose(f);
 
-	/* hugetlbfs can be disabled */
-	if (internal_config.no_hugetlbfs) {
-		addr = mmap(NULL, internal_config.memory, PROT_READ | PROT_WRITE,
-				MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
-		if (addr == MAP_FAILED) {
+	if (rss != 0 && anon_huge == rss)
+		return thp_size;
+	return getpagesize();
+}
+
+/*
+ * Without hugetlbfs, back memory with anonymous mappings: one memseg per
+ * NUMA node requested with --socket-mem (or a single one on socket 0),
+ * bound to its node and using transparent huge pages when possible. The
+ * memory is faulted in at init, so that the pages are allocated on the
+ * right node and the page size really used can be reported in the memseg.
+ */
+static int
+eal_nohuge_init(struct rte_mem_config *mcfg)
+{
+	uint64_t memory[RTE_MAX_NUMA_NODES];
+	size_t len, align = RTE_PGSIZE_2M, off;
+	unsigned int socket, nb_segs = 0;
+	char *addr, *area;
+	int page_sz = getpagesize();
+
+	memset(memory, 0, sizeof(memory));
+	if (internal_config.force_sockets) {
+		for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++)
+			memory[socket] = internal_config.socket_mem[socket];
+	} else {
+		memory[0] = internal_config.memory;
+	}
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+		struct rte_memseg *ms = &mcfg->memseg[nb_segs];
+
+		if (memory[socket] == 0)
+			continue;
+
+		/* reserve some extra space to align the area on the
+		 * transparent huge page size */
+		len = RTE_ALIGN_CEIL(memory[socket], (uint64_t)page_sz);
+		area = mmap(NULL, len + align, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (area == MAP_FAILED) {
 			RTE_LOG(ERR, EAL, "%s: mmap() failed: %s\n", __func__,
 					strerror(errno));
+			goto fail;
+		}
+		addr = RTE_PTR_ALIGN_CEIL(area, align);
+		off = addr - area;
+		if (off != 0)
+			munmap(area, off);
+		munmap(addr + len, align - off);
+
+#ifdef RTE_EAL_NUMA_AWARE_HUGEPAGES
+		if (numa_available() == 0) {
+			unsigned long nodemask = 1UL << socket;
+
+			if (mbind(addr, len, MPOL_BIND, &nodemask,
+					sizeof(nodemask) * CHAR_BIT, 0) < 0)
+				RTE_LOG(WARNING, EAL, "Cannot bind memory to "
+					"socket %u: %s\n", socket,
+					strerror(errno));
+		}
+#endif
+#ifdef MADV_HUGEPAGE
+		if (madvise(addr, len, MADV_HUGEPAGE) < 0)
+			RTE_LOG(DEBUG, EAL, "Transparent huge pages not "
+				"available: %s\n", strerror(errno));
+#endif
+
+		/* fault the pages in on their node */
+		for (off = 0; off < len; off += page_sz)
+			addr[off] = 0;
+
+		ms->addr = addr;
+		if (rte_eal_iova_mode() == RTE_IOVA_VA)
+			ms->iova = (uintptr_t)addr;
+		else
+			ms->iova = RTE_BAD_IOVA;
+		ms->len = len;
+		ms->hugepage_sz = eal_nohuge_page_size(addr);
+		ms->socket_id = socket;
+
+		RTE_LOG(DEBUG, EAL, "Socket %u: %zu MB of anonymous memory "
+			"at %p, page size %"PRIu64" kB\n", socket,
+			len / 0x100000, addr, ms->hugepage_sz / 1024);
+		nb_segs++;
+	}
+
+	return 0;
+
+fail:
+	/* unmap the memsegs of the sockets already set up */
+	while (nb_segs > 0) {
+		struct rte_memseg *ms = &mcfg->memseg[--nb_segs];
+
+		munmap(ms->addr, ms->len);
+		memset(ms, 0, sizeof(*ms));
+	}
+	return -1;
+}
+
+/* maximum number of memfds passed in one message to a secondary process */
+#define MEMFD_MAX_FDS_PER_MSG 64
+
+/* Request of a secondary process, first message of a connection */
+struct memfd_req {
+	uint32_t seg; /**< memseg added at runtime, or MEMFD_REQ_TABLE */
+	uint32_t gen; /**< generation of the memseg in the memseg table */
+};
+
+/* request for the memfds of the whole hugepage table */
+#define MEMFD_REQ_TABLE UINT32_MAX
+
+/* time given to a secondary process to send its request, in seconds */
+#define MEMFD_REQ_TIMEOUT 1
+
+/* Header of the messages passing the memfds to a secondary process */
+struct memfd_msg {
+	uint32_t first; /**< index of the first page, or of the memseg */
+	uint32_t count; /**< number of attached fds, 0 in the last message */
+};
+
+/* memfd of each entry of the shared hugepage table, in the primary */
+static int *memfd_list;
+static unsigned int memfd_count;
+static int memfd_server_fd = -1;
+static pthread_t memfd_server_thread;
+static volatile int memfd_server_stopping;
+
+/* Get the address of the memfd socket. It is an abstract unix socket,
+ * so no file is created in the filesystem.
+ */
+static int
+memfd_socket_addr(struct sockaddr_un *addr, socklen_t *addr_len)
+{
+	const char *name = eal_memfd_socket_name();
+	size_t name_len = strlen(name);
+
+	if (name_len + 1 > sizeof(addr->sun_path))
+		return -1;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	memcpy(&addr->sun_path[1], name, name_len);
+	*addr_len = offsetof(struct sockaddr_un, sun_path) + 1 + name_len;
+	return 0;
+}
+
+static int
+memfd_send(int sock, uint32_t first, const int *fds, uint32_t count)
+{
+	char control[CMSG_SPACE(sizeof(int) * MEMFD_MAX_FDS_PER_MSG)];
+	struct memfd_msg m = { .first = first, .count = count };
+	struct iovec iov = { .iov_base = &m, .iov_len = sizeof(m) };
+	struct msghdr msgh;
+	struct cmsghdr *cmsg;
+	ssize_t ret;
+
+	memset(&msgh, 0, sizeof(msgh));
+	msgh.msg_iov = &iov;
+	msgh.msg_iovlen = 1;
+
+	if (count > 0) {
+		memset(control, 0, sizeof(control));
+		msgh.msg_control = control;
+		msgh.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+		cmsg = CMSG_FIRSTHDR(&msgh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+	}
+
+	do {
+		ret = sendmsg(sock, &msgh, MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret < 0 ? -1 : 0;
+}
+
+/* Send all the fds of the hugepage table, followed by an empty message */
+static void
+memfd_serve_table(int sock, pid_t pid)
+{
+	uint32_t first, count;
+
+	for (first = 0; first < memfd_count; first += count) {
+		count = RTE_MIN(memfd_count - first,
+				(uint32_t)MEMFD_MAX_FDS_PER_MSG);
+		if (memfd_send(sock, first, &memfd_list[first], count) < 0)
+			return;
+	}
+	if (memfd_send(sock, memfd_count, NULL, 0) == 0)
+		RTE_LOG(DEBUG, EAL, "Sent %u hugepage memfds to pid %d\n",
+			memfd_count, (int)pid);
+}
+
+/*
+ * Send the fd of a memseg added at runtime, followed by an empty message.
+ * Only the empty message is sent if the memseg was released or replaced
+ * since the secondary process read its generation.
+ */
+static void
+memfd_serve_seg(int sock, const struct memfd_req *req, pid_t pid)
+{
+	int fd = eal_memalloc_seg_fd(req->seg, req->gen);
+
+	if (fd >= 0 && memfd_send(sock, req->seg, &fd, 1) == 0 &&
+			memfd_send(sock, req->seg + 1, NULL, 0) == 0)
+		RTE_LOG(DEBUG, EAL, "Sent memseg %u memfd to pid %d\n",
+			req->seg, (int)pid);
+	else if (fd < 0)
+		memfd_send(sock, req->seg, NULL, 0);
+
+	if (fd >= 0)
+		close(fd);
+}
+
+/*
+ * Serve the memfds to secondary processes: each connection sends one
+ * request, for the fds of the hugepage table or for the fd of a memseg
+ * added at runtime. Only processes of the same user are served.
+ */
+static void *
+memfd_server(void *arg __rte_unused)
+{
+	struct timeval timeout = { .tv_sec = MEMFD_REQ_TIMEOUT };
+	struct memfd_req req;
+	struct ucred cred;
+	socklen_t len;
+	ssize_t ret;
+	int sock;
+
+	for (;;) {
+		sock = accept(memfd_server_fd, NULL, NULL);
+		if (sock < 0) {
+			if (memfd_server_stopping)
+				break;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			RTE_LOG(ERR, EAL, "memfd server stopped: %s\n",
+				strerror(errno));
+			break;
+		}
+
+		len = sizeof(cred);
+		if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred,
+				&len) < 0 || cred.uid != geteuid()) {
+			RTE_LOG(ERR, EAL, "Refusing hugepages to an "
+				"unknown process\n");
+			close(sock);
+			continue;
+		}
+
+		/* a stalled process must not hold the server */
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+			sizeof(timeout));
+		do {
+			ret = recv(sock, &req, sizeof(req), 0);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret != sizeof(req))
+			RTE_LOG(ERR, EAL, "No memfd request from pid %d\n",
+				(int)cred.pid);
+		else if (req.seg == MEMFD_REQ_TABLE)
+			memfd_serve_table(sock, cred.pid);
+		else
+			memfd_serve_seg(sock, &req, cred.pid);
+		close(sock);
+	}
+
+	return NULL;
+}
+
+/* Start serving the memfds of the shared hugepage table */
+static int
+memfd_server_start(const struct hugepage_file *hugepg_tbl,
+		unsigned int num_hp)
+{
+	struct sockaddr_un addr;
+	socklen_t addr_len;
+	unsigned int i;
+
+	memfd_list = malloc(num_hp * sizeof(*memfd_list));
+	if (memfd_list == NULL)
+		return -1;
+	for (i = 0; i < num_hp; i++)
+		memfd_list[i] = hugepg_tbl[i].fd;
+	memfd_count = num_hp;
+
+	if (memfd_socket_addr(&addr, &addr_len) < 0)
+		goto fail;
+
+	memfd_server_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (memfd_server_fd < 0)
+		goto fail;
+
+	if (bind(memfd_server_fd, (struct sockaddr *)&addr, addr_len) < 0 ||
+			listen(memfd_server_fd, 16) < 0)
+		goto fail;
+
+	memfd_server_stopping = 0;
+	if (pthread_create(&memfd_server_thread, NULL, memfd_server,
+			NULL) != 0)
+		goto fail;
+
+	return 0;
+
+fail:
+	RTE_LOG(ERR, EAL, "Cannot start memfd server %s: %s\n",
+		eal_memfd_socket_name(), strerror(errno));
+	if (memfd_server_fd >= 0)
+		close(memfd_server_fd);
+	memfd_server_fd = -1;
+	free(memfd_list);
+	memfd_list = NULL;
+	return -1;
+}
+
+/*
+ * Stop serving the memfds: shutting the listening socket down wakes the
+ * server thread up in accept(). The memfds themselves stay open, as they
+ * back the hugepages.
+ */
+void
+rte_eal_memfd_server_stop(void)
+{
+	if (memfd_server_fd < 0)
+		return;
+
+	memfd_server_stopping = 1;
+	shutdown(memfd_server_fd, SHUT_RDWR);
+	pthread_join(memfd_server_thread, NULL);
+
+	close(memfd_server_fd);
+	memfd_server_fd = -1;
+	free(memfd_list);
+	memfd_list = NULL;
+	memfd_count = 0;
+}
+
+/* Close all the fds passed in a message, which is not used */
+static void
+memfd_close_received(struct msghdr *msgh)
+{
+	struct cmsghdr *cmsg;
+	size_t i, n;
+	int fd;
+
+	for (cmsg = CMSG_FIRSTHDR(msgh); cmsg != NULL;
+			cmsg = CMSG_NXTHDR(msgh, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+				cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n; i++) {
+			memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int),
+				sizeof(fd));
+			close(fd);
+		}
+	}
+}
+
+/*
+ * Check a message received from the memfd server: it must carry exactly
+ * the fds of its header, for entries from first to first + num - 1 not
+ * received yet.
+ */
+static int
+memfd_msg_check(struct msghdr *msgh, const struct memfd_msg *m,
+		const int *fds, unsigned int first, unsigned int num)
+{
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msgh);
+	uint32_t i;
+
+	if (m->count == 0)
+		return cmsg == NULL ? 0 : -1;
+
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+			cmsg->cmsg_type != SCM_RIGHTS ||
+			cmsg->cmsg_len != CMSG_LEN(sizeof(int) * m->count) ||
+			CMSG_NXTHDR(msgh, cmsg) != NULL ||
+			m->first < first || m->first - first >= num ||
+			m->count > num - (m->first - first))
+		return -1;
+
+	for (i = 0; i < m->count; i++)
+		if (fds[m->first - first + i] != -1)
 			return -1;
+
+	return 0;
+}
+
+/*
+ * Send a request to the memfd server of the primary process, and get the
+ * memfds of the entries from first to first + num - 1 in fds, which must
+ * have num entries set to -1. On error, the fds already received are left
+ * in the table, to be closed by the caller.
+ */
+static int
+memfd_request(const struct memfd_req *req, int *fds, unsigned int first,
+		unsigned int num)
+{
+	char control[CMSG_SPACE(sizeof(int) * MEMFD_MAX_FDS_PER_MSG)];
+	struct sockaddr_un addr;
+	socklen_t addr_len;
+	struct memfd_msg m;
+	struct iovec iov;
+	struct msghdr msgh;
+	unsigned int received = 0;
+	ssize_t ret;
+	int sock, done = 0;
+
+	if (memfd_socket_addr(&addr, &addr_len) < 0)
+		return -1;
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+
+	if (connect(sock, (struct sockaddr *)&addr, addr_len) < 0) {
+		RTE_LOG(ERR, EAL, "Cannot connect to memfd server %s: %s\n",
+			eal_memfd_socket_name(), strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	do {
+		ret = send(sock, req, sizeof(*req), MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+	if (ret != sizeof(*req)) {
+		RTE_LOG(ERR, EAL, "Cannot send memfd request: %s\n",
+			strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	for (;;) {
+		memset(&msgh, 0, sizeof(msgh));
+		iov.iov_base = &m;
+		iov.iov_len = sizeof(m);
+		msgh.msg_iov = &iov;
+		msgh.msg_iovlen = 1;
+		msgh.msg_control = control;
+		msgh.msg_controllen = sizeof(control);
+
+		ret = recvmsg(sock, &msgh, MSG_CMSG_CLOEXEC);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			break;
+		/* the fds of a bad or truncated message are installed too */
+		if (ret != sizeof(m) || (msgh.msg_flags & MSG_CTRUNC) ||
+				memfd_msg_check(&msgh, &m, fds, first,
+					num) < 0) {
+			memfd_close_received(&msgh);
+			break;
 		}
-		mcfg->memseg[0].addr = addr;
-		mcfg->memseg[0].hugepage_sz = RTE_PGSIZE_4K;
-		mcfg->memseg[0].len = internal_config.memory;
-		mcfg->memseg[0].socket_id = 0;
-		return 0;
+		if (m.count == 0) {
+			done = 1;
+			break;
+		}
+
+		memcpy(&fds[m.first - first], CMSG_DATA(CMSG_FIRSTHDR(&msgh)),
+			sizeof(int) * m.count);
+		received += m.count;
+	}
+	close(sock);
+
+	if (!done || received != num) {
+		RTE_LOG(ERR, EAL, "Received %u of %u memfds\n",
+			received, num);
+		return -1;
 	}
 
+	return 0;
+}
+
+/* Get the memfds of the hugepage table from the primary process */
+static int
+memfd_receive(int *fds, unsigned int num_hp)
+{
+	const struct memfd_req req = { .seg = MEMFD_REQ_TABLE };
+
+	return memfd_request(&req, fds, 0, num_hp);
+}
+
+int
+eal_memfd_request_seg(unsigned int idx, uint32_t gen)
+{
+	const struct memfd_req req = { .seg = idx, .gen = gen };
+	int fd = -1;
+
+	if (memfd_request(&req, &fd, idx, 1) < 0) {
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Prepare physical memory mapping: fill configuration structure with
+ * these infos, return 0 on success.
+ *  1. map N huge pages in separate files in hugetlbfs, using one or more
+ *     helper threads per NUMA node
+ *  2. find associated physical addr
+ *  3. find associated NUMA socket ID
+ *  4. sort all huge pages by physical address
+ *  5. remap these N huge pages in the correct order
+ *  6. unmap the first mapping
+ *  7. fill memsegs in configuration with contiguous zones
+ * Steps 4 to 6 are skipped when physical addresses are not available or
+ * in IOVA as VA mode, the pages being mapped in a virtually contiguous area
+ * at step 1. In IOVA as VA mode, /proc/self/pagemap is never read and the
+ * IOVA of each page is its virtual address.
+ * In in-memory mode, the pages are backed by memfds instead of hugetlbfs
+ * files. The memfds are kept open and passed to secondary processes over
+ * an abstract unix socket.
+ */
+int
+rte_eal_hugepage_init(void)
+{
+	struct rte_mem_config *mcfg;
+	struct hugepage_file *hugepage = NULL, *tmp_hp = NULL;
+	struct hugepage_info used_hp[MAX_HUGEPAGE_SIZES];
+
+	uint64_t memory[RTE_MAX_NUMA_NODES];
+
+	unsigned hp_offset;
+	int i, j, new_memseg;
+	int nr_hugefiles, nr_hugepages = 0;
+
+	test_phys_addrs_available();
+
+	memset(used_hp, 0, sizeof(used_hp));
+
+	/* get pointer to global configuration */
+	mcfg = rte_eal_get_configuration()->mem_config;
+
+	/* hugetlbfs can be disabled */
+	if (internal_config.no_hugetlbfs)
+		return eal_nohuge_init(mcfg);
+
 	/* calculate total number of hugepages available. at this point we haven't
 	 * yet started sorting them so they all are on socket 0 */
 	for (i = 0; i < (int) internal_config.num_hugepage_sizes; i++) {
@@ -1026,6 +2060,7 @@ rte_eal_hugepage_init(void)
 	for (i = 0; i < (int)internal_config.num_hugepage_sizes; i ++){
 		unsigned pages_old, pages_new;
 		struct hugepage_info *hpi;
+		int contig;
 
 		/*
 		 * we don't yet mark hugepages as used at this stage, so
@@ -1037,10 +2072,16 @@ rte_eal_hugepage_init(void)
 		if (hpi->num_pages[0] == 0)
 			continue;
 
-		/* map all hugepages available */
+		/* Map all hugepages available, in parallel. When physical
+		 * addresses are not known or not used (IOVA as VA), there
+		 * is no physical contiguity to preserve: map the pages
+		 * directly in a contiguous virtual area and skip the sort
+		 * and remap below.
+		 */
 		pages_old = hpi->num_pages[0];
-		pages_new = map_all_hugepages(&tmp_hp[hp_offset], hpi,
-					      memory, 1);
+		contig = !phys_addrs_available;
+		pages_new = map_all_hugepages_parallel(&tmp_hp[hp_offset], hpi,
+					      memory, &contig);
 		if (pages_new < pages_old) {
 			RTE_LOG(DEBUG, EAL,
 				"%d not %d hugepages of size %u MB allocated\n",
@@ -1079,6 +2120,18 @@ rte_eal_hugepage_init(void)
 			goto fail;
 		}
 
+		if (contig) {
+			unsigned int k;
+
+			for (k = 0; k < hpi->num_pages[0]; k++) {
+				tmp_hp[hp_offset + k].final_va =
+					tmp_hp[hp_offset + k].orig_va;
+				tmp_hp[hp_offset + k].orig_va = NULL;
+			}
+			hp_offset += hpi->num_pages[0];
+			continue;
+		}
+
 		qsort(&tmp_hp[hp_offset], hpi->num_pages[0],
 		      sizeof(struct hugepage_file), cmp_physaddr);
 
@@ -1094,6 +2147,15 @@ rte_eal_hugepage_init(void)
 		if (unmap_all_hugepages_orig(&tmp_hp[hp_offset], hpi) < 0)
 			goto fail;
 
+		/* IOVA follow the final virtual addresses */
+		if (rte_eal_iova_mode() == RTE_IOVA_VA) {
+			unsigned int k;
+
+			for (k = 0; k < hpi->num_pages[0]; k++)
+				tmp_hp[hp_offset + k].physaddr = (uintptr_t)
+					tmp_hp[hp_offset + k].final_va;
+		}
+
 		/* we have processed a num of hugepages of this size, so inc offset */
 		hp_offset += hpi->num_pages[0];
 	}
@@ -1186,7 +2248,7 @@ rte_eal_hugepage_init(void)
 	}
 
 	/* free the hugepage backing files */
-	if (internal_config.hugepage_unlink &&
+	if (internal_config.hugepage_unlink && !internal_config.in_memory &&
 		unlink_hugepage_files(tmp_hp, internal_config.num_hugepage_sizes) < 0) {
 		RTE_LOG(ERR, EAL, "Unlinking hugepage files failed!\n");
 		goto fail;
@@ -1244,6 +2306,12 @@ rte_eal_hugepage_init(void)
 		goto fail;
 	}
 
+	/* the pages have no file, let secondaries get their memfds */
+	if (internal_config.in_memory &&
+			memfd_server_start(hugepage, nr_hugefiles) < 0)
+		RTE_LOG(WARNING, EAL, "Secondary processes won't be able to "
+			"attach\n");
+
 	munmap(hugepage, nr_hugefiles * sizeof(struct hugepage_file));
 
 	return 0;
@@ -1257,6 +2325,20 @@ fail:
 	return -1;
 }
 
+/* close and free a table of received memfds */
+static void
+memfd_close_all(int *fds, unsigned int num_hp)
+{
+	unsigned int i;
+
+	if (fds == NULL)
+		return;
+	for (i = 0; i < num_hp; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	free(fds);
+}
+
 /*
  * uses fstat to report the size of a file on disk
  */
@@ -1269,11 +2351,145 @@ getFileSize(int fd)
 	return st.st_size;
 }
 
+/* hugepage table of the primary process, while attaching */
+static struct hugepage_file *attach_hp;
+static unsigned int attach_num_hp;
+static int *attach_memfds;
+/* index in the hugepage table of the first page of each memseg */
+static unsigned int attach_seg_first[RTE_MAX_MEMSEG];
+/*
+ * Address range of each memseg mapped lazily, empty for the others. It is
+ * filled before the SIGSEGV handler is installed and never changed after,
+ * so that the handler looks addresses up without the memory config lock.
+ */
+static struct {
+	uintptr_t start;
+	uintptr_t end;
+} attach_seg_range[RTE_MAX_MEMSEG];
+static unsigned int attach_nb_segs;
+static struct sigaction attach_old_sigsegv;
+
+/*
+ * Map the hugepages of a memseg over its reserved address range. The pages
+ * following each other both in the same file and in memory are mapped at
+ * once. This function only uses async-signal-safe calls, as it is called
+ * from the SIGSEGV handler in lazy attach mode.
+ */
+static int
+attach_memseg(unsigned int s)
+{
+	const struct rte_mem_config *mcfg = rte_eal_get_configuration()->mem_config;
+	const struct rte_memseg *ms = &mcfg->memseg[s];
+	const struct hugepage_file *hp = attach_hp;
+	unsigned int i, first;
+	size_t offset = 0, len;
+	void *addr;
+	int fd;
+
+	i = attach_seg_first[s];
+	while (i < attach_num_hp && hp[i].memseg_id == (int)s &&
+			offset < ms->len) {
+		first = i;
+		len = hp[i].size;
+		for (i++; i < attach_num_hp && hp[i].memseg_id == (int)s; i++) {
+			if (hp[i].size != hp[first].size ||
+					hp[i].file_offset !=
+					hp[first].file_offset + len ||
+					hp[i].final_va !=
+					RTE_PTR_ADD(hp[first].final_va, len) ||
+					strcmp(hp[i].filepath, hp[first].filepath))
+				break;
+			len += hp[i].size;
+		}
+
+		if (attach_memfds != NULL)
+			fd = attach_memfds[first];
+		else
+			fd = open(hp[first].filepath, O_RDWR);
+		if (fd < 0)
+			return -1;
+		addr = mmap(RTE_PTR_ADD(ms->addr, offset), len,
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+				fd, hp[first].file_offset);
+		/* close file both on success and on failure */
+		if (attach_memfds == NULL)
+			close(fd);
+		if (addr == MAP_FAILED)
+			return -1;
+		offset += len;
+	}
+
+	return offset < ms->len ? -1 : 0;
+}
+
+/*
+ * In lazy attach mode, the memsegs are reserved without access rights and
+ * mapped by the first thread touching them. Other faults are passed to the
+ * previous handler.
+ *
+ * Only the lookup in attach_seg_range and the open() and mmap() calls of
+ * attach_memseg() are done here: no lock is taken, so that a fault in a
+ * thread holding the memory config lock does not deadlock. Threads faulting
+ * on the same memseg at once all map it; the mappings being of the same
+ * pages at the same place, replacing one with another is harmless.
+ */
+static void
+attach_sigsegv_handler(int sig, siginfo_t *info, void *ctx)
+{
+	uintptr_t addr = (uintptr_t)info->si_addr;
+	int saved_errno = errno;
+	unsigned int s;
+
+	for (s = 0; s < attach_nb_segs; s++) {
+		if (addr < attach_seg_range[s].start ||
+				addr >= attach_seg_range[s].end)
+			continue;
+		if (attach_memseg(s) == 0) {
+			errno = saved_errno;
+			return;
+		}
+		break;
+	}
+	errno = saved_errno;
+
+	if (attach_old_sigsegv.sa_flags & SA_SIGINFO) {
+		attach_old_sigsegv.sa_sigaction(sig, info, ctx);
+		return;
+	}
+	if (attach_old_sigsegv.sa_handler != SIG_DFL &&
+			attach_old_sigsegv.sa_handler != SIG_IGN) {
+		attach_old_sigsegv.sa_handler(sig);
+		return;
+	}
+	/* fault again with the default action */
+	signal(sig, SIG_DFL);
+}
+
+static int
+attach_sigsegv_install(void)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = attach_sigsegv_handler;
+	sa.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	return sigaction(SIGSEGV, &sa, &attach_old_sigsegv);
+}
+
 /*
  * This creates the memory mappings in the secondary process to match that of
  * the server process. It goes through each memory segment in the DPDK runtime
- * configuration and finds the hugepages which form that segment, mapping them
- * in order to form a contiguous block in the virtual memory space
+ * configuration and maps the hugepages which form that segment in order to
+ * form a contiguous block in the virtual memory space.
+ *
+ * In lazy attach mode, the address ranges are only reserved here, and the
+ * hugepages of a segment are mapped when it is first accessed. Only the
+ * accesses from user space fault the segment in: a system call given a
+ * buffer in a segment not mapped yet, e.g. read() or recv(), fails with
+ * EFAULT, as the kernel raises no signal for it. Such buffers must be
+ * touched by the process before being passed to the kernel.
  */
 int
 rte_eal_hugepage_attach(void)
@@ -1283,8 +2499,11 @@ rte_eal_hugepage_attach(void)
 	unsigned num_hp = 0;
 	unsigned i, s = 0; /* s used to track the segment number */
 	unsigned max_seg = RTE_MAX_MEMSEG;
+	unsigned lazy = internal_config.lazy_attach;
+	int handler_installed = 0;
 	off_t size = 0;
-	int fd, fd_zero = -1, fd_hugepage = -1;
+	int fd_zero = -1, fd_hugepage = -1;
+	int *memfds = NULL;
 
 	if (aslr_enabled() > 0) {
 		RTE_LOG(WARNING, EAL, "WARNING: Address Space Layout Randomization "
@@ -1317,13 +2536,19 @@ rte_eal_hugepage_attach(void)
 		if (mcfg->memseg[s].len == 0)
 			break;
 
+		/* memsegs added at runtime are mapped by eal_memalloc_sync() */
+		if (eal_memalloc_is_hotplug(&mcfg->memseg[s]))
+			continue;
+
 		/*
 		 * fdzero is mmapped to get a contiguous block of virtual
 		 * addresses of the appropriate memseg size.
 		 * use mmap to get identical addresses as the primary process.
+		 * The hugepages are mapped over it, so that the range is
+		 * never left free for another mapping.
 		 */
 		base_addr = mmap(mcfg->memseg[s].addr, mcfg->memseg[s].len,
-				 PROT_READ,
+				 lazy ? PROT_NONE : PROT_READ,
 				 MAP_PRIVATE,
 				 fd_zero, 0);
 		if (base_addr == MAP_FAILED ||
@@ -1363,62 +2588,110 @@ rte_eal_hugepage_attach(void)
 	num_hp = size / sizeof(struct hugepage_file);
 	RTE_LOG(DEBUG, EAL, "Analysing %u files\n", num_hp);
 
-	s = 0;
-	while (s < RTE_MAX_MEMSEG && mcfg->memseg[s].len > 0){
-		void *addr, *base_addr;
-		uintptr_t offset = 0;
-		size_t mapping_size;
-		/*
-		 * free previously mapped memory so we can map the
-		 * hugepages into the space
-		 */
-		base_addr = mcfg->memseg[s].addr;
-		munmap(base_addr, mcfg->memseg[s].len);
-
-		/* find the hugepages for this segment and map them
-		 * we don't need to worry about order, as the server sorted the
-		 * entries before it did the second mmap of them */
-		for (i = 0; i < num_hp && offset < mcfg->memseg[s].len; i++){
-			if (hp[i].memseg_id == (int)s){
-				fd = open(hp[i].filepath, O_RDWR);
-				if (fd < 0) {
-					RTE_LOG(ERR, EAL, "Could not open %s\n",
-						hp[i].filepath);
-					goto error;
-				}
-				mapping_size = hp[i].size;
-				addr = mmap(RTE_PTR_ADD(base_addr, offset),
-						mapping_size, PROT_READ | PROT_WRITE,
-						MAP_SHARED, fd, 0);
-				close(fd); /* close file both on success and on failure */
-				if (addr == MAP_FAILED ||
-						addr != RTE_PTR_ADD(base_addr, offset)) {
-					RTE_LOG(ERR, EAL, "Could not mmap %s\n",
-						hp[i].filepath);
-					goto error;
-				}
-				offset+=mapping_size;
+	/* in-memory mode, the pages can only be reached through the
+	 * memfds of the primary process */
+	if (internal_config.in_memory) {
+		memfds = malloc(num_hp * sizeof(*memfds));
+		if (memfds == NULL)
+			goto error;
+		for (i = 0; i < num_hp; i++)
+			memfds[i] = -1;
+		if (memfd_receive(memfds, num_hp) < 0)
+			goto error;
+	}
+
+	/* index the hugepage table once, instead of once per memseg */
+	for (s = 0; s < RTE_MAX_MEMSEG; s++)
+		attach_seg_first[s] = num_hp;
+	for (i = num_hp; i-- > 0; ) {
+		if (hp[i].memseg_id >= 0 && hp[i].memseg_id < RTE_MAX_MEMSEG)
+			attach_seg_first[hp[i].memseg_id] = i;
+	}
+	attach_hp = hp;
+	attach_num_hp = num_hp;
+	attach_memfds = memfds;
+
+	if (lazy) {
+		attach_nb_segs = 0;
+		for (s = 0; s < RTE_MAX_MEMSEG && mcfg->memseg[s].len > 0;
+				s++) {
+			attach_seg_range[s].start = 0;
+			attach_seg_range[s].end = 0;
+			if (!eal_memalloc_is_hotplug(&mcfg->memseg[s])) {
+				attach_seg_range[s].start =
+					(uintptr_t)mcfg->memseg[s].addr;
+				attach_seg_range[s].end =
+					attach_seg_range[s].start +
+					mcfg->memseg[s].len;
 			}
+			attach_nb_segs = s + 1;
+		}
+		if (attach_sigsegv_install() < 0) {
+			RTE_LOG(ERR, EAL, "Could not install SIGSEGV handler: %s\n",
+				strerror(errno));
+			goto error;
+		}
+		handler_installed = 1;
+		/* the table and the memfds are needed by the fault handler */
+		close(fd_zero);
+		close(fd_hugepage);
+		RTE_LOG(DEBUG, EAL, "Memory segments will be mapped on "
+				"first access\n");
+		goto sync;
+	}
+
+	for (s = 0; s < RTE_MAX_MEMSEG && mcfg->memseg[s].len > 0; s++) {
+		if (eal_memalloc_is_hotplug(&mcfg->memseg[s]))
+			continue;
+
+		if (attach_memseg(s) < 0) {
+			RTE_LOG(ERR, EAL, "Could not mmap segment %u: %s\n",
+				s, strerror(errno));
+			goto error;
 		}
 		RTE_LOG(DEBUG, EAL, "Mapped segment %u of size 0x%llx\n", s,
 				(unsigned long long)mcfg->memseg[s].len);
-		s++;
 	}
+	attach_hp = NULL;
+	attach_num_hp = 0;
+	attach_memfds = NULL;
 	/* unmap the hugepage config file, since we are done using it */
 	munmap(hp, size);
 	close(fd_zero);
 	close(fd_hugepage);
+	/* the mappings keep the memfds alive */
+	memfd_close_all(memfds, num_hp);
+
+sync:
+	/* map the memsegs added at runtime by the primary process */
+	if (eal_memalloc_sync() < 0) {
+		fd_zero = -1;
+		fd_hugepage = -1;
+		if (!lazy) {
+			hp = NULL;
+			memfds = NULL;
+		}
+		goto error;
+	}
 	return 0;
 
 error:
+	if (handler_installed)
+		sigaction(SIGSEGV, &attach_old_sigsegv, NULL);
+	attach_nb_segs = 0;
+	attach_hp = NULL;
+	attach_num_hp = 0;
+	attach_memfds = NULL;
 	for (i = 0; i < max_seg && mcfg->memseg[i].len > 0; i++)
-		munmap(mcfg->memseg[i].addr, mcfg->memseg[i].len);
+		if (!eal_memalloc_is_hotplug(&mcfg->memseg[i]))
+			munmap(mcfg->memseg[i].addr, mcfg->memseg[i].len);
 	if (hp != NULL && hp != MAP_FAILED)
 		munmap(hp, size);
 	if (fd_zero >= 0)
 		close(fd_zero);
 	if (fd_hugepage >= 0)
 		close(fd_hugepage);
+	memfd_close_all(memfds, num_hp);
 	return -1;
 }
 
@@ -25,10 +25,14 @@
 #define RTE_MAX_NUMA_NODES 8
 #undef RTE_MAX_MEMSEG
 #define RTE_MAX_MEMSEG 256
+#undef RTE_MAX_HOTPLUG_MEM_MB
+#define RTE_MAX_HOTPLUG_MEM_MB 65536
 #undef RTE_MAX_MEMZONE
 #define RTE_MAX_MEMZONE 2560
 #undef RTE_MAX_TAILQ
 #define RTE_MAX_TAILQ 32
+#undef RTE_MAX_HEAPS
+#define RTE_MAX_HEAPS 32
 #undef RTE_ENABLE_ASSERT
 #undef RTE_LOG_DP_LEVEL
 #define RTE_LOG_DP_LEVEL RTE_LOG_INFO
@@ -46,6 +50,11 @@
 #undef RTE_MAX_VFIO_GROUPS
 #define RTE_MAX_VFIO_GROUPS 64
 #undef RTE_MALLOC_DEBUG
+#undef RTE_MALLOC_HEAP_LOCK_TICKET
+#undef RTE_MALLOC_HEAP_LOCK_MCS
+#undef RTE_MCFG_MEM_LOCK_TICKET
+#undef RTE_MCFG_MEM_LOCK_WP
+#undef RTE_LOCK_PROFILE
 #undef RTE_EAL_NUMA_AWARE_HUGEPAGES
 #define RTE_EAL_NUMA_AWARE_HUGEPAGES 1
 #undef RTE_USE_LIBBSD